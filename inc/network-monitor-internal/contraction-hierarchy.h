@@ -0,0 +1,74 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+#include "network-monitor-internal/transport-network-internal.h"
+#include "network-monitor-internal/routing-engine.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Contraction hierarchy over the route state graph.
+     *
+     *  The nodes are the route states of a CompactGraph. There is an edge from
+     *  each state to every state that follows it, weighted by the travel time
+     *  plus the line change penalty, if any. Nodes are contracted one by one,
+     *  adding shortcut edges where the only shortest path between two
+     *  remaining nodes went through the contracted one. Queries then only
+     *  need to follow edges towards higher ranked nodes, from both ends.
+     *
+     *  Edge weights are baked in: the hierarchy must be rebuilt when a travel
+     *  time or the topology changes.
+     */
+    struct ContractionHierarchy {
+        struct Edge {
+            uint32_t from;
+            uint32_t to;
+            unsigned int weight;
+            // The two edges a shortcut replaces, or CompactGraph::kNoIndex for
+            // an edge of the route state graph.
+            uint32_t firstChild;
+            uint32_t secondChild;
+        };
+
+        static ContractionHierarchy Build(const CompactGraph& graph, unsigned int penalty);
+
+        /*! \brief Find the fastest journey from `source` to `target`.
+         *
+         *  Workspace labels are travel times and `parent_` holds the edge a
+         *  state was reached through; `backward` is searched from `target`.
+         *
+         *  \returns The state where the forward and backward searches meet
+         *           on the fastest journey, or CompactGraph::kNoIndex if
+         *           `target` cannot be reached.
+         */
+        uint32_t Search(
+            const CompactGraph& graph,
+            IdHandle source,
+            IdHandle target,
+            RoutingWorkspace& forward,
+            RoutingWorkspace& backward
+        ) const;
+
+        /*! \brief Unpack the journey through `meetingState` into route
+         *         states, as ExtractPath does for the other searches.
+         */
+        void ExtractPath(
+            const RoutingWorkspace& forward,
+            const RoutingWorkspace& backward,
+            uint32_t meetingState,
+            std::vector<uint32_t>& states,
+            std::vector<unsigned int>& distances
+        ) const;
+
+        std::vector<uint32_t> rank_;
+        std::vector<Edge> edges_;
+
+        // Edges from each state to higher ranked states, and edges into each
+        // state from higher ranked states, in CSR form.
+        std::vector<uint32_t> upOffsets_;
+        std::vector<uint32_t> upEdges_;
+        std::vector<uint32_t> downOffsets_;
+        std::vector<uint32_t> downEdges_;
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+#include "network-monitor-internal/transport-network-internal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Travel time lower bounds between stations (ALT heuristic).
+     *
+     *  Holds the shortest travel times from and to a few landmark stations,
+     *  ignoring routes and line change penalties. By the triangle inequality,
+     *  these give a lower bound on the travel time between any two stations,
+     *  which stays valid as travel times increase. Decreases are patched in
+     *  with Lower.
+     *
+     *  Both tables are indexed by [station * landmark count + landmark].
+     */
+    struct LandmarkTable {
+        static constexpr unsigned int kUnreachable = std::numeric_limits<unsigned int>::max();
+
+        /*! \brief Pick `count` landmarks far apart from each other and compute
+         *         their travel time tables.
+         */
+        static LandmarkTable Build(const CompactGraph& graph, size_t count);
+
+        /*! \brief Get the tables once the travel times of `edges` decreased
+         *         on `graph`, from the edges of `graph`.
+         *
+         *  Only the stations whose travel times to or from a landmark get
+         *  shorter are searched again. The landmarks stay the same.
+         */
+        LandmarkTable Lower(const CompactGraph& graph, const std::vector<uint32_t>& edges) const;
+
+        /*! \brief Get the tables for `nStations` stations, once stations
+         *         with no edges are added after the existing ones.
+         */
+        LandmarkTable Grow(size_t nStations) const;
+
+        /*! \brief Lower bound on the travel time from `station` to `target`.
+         */
+        unsigned int GetLowerBound(IdHandle station, IdHandle target) const {
+            unsigned int bound = 0;
+            const auto nLandmarks = landmarks_.size();
+            const auto* fromStation = fromLandmark_.data() + station * nLandmarks;
+            const auto* fromTarget = fromLandmark_.data() + target * nLandmarks;
+            const auto* toStation = toLandmark_.data() + station * nLandmarks;
+            const auto* toTarget = toLandmark_.data() + target * nLandmarks;
+            for (size_t idx = 0; idx < nLandmarks; ++idx) {
+                // d(L, target) <= d(L, station) + d(station, target)
+                if (fromTarget[idx] != kUnreachable
+                    && fromStation[idx] != kUnreachable
+                    && fromTarget[idx] > fromStation[idx] + bound) {
+                    bound = fromTarget[idx] - fromStation[idx];
+                }
+                // d(station, L) <= d(station, target) + d(target, L)
+                if (toStation[idx] != kUnreachable
+                    && toTarget[idx] != kUnreachable
+                    && toStation[idx] > toTarget[idx] + bound) {
+                    bound = toStation[idx] - toTarget[idx];
+                }
+            }
+            return bound;
+        }
+
+        std::vector<IdHandle> landmarks_;
+        std::vector<unsigned int> fromLandmark_;
+        std::vector<unsigned int> toLandmark_;
+    };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+#include "network-monitor/transport-network.h"
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Route of a line being loaded, with its stops as station
+     *         handles.
+     */
+    struct LayoutRoute {
+        Id id {};
+        std::vector<IdHandle> stops {};
+        RouteTimetable timetable {};
+    };
+
+    /*! \brief Line of a network layout, with its stops as station IDs.
+     */
+    struct LayoutLine {
+        struct Route {
+            Id id {};
+            std::vector<Id> stops {};
+            RouteTimetable timetable {};
+        };
+
+        Id id {};
+        std::vector<Route> routes {};
+    };
+
+    /*! \brief Adds the items of a network layout to a TransportNetwork, in
+     *         whatever order they are read.
+     *
+     *  A line can refer to stations before the layout declares them: their
+     *  handles are made on first reference, and Finish checks that they were
+     *  all declared in the end. Travel times are applied by Finish, once all
+     *  lines are in.
+     *
+     *  The same errors as TransportNetwork::FromJson are thrown, as
+     *  std::runtime_error.
+     *
+     *  AddLines and Finish spread their work over `nThreads` threads, each
+     *  owning a range of stations and the edges leaving them, so the network
+     *  they build does not depend on the number of threads.
+     */
+    class LayoutBuilder {
+    public:
+        /*! \param nThreads The number of threads to use. 0 uses one thread
+         *                  per core.
+         */
+        explicit LayoutBuilder(TransportNetwork& network, unsigned int nThreads = 1);
+
+        /*! \throws std::runtime_error if the station was already declared.
+         */
+        void AddStation(const Id& stationId);
+
+        /*! \brief Get the handle of a station a route stops at, declared or
+         *         not yet.
+         */
+        IdHandle AddStop(const Id& stationId);
+
+        /*! \throws std::runtime_error if a route is already in the network.
+         */
+        void AddLine(const Id& lineId, const std::vector<LayoutRoute>& routes);
+
+        /*! \brief Add lines in bulk, as if by AddStop and AddLine in order.
+         *
+         *  The stops are looked up in parallel. Into a network with no edges
+         *  yet, the edges are then built in parallel too, and the error is
+         *  that of the first line AddLine would have failed on.
+         *
+         *  \throws std::runtime_error if a route is already in the network.
+         */
+        void AddLines(const std::vector<LayoutLine>& lines);
+
+        void AddTravelTime(const Id& stationA, const Id& stationB, unsigned int travelTime);
+
+        /*! \brief Apply the travel times and publish the network to queries.
+         *
+         *  \throws std::runtime_error if a line stops at a station that was
+         *                             never declared.
+         */
+        void Finish();
+
+    private:
+        /*! \brief Intern a route of `line` with its timetable, and note the
+         *         line as the first to stop at the undeclared stations of the
+         *         route.
+         */
+        IdHandle AddRoute(IdHandle line, const LayoutRoute& route);
+
+        TransportNetwork& network_;
+        unsigned int nThreads_;
+
+        // Indexed by station handle.
+        std::vector<bool> declared_ {};
+        // The line that first stopped at each station.
+        std::vector<IdHandle> firstLines_ {};
+
+        std::vector<std::tuple<IdHandle, IdHandle, unsigned int>> travelTimes_ {};
+        // Travel times between stations not declared when they were read.
+        std::vector<std::tuple<Id, Id, unsigned int>> pendingTravelTimes_ {};
+    };
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace NetworkMonitor {
+    struct CompactGraph;
+    struct LandmarkTable;
+    struct ContractionHierarchy;
+    struct Timetable;
+    class OccupancyHistory;
+
+    /*! \brief Passenger counts, indexed by station handle.
+     *
+     *  Each count is split into shards: a thread only adds to its own shard,
+     *  and a read sums the shards. So threads recording events at the same
+     *  station, or at stations next to each other, do not write to the same
+     *  cache lines.
+     *
+     *  The counts are atomic, so events can be recorded while route queries
+     *  read them. They live in fixed-size chunks that never move: a copy made
+     *  by Grow shares the chunks of the existing stations, so no event is lost
+     *  when a larger set of counters replaces this one.
+     *
+     *  The counters also rank the kRankedStations most crowded stations as
+     *  events come in. The ranked stations are kept with a bound: no unranked
+     *  station has a count, summed over the shards, above it. The bound is on
+     *  the counts themselves, not on their shards, so it holds however the
+     *  events of a station are spread over threads. Only an event that takes
+     *  an unranked station above the bound touches the ranking, under a lock.
+     *  Other events add to their counter, then read the bound and the other
+     *  shards of their station.
+     */
+    class PassengerCounters {
+    public:
+        static constexpr size_t kChunkSize {1024};
+        static constexpr size_t kShardCount {8};
+        static constexpr size_t kRankedStations {64};
+
+        PassengerCounters();
+
+        /*! \brief Get counters for `nStations` stations that share the counts
+         *         of the stations in this set.
+         */
+        PassengerCounters Grow(size_t nStations) const;
+
+        /*! \brief Get counters with the same counts as this set, that do not
+         *         share them.
+         */
+        PassengerCounters Clone() const;
+
+        size_t Size() const {
+            return size_;
+        }
+
+        long long int Get(IdHandle station) const {
+            // Sequentially consistent, for Add and the ranking code.
+            long long int count {0};
+            for (size_t shard = 0; shard < kShardCount; ++shard) {
+                count += Unflag(Counter(shard, station).load());
+            }
+            return count;
+        }
+
+        void Add(IdHandle station, long long int delta) {
+            // The add returns whether the station is ranked along with its
+            // count. Sequentially consistent, as are the reads of the bound
+            // and of the other shards after it: two events at one station on
+            // different shards cannot both miss each other, and the bound read
+            // is at least the one stored before the ranking code last read
+            // this counter. See Rerank.
+            const auto shardCount = Counter(GetThreadShard(), station).fetch_add(delta) + delta;
+            if (delta > 0 && !IsRanked(shardCount) && Get(station) > ranking_->bound.load()) {
+                Rank(station);
+            }
+        }
+
+        /*! \brief Get the `k` stations with the most passengers, most crowded
+         *         first, with their counts.
+         *
+         *  Takes O(k log k) for up to kRankedStations stations, unless many
+         *  of the ranked stations emptied since the last call. Larger `k`
+         *  take a scan of all stations.
+         *
+         *  \param nScanned If set, receives the number of stations scanned: 0
+         *                  unless the ranking had to be rebuilt.
+         */
+        std::vector<std::pair<IdHandle, long long int>> GetMostCrowded(
+            size_t k,
+            size_t* nScanned = nullptr
+        ) const;
+
+    private:
+        // Aligned so that chunks of different shards never share a cache line.
+        struct alignas(64) Chunk {
+            std::array<std::atomic<long long int>, kChunkSize> counts;
+        };
+
+        struct Ranking {
+            std::mutex mutex {};
+            // At most kRankedStations stations.
+            std::vector<IdHandle> stations {};
+            // No unranked station has a count above the bound. Only changed
+            // with the mutex locked. Aligned so that reading it does not
+            // contend with the mutex.
+            alignas(64) std::atomic<long long int> bound {0};
+        };
+
+        // A ranked station has kRankedOffset added to its count in every
+        // shard, so that Add learns whether it is ranked from the same atomic
+        // add that updates its count. Counts stay far below the offset.
+        static constexpr long long int kRankedOffset {1ll << 62};
+
+        static bool IsRanked(long long int shardCount) {
+            return shardCount > kRankedOffset / 2;
+        }
+
+        static long long int Unflag(long long int shardCount) {
+            return IsRanked(shardCount) ? shardCount - kRankedOffset : shardCount;
+        }
+
+        static size_t GetThreadShard();
+
+        std::atomic<long long int>& Counter(size_t shard, IdHandle station) const {
+            return chunks_[station / kChunkSize * kShardCount + shard]->counts[station % kChunkSize];
+        }
+
+        /*! \brief Flag or unflag `station` as ranked in every shard. Called
+         *         with the ranking locked.
+         */
+        void SetRanked(IdHandle station, bool ranked) const;
+
+        void Rank(IdHandle station);
+
+        /*! \brief Rank the most crowded stations from scratch. Called with
+         *         the ranking locked.
+         */
+        void Rerank() const;
+
+        // The chunks of all shards for stations [0, kChunkSize), then
+        // [kChunkSize, 2 * kChunkSize), and so on.
+        std::vector<std::shared_ptr<Chunk>> chunks_ {};
+        std::shared_ptr<Ranking> ranking_;
+        size_t size_ {0};
+    };
+
+    /*! \brief Everything a query reads, frozen at one point in time.
+     *
+     *  A snapshot is never modified once published: changes to the network
+     *  publish a new one, so a query sees the same network from start to end
+     *  without taking any lock. Only the passenger counts and history are
+     *  live.
+     */
+    struct NetworkSnapshot {
+        // Set when the snapshot is published. Versions are unique across all
+        // networks, so cached routes can be tagged with them.
+        uint64_t version {0};
+
+        std::shared_ptr<const IdTable> stationIds;
+        std::shared_ptr<const IdTable> lineIds;
+        std::shared_ptr<const IdTable> routeIds;
+
+        std::shared_ptr<const CompactGraph> graph;
+        std::shared_ptr<const LandmarkTable> landmarks;
+        std::shared_ptr<const ContractionHierarchy> hierarchy;
+        std::shared_ptr<const Timetable> timetable;
+
+        std::shared_ptr<PassengerCounters> passengers;
+        // Null when no history is kept.
+        std::shared_ptr<OccupancyHistory> history;
+    };
+}
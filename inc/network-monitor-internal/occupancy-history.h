@@ -0,0 +1,89 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+#include "network-monitor/transport-network.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Passenger entries and exits per station and per second, over a
+     *         fixed number of past seconds.
+     *
+     *  Each station has one ring buffer of entries and one of exits, with a
+     *  slot per second of the horizon. A slot packs the second it counts for
+     *  with the count, so it is reset by the first event of a new second,
+     *  with no separate clean-up pass. Recording an event is then a couple of
+     *  atomic operations on one slot, and never allocates.
+     *
+     *  Like PassengerCounters, the buffers live in chunks of stations that a
+     *  copy made by Grow shares.
+     */
+    class OccupancyHistory {
+    public:
+        static constexpr size_t kChunkSize {64};
+
+        // The longest horizon for which the slot indices of a chunk fit in
+        // a uint32_t: about 776 days.
+        static constexpr uint32_t kMaxHorizon {
+            std::numeric_limits<uint32_t>::max() / kChunkSize};
+
+        struct Totals {
+            long long int entries {0};
+            long long int exits {0};
+        };
+
+        /*! \param horizon The number of seconds of history kept, up to
+         *                 kMaxHorizon.
+         */
+        explicit OccupancyHistory(uint32_t horizon);
+
+        /*! \brief Get a history for `nStations` stations that shares that of
+         *         the stations in this one.
+         */
+        OccupancyHistory Grow(size_t nStations) const;
+
+        /*! \brief Get a history with the same counts as this one, that does
+         *         not share them.
+         */
+        OccupancyHistory Clone() const;
+
+        uint32_t GetHorizon() const {
+            return horizon_;
+        }
+
+        /*! \brief Count an event at `station` in the second `second`.
+         *
+         *  The event is dropped if its slot already counts a later second,
+         *  which is then at least a horizon later. Otherwise it takes the
+         *  slot, and a slot that counted an earlier second is reset first.
+         */
+        void Add(IdHandle station, PassengerEvent::Type type, uint32_t second);
+
+        /*! \brief Add up the events at `station` in the seconds after `from`,
+         *         up to and including `to`.
+         *
+         *  Only the last horizon of seconds up to `to` is counted.
+         */
+        Totals GetTotals(IdHandle station, uint32_t from, uint32_t to) const;
+
+    private:
+        // Slots are (second << 32) | count.
+        using Slots = std::vector<std::atomic<uint64_t>>;
+
+        // The slots of station `idx` in the chunk start at idx * horizon.
+        struct Chunk {
+            Slots entries;
+            Slots exits;
+        };
+
+        static void Bump(std::atomic<uint64_t>& slot, uint32_t second);
+
+        uint32_t horizon_;
+        std::vector<std::shared_ptr<Chunk>> chunks_ {};
+    };
+}
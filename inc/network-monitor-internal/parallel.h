@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Get the number of threads to run on for a `nThreads`
+     *         argument, where 0 means one thread per core.
+     */
+    inline unsigned int GetThreadCount(unsigned int nThreads) {
+        return nThreads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : nThreads;
+    }
+
+    /*! \brief Run `work(worker)` once on each of `nThreads` threads.
+     *
+     *  Worker 0 runs on this thread. `work` must not throw.
+     */
+    template <typename Work>
+    void RunOnThreads(unsigned int nThreads, const Work& work) {
+        std::vector<std::thread> workers;
+        workers.reserve(nThreads - 1);
+        for (unsigned int worker = 1; worker < nThreads; ++worker) {
+            workers.emplace_back([&work, worker]() {
+                work(worker);
+            });
+        }
+        work(0u);
+        for (auto& thread : workers) {
+            thread.join();
+        }
+    }
+
+    /*! \brief Run `work(worker, begin, end)` on `nThreads` threads, over
+     *         [0, n) split into one contiguous range per worker.
+     *
+     *  The split only depends on `n` and `nThreads`. The first range runs on
+     *  this thread. `work` must not throw.
+     */
+    template <typename Work>
+    void RunInParallel(unsigned int nThreads, size_t n, const Work& work) {
+        RunOnThreads(nThreads, [&work, n, nThreads](unsigned int worker) {
+            work(worker, n * worker / nThreads, n * (worker + 1) / nThreads);
+        });
+    }
+}
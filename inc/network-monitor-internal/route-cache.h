@@ -0,0 +1,108 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+#include "network-monitor/transport-network.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Bounded, thread-safe LRU cache of route query results.
+     *
+     *  Entries are tagged with the version of the graph they were computed
+     *  on, and are only returned for that same version. Invalidating the whole
+     *  cache is then just a matter of using a new version: stale entries are
+     *  dropped when looked up on a newer version or when they fall off the
+     *  LRU list. Versions only grow, so a lookup or insertion on an older
+     *  version leaves the entries of a newer one in place.
+     *
+     *  The cache is split into shards, each with its own lock and LRU list,
+     *  so concurrent queries rarely contend.
+     */
+    class RouteCache {
+    public:
+        struct Key {
+            IdHandle stationA;
+            IdHandle stationB;
+            RouteSearchMode mode;
+
+            bool operator==(const Key& other) const {
+                return stationA == other.stationA
+                    && stationB == other.stationB
+                    && mode == other.mode;
+            }
+        };
+
+        /*! \param capacity The maximum number of cached routes. 0 disables
+         *                  the cache.
+         */
+        explicit RouteCache(size_t capacity);
+
+        /*! \brief Get the route cached for `key` on the `version` graph.
+         */
+        std::optional<TravelRoute> Find(const Key& key, uint64_t version);
+
+        /*! \brief Cache a route, evicting the least recently used one in its
+         *         shard if needed.
+         *
+         *  A route already cached for `key` on a newer version is kept.
+         */
+        void Insert(const Key& key, uint64_t version, const TravelRoute& route);
+
+        /*! \brief Let the routes cached on the `fromVersion` graph that
+         *         `isKept` accepts be returned for the `toVersion` graph too.
+         *
+         *  The other routes cached on the `fromVersion` graph are dropped.
+         *  Used after a change that leaves some cached journeys optimal, such
+         *  as one that only makes journeys longer.
+         */
+        void Carry(
+            uint64_t fromVersion,
+            uint64_t toVersion,
+            const std::function<bool (const TravelRoute&)>& isKept
+        );
+
+        RouteCacheStats GetStats() const;
+
+    private:
+        struct KeyHash {
+            size_t operator()(const Key& key) const {
+                uint64_t hash = (static_cast<uint64_t>(key.stationA) << 32) | key.stationB;
+                hash ^= static_cast<uint64_t>(key.mode) * 0x9e3779b97f4a7c15ull;
+                hash *= 0xbf58476d1ce4e5b9ull;
+                return static_cast<size_t>(hash ^ (hash >> 31));
+            }
+        };
+
+        struct Entry {
+            Key key;
+            uint64_t version;
+            TravelRoute route;
+        };
+
+        struct Shard {
+            std::mutex mutex {};
+            // Most recently used first.
+            std::list<Entry> entries {};
+            std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index {};
+            size_t capacity {0};
+        };
+
+        Shard& GetShard(const Key& key);
+
+        size_t capacity_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+
+        std::atomic<size_t> hits_ {0};
+        std::atomic<size_t> misses_ {0};
+        std::atomic<size_t> evictions_ {0};
+    };
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+#include "network-monitor/transport-network.h"
+#include "network-monitor-internal/transport-network-internal.h"
+#include "network-monitor-internal/network-snapshot.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace NetworkMonitor {
+    struct LandmarkTable;
+
+    /*! \brief How a route search weighs each step.
+     *
+     *  The searches dispatch on the profile kind once, and then run with the
+     *  step costs of that kind inlined.
+     */
+    struct RouteCostModel {
+        RouteProfile profile;
+        // Added to the travel time of each line change, whatever the
+        // profile.
+        unsigned int penalty;
+        // Only read by the profiles that count passengers.
+        const PassengerCounters* passengers;
+        // If set, added to the metric of each step, indexed by edge.
+        const std::vector<unsigned int>* edgeSurcharges {nullptr};
+    };
+
+    /*! \brief Reusable scratch space for route searches.
+     *
+     *  All arrays are indexed by route state (see CompactGraph). A state only
+     *  holds valid data if its generation matches the current one, so
+     *  starting a new search is O(1) and, once the arrays have grown to the
+     *  size of the graph, allocates nothing.
+     */
+    struct RoutingWorkspace {
+        struct QueueEntry {
+            unsigned int metric;
+            uint32_t state;
+
+            bool operator>(const QueueEntry& other) const {
+                return metric > other.metric;
+            }
+        };
+
+        /*! \brief Invalidate all states and size the arrays for `nStates`.
+         */
+        void Reset(size_t nStates);
+
+        bool IsReached(uint32_t state) const {
+            return generation_[state] == currentGeneration_;
+        }
+
+        void Reach(uint32_t state, unsigned int metric, unsigned int distance, uint32_t parent) {
+            generation_[state] = currentGeneration_;
+            metric_[state] = metric;
+            distance_[state] = distance;
+            parent_[state] = parent;
+        }
+
+        /*! \brief A journey to a state in a multi-criteria search.
+         */
+        struct Label {
+            unsigned int distance;
+            unsigned int metric;
+            // Lower bound of the distance of any journey to the target that
+            // extends this one.
+            unsigned int estimate;
+            uint32_t state;
+            // Index of the label this one extends, or CompactGraph::kNoIndex
+            // at the origin.
+            uint32_t parent;
+        };
+
+        /*! \brief A queued label, with the keys it is ordered by.
+         */
+        struct LabelEntry {
+            unsigned int estimate;
+            unsigned int metric;
+            uint32_t label;
+        };
+
+        void Push(unsigned int metric, uint32_t state);
+
+        QueueEntry Pop();
+
+        std::vector<uint32_t> generation_;
+        std::vector<unsigned int> metric_;
+        std::vector<unsigned int> distance_;
+        std::vector<uint32_t> parent_;
+        std::vector<QueueEntry> queue_;
+        uint32_t currentGeneration_ {0};
+
+        // Number of states settled since the last reset.
+        size_t settledStates_ {0};
+
+        // Labels of a multi-criteria search, and the heap of the ones still
+        // to be settled.
+        std::vector<Label> labels_;
+        std::vector<LabelEntry> labelQueue_;
+
+        // Per-edge metric surcharges of an alternative route search.
+        std::vector<unsigned int> edgeSurcharges_;
+
+        // Output buffers for ExtractPath.
+        std::vector<uint32_t> pathStates_;
+        std::vector<unsigned int> pathDistances_;
+    };
+
+    /*! \brief Run a search from the `source` station.
+     *
+     *  The search stops as soon as the best state of the `target` station is
+     *  settled. Pass kInvalidIdHandle as `target` to search the whole
+     *  network, or as much of it as is within `maxMetric`.
+     *
+     *  On return, every settled state is reached in `workspace` with its
+     *  optimal metric, the travel time (including line change penalties)
+     *  along that path, and its parent state. The origin state is its own
+     *  parent.
+     *
+     *  \returns The best state of `target`, or CompactGraph::kNoIndex if it
+     *           cannot be reached.
+     */
+    uint32_t SearchRoutes(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        RoutingWorkspace& workspace,
+        unsigned int maxMetric = std::numeric_limits<unsigned int>::max()
+    );
+
+    /*! \brief Run an A* search from `source` to `target`, guided by the
+     *         landmark travel time lower bounds.
+     *
+     *  Only valid for RouteProfile::Kind::kFastest costs. The results are
+     *  the same as with SearchRoutes, but states that cannot be on a journey
+     *  shorter than the best one are not settled. With no landmarks this is
+     *  a plain Dijkstra search.
+     */
+    uint32_t SearchRoutesAStar(
+        const CompactGraph& graph,
+        const LandmarkTable& landmarks,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        RoutingWorkspace& workspace
+    );
+
+    /*! \brief Run a search from both `source` and `target` until the two
+     *         searches provably meet on the best journey.
+     *
+     *  `forward` is filled as in SearchRoutes. `backward` holds, for each
+     *  state it reached, the cost to get from that state to `target` and the
+     *  next state on the way there, with the states of `target` being their
+     *  own successors.
+     *
+     *  \returns The state where the best journey goes through both
+     *           searches, or CompactGraph::kNoIndex if `target` cannot be
+     *           reached.
+     */
+    uint32_t SearchRoutesBidirectional(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        RoutingWorkspace& forward,
+        RoutingWorkspace& backward
+    );
+
+    /*! \brief Find the journey from `source` to `target` with the lowest
+     *         metric, among those with a travel time under `maxDistance` and
+     *         a metric under `maxMetric`.
+     *
+     *  Journeys are settled by metric, and a journey to a state is only kept
+     *  if it is faster than all the less costly ones to that state: this is
+     *  the Pareto set over (metric, travel time), cut off by the two bounds.
+     *  The first journey to reach `target` is the answer. If set, the
+     *  `landmarks` lower bounds discard the journeys that cannot reach
+     *  `target` in time.
+     *
+     *  Travel times are as in SearchRoutes. Ties on the metric go to the
+     *  fastest journey.
+     *
+     *  \returns The index of the label of the journey in `workspace.labels_`,
+     *           or CompactGraph::kNoIndex if there is no such journey.
+     */
+    uint32_t SearchRoutesPareto(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        double maxDistance,
+        unsigned int maxMetric,
+        const LandmarkTable* landmarks,
+        RoutingWorkspace& workspace
+    );
+
+    /*! \brief Get the metric of a journey over route states.
+     */
+    unsigned int GetPathMetric(
+        const CompactGraph& graph,
+        const RouteCostModel& costs,
+        const std::vector<uint32_t>& states
+    );
+
+    /*! \brief Unwind the journey of a label of SearchRoutesPareto.
+     *
+     *  \param states    The states of the journey, origin first.
+     *  \param distances The travel time from the origin to each state.
+     */
+    void ExtractLabelPath(
+        const RoutingWorkspace& workspace,
+        uint32_t label,
+        std::vector<uint32_t>& states,
+        std::vector<unsigned int>& distances
+    );
+
+    /*! \brief Get the reached state of `station` with the lowest metric.
+     *
+     *  \returns CompactGraph::kNoIndex if no state of `station` was reached.
+     */
+    uint32_t FindBestState(
+        const CompactGraph& graph,
+        const RoutingWorkspace& workspace,
+        IdHandle station
+    );
+
+    /*! \brief Get the travel time of the best journey to every station, after
+     *         a search of the whole network.
+     *
+     *  Only valid for RouteProfile::Kind::kFastest costs, where the
+     *  best state of a station is also the fastest. This is one pass over
+     *  the route states, rather than a FindBestState per station. Stations
+     *  with no state reached within `maxMetric` get
+     *  std::numeric_limits<unsigned int>::max().
+     *
+     *  \param distances Indexed by station handle.
+     */
+    void GetStationDistances(
+        const CompactGraph& graph,
+        const RoutingWorkspace& workspace,
+        unsigned int maxMetric,
+        std::vector<unsigned int>& distances
+    );
+
+    /*! \brief Unwind the journey ending in `lastState`.
+     *
+     *  If `backward` is set, `lastState` is a meeting state of a
+     *  bidirectional search and the journey continues along its successors.
+     *
+     *  \param states    The states of the journey, origin first.
+     *  \param distances The travel time from the origin to each state.
+     */
+    void ExtractPath(
+        const RoutingWorkspace& forward,
+        const RoutingWorkspace* backward,
+        uint32_t lastState,
+        std::vector<uint32_t>& states,
+        std::vector<unsigned int>& distances
+    );
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Read-only array that copies share until one of them is changed.
+     *
+     *  Copying one is copying a shared pointer, so a patched copy of a large
+     *  structure of arrays only pays for the arrays it changes. Reads go
+     *  through a cached pointer to the values, as with a std::vector.
+     */
+    template <typename T>
+    class SharedArray {
+    public:
+        SharedArray() = default;
+
+        SharedArray(std::vector<T> values)
+            : values_(std::make_shared<std::vector<T>>(std::move(values))) {
+            data_ = values_->data();
+            size_ = values_->size();
+        }
+
+        template <typename InputIt>
+        SharedArray(InputIt first, InputIt last)
+            : SharedArray(std::vector<T>(first, last)) {
+        }
+
+        const T& operator[](size_t idx) const {
+            return data_[idx];
+        }
+
+        const T* begin() const {
+            return data_;
+        }
+
+        const T* end() const {
+            return data_ + size_;
+        }
+
+        const T* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        const T& front() const {
+            return data_[0];
+        }
+
+        const T& back() const {
+            return data_[size_ - 1];
+        }
+
+        /*! \brief Get the values to change in place, copying them first if
+         *         another array shares them.
+         *
+         *  Only call on an array no other thread can read.
+         */
+        T* Mutable() {
+            if (values_ != nullptr && values_.use_count() > 1) {
+                *this = SharedArray(*values_);
+            }
+            return const_cast<T*>(data_);
+        }
+
+    private:
+        std::shared_ptr<std::vector<T>> values_ {};
+        const T* data_ {nullptr};
+        size_t size_ {0};
+    };
+}
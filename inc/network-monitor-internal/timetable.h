@@ -0,0 +1,129 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+#include "network-monitor/transport-network.h"
+#include "network-monitor-internal/transport-network-internal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace NetworkMonitor {
+    /*! \brief Frozen, read-optimized departure times of the routes.
+     *
+     *  Indexed by route handle. The explicit departures of route `r`, if any,
+     *  are `departures_[departureOffsets_[r] .. departureOffsets_[r + 1])`.
+     *  Otherwise its trips leave the first stop every `headways_[r]` from
+     *  `firstDepartures_[r]` to `lastDepartures_[r]`, or whenever a passenger
+     *  boards if the headway is 0.
+     */
+    struct Timetable {
+        static constexpr unsigned int kNoTrip = std::numeric_limits<unsigned int>::max();
+
+        /*! \param timetables The timetables of the routes that have one.
+         *                    The other routes run whenever a passenger
+         *                    boards.
+         */
+        static Timetable Build(
+            size_t nRoutes,
+            const std::unordered_map<IdHandle, RouteTimetable>& timetables
+        );
+
+        /*! \brief Get when the first trip of `route` that leaves its first stop
+         *         at `time` or later leaves it.
+         *
+         *  \returns kNoTrip if there is no such trip.
+         */
+        unsigned int GetNextDeparture(IdHandle route, unsigned int time) const;
+
+        std::vector<unsigned int> headways_;
+        std::vector<unsigned int> firstDepartures_;
+        std::vector<unsigned int> lastDepartures_;
+        std::vector<uint32_t> departureOffsets_;
+        std::vector<unsigned int> departures_;
+    };
+
+    /*! \brief Reusable scratch space for timetable searches.
+     *
+     *  The labels are indexed by [round * route stop count + route stop], the
+     *  route stops being those of CompactGraph::routeStops_. As in
+     *  RoutingWorkspace, a label or a station only holds valid data if its
+     *  generation matches the current one, so starting a new search is O(1)
+     *  once the arrays have grown to the size of the network.
+     */
+    struct TimetableWorkspace {
+        /*! \brief The earliest arrival at a route stop with a given number of
+         *         trips, and the trip that gets there.
+         */
+        struct Label {
+            unsigned int arrival;
+            IdHandle route;
+            // When the trip leaves the first stop of the route.
+            unsigned int tripDeparture;
+            // Positions along the route of the stops the trip is boarded and
+            // left at.
+            uint32_t boardPosition;
+            uint32_t alightPosition;
+            // The label the trip is boarded from, or CompactGraph::kNoIndex if
+            // it is boarded at the origin.
+            uint32_t boardLabel;
+            uint32_t generation;
+        };
+
+        /*! \brief Invalidate all labels and size the arrays.
+         */
+        void Reset(size_t nStations, size_t nRouteStops, size_t nRoutes, size_t nRounds);
+
+        std::vector<Label> labels_;
+        size_t nRouteStops_ {0};
+
+        // Indexed by station: the earliest arrival so far and the line it is
+        // on, and the earliest one on any other line. A label at a station
+        // is only kept if neither of them beats it.
+        std::vector<uint32_t> stationGenerations_;
+        std::vector<unsigned int> bestArrivals_;
+        std::vector<IdHandle> bestLines_;
+        std::vector<unsigned int> otherArrivals_;
+        std::vector<IdHandle> otherLines_;
+
+        // The stations labelled in the last round, and the routes to scan in
+        // the next one, with the earliest position to scan them from.
+        std::vector<IdHandle> markedStations_;
+        std::vector<bool> isMarked_;
+        std::vector<IdHandle> queuedRoutes_;
+        std::vector<uint32_t> queuedPositions_;
+
+        uint32_t currentGeneration_ {0};
+
+        // Number of route stops scanned since the last reset.
+        size_t scannedStops_ {0};
+    };
+
+    /*! \brief Find the earliest arrival at `target` when leaving `source` at
+     *         `departureTime`, with up to `nRounds` trips (RAPTOR).
+     *
+     *  Round k rides the trips that can be boarded from the labels of round
+     *  k - 1, along the stop sequences of their routes. Boarding a route of
+     *  another line than the one the passenger arrived on takes
+     *  `changeTime`, so a later arrival on one line can be worth keeping
+     *  next to an earlier one on another: labels live on route stops rather
+     *  than stations, and only the ones an earlier arrival at the same
+     *  station cannot beat, nor the best one at `target`, are kept.
+     *  Passengers can neither board nor leave a trip at a closed station.
+     *
+     *  \returns The index in `workspace.labels_` of the earliest arrival at
+     *           `target`, or CompactGraph::kNoIndex if it cannot be reached.
+     */
+    uint32_t SearchEarliestArrival(
+        const CompactGraph& graph,
+        const Timetable& timetable,
+        IdHandle source,
+        IdHandle target,
+        unsigned int departureTime,
+        unsigned int changeTime,
+        size_t nRounds,
+        TimetableWorkspace& workspace
+    );
+}
@@ -1,51 +1,219 @@
 #pragma once
 
 #include "network-monitor/transport-network-defs.h"
+#include "network-monitor-internal/shared-array.h"
 
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
-#include <unordered_set>
+#include <unordered_map>
+#include <utility>
 
 namespace NetworkMonitor {
-    struct RouteMetadata {
-        Id lineId;
-        Id routeId;
-        unsigned int travelTime;
-        
-        RouteMetadata(Id lineId, Id routeId, unsigned int travelTime)
-            : lineId(lineId), routeId(routeId), travelTime(travelTime) {}
-    };
-
     struct RouteEdge {
-        bool AddRoute(const Id& routeId, const Id& lineId);
-
-        bool HasRoute(const Id& lineId, const Id& routeId) const;
+        bool AddRoute(IdHandle routeId);
 
-        std::vector<Id> GetRoutes(const Id& lineId) const;
+        bool HasRoute(IdHandle routeId) const;
 
-        std::vector<Id> GetRoutes() const;
-
-        std::vector<RouteMetadata> GetRouteMetadata() const;
+        bool RemoveRoute(IdHandle routeId);
 
         unsigned int travelTime_;
-        std::unordered_map<Id, std::vector<Id>> lineToRouteIds_;
+        std::vector<IdHandle> routeIds_;
     };
 
     struct StationNode {
-        std::shared_ptr<RouteEdge> GetOrMakeEdge(const Id& endStationId);
-
-        bool AddIncomingEdge(const Id& fromStationId, std::shared_ptr<RouteEdge> edge);
-
-        RouteEdge* GetEdge(const Id& stationId);
-
-        const RouteEdge* GetEdge(const Id& stationId) const;
-
-        std::unordered_map<Id, std::vector<RouteMetadata>> GetStationIdToRoutesMetadata() const;
-
-        std::vector<Id> GetRoutes() const;
+        /*! \brief Get the index of the edge to `endStationId` in `edges`,
+         *         creating the edge if needed.
+         */
+        uint32_t GetOrMakeEdge(IdHandle endStationId, std::vector<RouteEdge>& edges);
+
+        /*! \brief Get the index of the edge to `stationId`.
+         *
+         *  \returns CompactGraph::kNoIndex if the two stations are not
+         *           adjacent.
+         */
+        uint32_t GetEdge(IdHandle stationId) const;
+
+        std::unordered_map<IdHandle, uint32_t> toStationIdToEdge_;
+    };
 
-        int passengers_;
-        std::unordered_map<Id, std::shared_ptr<RouteEdge>> toStationIdToEdge_;
-        std::unordered_map<Id, std::shared_ptr<RouteEdge>> fromStationIdToEdge_;
+    /*! \brief Frozen, read-optimized adjacency of the network.
+     *
+     *  Station and route indices are their interned handles. The outgoing
+     *  edges of station `s` are the edge indices in
+     *  [edgeOffsets_[s], edgeOffsets_[s + 1]), sorted by target station. The
+     *  routes running over edge `e` are
+     *  `edgeRoutes_[edgeRouteOffsets_[e] .. edgeRouteOffsets_[e + 1])`.
+     *
+     *  The incoming edges of station `s` are
+     *  `inEdges_[inEdgeOffsets_[s] .. inEdgeOffsets_[s + 1])`.
+     *
+     *  Routing runs over route states, i.e. (station, route) pairs. State `s`
+     *  for `s` < the station count is station `s` with no route (a journey
+     *  origin). The states for station `s` reached on each of its arriving
+     *  routes are in [stationStateOffsets_[s], stationStateOffsets_[s + 1]).
+     *  `edgeRouteStates_` runs parallel to `edgeRoutes_` and holds the state
+     *  each edge route slot leads to.
+     *
+     *  An edge can have no route slots left once routes are taken off it, and
+     *  a state no slot leads to any more. Neither is ever reached.
+     *
+     *  The edges route `r` runs over are
+     *  `routeEdges_[routeEdgeOffsets_[r] .. routeEdgeEnds_[r])`, sorted.
+     *
+     *  The stops of route `r`, in order, are
+     *  `routeStops_[routeStopOffsets_[r] .. routeStopEnds_[r])`, and
+     *  `routeStopTimes_` holds the travel time from the first stop to each.
+     *  A route is the path its edges make from the one stop no edge of the
+     *  route arrives at, or a loop back to its first stop if there is no such
+     *  stop. `stateStopPositions_` runs parallel to `stateRoutes_` and holds
+     *  the position of each state along its route.
+     *
+     *  The stops at station `s` are
+     *  [stationStopOffsets_[s], stationStopEnds_[s]) in `stationStopRoutes_`
+     *  and `stationStopPositions_`, as (route, position along the route)
+     *  pairs sorted by route, then position.
+     *
+     *  Each of these ranges can end before the next one starts, so that
+     *  routes taken off and put back on their edges are laid out again in
+     *  place.
+     *
+     *  The arrays are shared between copies of a graph until they are
+     *  changed, so a patched copy only pays for the arrays it patches.
+     */
+    struct CompactGraph {
+        static constexpr uint32_t kNoIndex = std::numeric_limits<uint32_t>::max();
+
+        static CompactGraph Build(
+            const std::vector<StationNode>& nodes,
+            const std::vector<RouteEdge>& edges,
+            const std::vector<IdHandle>& routeLines
+        );
+
+        /*! \brief Derive every other array from `routeLines_` and the sorted
+         *         edge arrays: `edgeOffsets_`, `edgeTargets_`,
+         *         `edgeTravelTimes_`, `edgeRouteOffsets_` and `edgeRoutes_`.
+         *
+         *  Only call on a graph with no other array filled in yet.
+         */
+        void BuildIndices();
+
+        size_t GetStationCount() const;
+
+        size_t GetStateCount() const;
+
+        uint32_t FindEdge(IdHandle fromStation, IdHandle toStation) const;
+
+        std::vector<IdHandle> GetRoutesServingStation(IdHandle station) const;
+
+        /*! \brief Get the state of `station` reached on `route`.
+         *
+         *  \returns kNoIndex if `route` does not arrive at `station`.
+         */
+        uint32_t FindState(IdHandle station, IdHandle route) const;
+
+        /*! \brief Get the travel time from `fromStation` to `toStation` along
+         *         `route`, in O(log(routes per station)).
+         *
+         *  \returns 0 if `route` does not run from one station to the other,
+         *           or if they are the same station.
+         */
+        unsigned int GetRouteTravelTime(
+            IdHandle route,
+            IdHandle fromStation,
+            IdHandle toStation
+        ) const;
+
+        /*! \brief Recompute the travel times along the routes running over
+         *         `edges`, once their travel times have changed.
+         */
+        void UpdateRouteTimes(const std::vector<uint32_t>& edges);
+
+        /*! \brief Get the edges `route` runs over, in O(route length).
+         */
+        std::vector<uint32_t> GetRouteEdges(IdHandle route) const;
+
+        /*! \brief Take routes off edges and put routes on edges, in place.
+         *
+         *  `removed` and `added` hold (edge, route) pairs. The edges and
+         *  states stay as they are, so this is one pass over the route slots,
+         *  and only the routes taken off or put on edges are laid out again.
+         *
+         *  \returns false, leaving the graph unchanged, if a route is added to
+         *           an edge whose target station has no state for it, i.e. the
+         *           graph was built without the route there.
+         */
+        bool UpdateEdgeRoutes(
+            std::vector<std::pair<uint32_t, IdHandle>> removed,
+            std::vector<std::pair<uint32_t, IdHandle>> added
+        );
+
+        /*! \brief Whether passengers can neither start, end nor change routes
+         *         at `station`. Routes still run through it.
+         */
+        bool IsClosed(IdHandle station) const {
+            return !closedStations_.empty() && closedStations_[station] != 0;
+        }
+
+        SharedArray<IdHandle> routeLines_;
+
+        SharedArray<uint32_t> edgeOffsets_;
+        SharedArray<IdHandle> edgeSources_;
+        SharedArray<IdHandle> edgeTargets_;
+        SharedArray<unsigned int> edgeTravelTimes_;
+        SharedArray<uint32_t> edgeRouteOffsets_;
+        SharedArray<IdHandle> edgeRoutes_;
+
+        SharedArray<uint32_t> inEdgeOffsets_;
+        SharedArray<uint32_t> inEdges_;
+
+        SharedArray<uint32_t> stationStateOffsets_;
+        SharedArray<IdHandle> stateStations_;
+        SharedArray<IdHandle> stateRoutes_;
+        SharedArray<uint32_t> edgeRouteStates_;
+
+        SharedArray<uint32_t> routeEdgeOffsets_;
+        SharedArray<uint32_t> routeEdgeEnds_;
+        SharedArray<uint32_t> routeEdges_;
+
+        SharedArray<uint32_t> routeStopOffsets_;
+        SharedArray<uint32_t> routeStopEnds_;
+        SharedArray<IdHandle> routeStops_;
+        SharedArray<unsigned int> routeStopTimes_;
+        SharedArray<uint32_t> stateStopPositions_;
+        SharedArray<uint32_t> stationStopOffsets_;
+        SharedArray<uint32_t> stationStopEnds_;
+        SharedArray<IdHandle> stationStopRoutes_;
+        SharedArray<uint32_t> stationStopPositions_;
+
+        // Indexed by station, or empty if no station is closed.
+        SharedArray<uint8_t> closedStations_;
+
+    private:
+        /*! \brief Lay the routes out as stop sequences, from the route slots
+         *         of the edges.
+         */
+        void BuildRouteStops();
+
+        /*! \brief Lay out the stops of the routes in `removed` and `added`
+         *         again, in the room they have, once the route slots of the
+         *         edges are updated.
+         *
+         *  \returns false if a route or station has no room left for its
+         *           stops, leaving the graph to be laid out with
+         *           BuildRouteStops.
+         */
+        bool UpdateRouteStops(
+            const std::vector<std::pair<uint32_t, IdHandle>>& removed,
+            const std::vector<std::pair<uint32_t, IdHandle>>& added
+        );
+
+        /*! \brief Get the position of `station` along `route`, its first if
+         *         the route stops there more than once.
+         */
+        uint32_t FindRouteStop(IdHandle route, IdHandle station) const;
+
+        void ComputeRouteTimes(IdHandle route, unsigned int* routeStopTimes) const;
     };
-}
\ No newline at end of file
+}
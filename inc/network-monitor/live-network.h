@@ -0,0 +1,194 @@
+#pragma once
+
+#include "network-monitor/transport-network.h"
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Log an event of the network monitor or of its live network.
+ */
+inline void LogMonitorEvent(const std::string& source, const std::string& msg) {
+    std::cout << " " << source << " | " << msg << std::endl;
+}
+
+/*! \brief The network passenger events are recorded on, which a new layout
+ *         can replace without stopping the event stream.
+ *
+ *  Events are recorded, and new layouts swapped in, on an io_context that
+ *  runs on a single thread.
+ */
+class LiveNetwork {
+public:
+    explicit LiveNetwork(boost::asio::io_context& ioc) : ioc_(ioc) {};
+
+    ~LiveNetwork() {
+        if (reloadThread_.joinable()) {
+            reloadThread_.join();
+        }
+    }
+
+    LiveNetwork(const LiveNetwork& other) = delete;
+
+    LiveNetwork& operator=(const LiveNetwork& other) = delete;
+
+    /*! \brief Load the first network layout, before the io_context runs.
+     *
+     *  \returns false if the layout could not be loaded. The network is left
+     *           unchanged.
+     */
+    bool Load(const std::string& networkLayoutPath, NetworkLoadStats& loadStats) {
+        auto network = std::make_shared<TransportNetwork>();
+        if (!LoadNetwork(*network, networkLayoutPath, loadStats)) {
+            return false;
+        }
+        std::atomic_store(&network_, std::move(network));
+        return true;
+    }
+
+    /*! \brief Load a new network layout and swap it in for the current one.
+     *
+     *  The layout is loaded on a separate thread. The swap then runs on the
+     *  io_context, between two passenger events: the passenger counts of the
+     *  stations still in the layout are carried over, and events received
+     *  while the layout loads or is swapped in are recorded on the new one.
+     *  The time the swap holds up the event stream is logged.
+     *
+     *  \param onReloaded If set, called on the io_context once the reload
+     *                    is over, with whether it succeeded.
+     *
+     *  \returns false if a reload is already running.
+     */
+    bool Reload(
+        const std::string& networkLayoutPath,
+        std::function<void (bool)> onReloaded = nullptr
+    ) {
+        if (reloading_.exchange(true)) {
+            return false;
+        }
+        if (reloadThread_.joinable()) {
+            reloadThread_.join();
+        }
+        // Keeps the io_context running until the swap is posted.
+        auto work = boost::asio::make_work_guard(ioc_);
+        reloadThread_ = std::thread([this, networkLayoutPath, onReloaded, work]() {
+            auto network = std::make_shared<TransportNetwork>();
+            NetworkLoadStats loadStats {};
+            bool loaded {false};
+            try {
+                loaded = LoadNetwork(*network, networkLayoutPath, loadStats);
+            } catch (const std::exception& e) {
+                LogMonitorEvent("Reload", std::string {"error: "} + e.what());
+            }
+            const auto loadedAt = std::chrono::steady_clock::now();
+            boost::asio::post(ioc_, [this, network, loaded, loadStats, loadedAt, onReloaded]() {
+                if (loaded) {
+                    SwapNetwork(network, loadStats, loadedAt);
+                } else {
+                    LogMonitorEvent("Reload", "could not load the network layout");
+                }
+                reloading_ = false;
+                if (onReloaded) {
+                    onReloaded(loaded);
+                }
+            });
+        });
+        return true;
+    }
+
+    /*! \brief Swap `network` in for the current one, carrying the passenger
+     *         counts over.
+     *
+     *  Only call on the io_context. Reload calls this once the layout is
+     *  loaded.
+     *
+     *  \param loadedAt When `network` finished loading, for the log.
+     */
+    void SwapNetwork(
+        const std::shared_ptr<TransportNetwork>& network,
+        const NetworkLoadStats& loadStats,
+        std::chrono::steady_clock::time_point loadedAt
+    ) {
+        const auto start = std::chrono::steady_clock::now();
+        // Only this thread records passenger events, so no event comes in
+        // between carrying the counts over and the swap.
+        const auto nDropped = network->AddPassengerCounts(*network_);
+        std::atomic_store(&network_, network);
+        const auto end = std::chrono::steady_clock::now();
+        auto toMicroseconds = [](auto duration) {
+            return std::to_string(
+                std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+        };
+        LogMonitorEvent("Reload", "network layout loaded in "
+            + std::to_string(loadStats.loadTime.count()) + "us, swapped in "
+            + toMicroseconds(end - start) + "us, "
+            + toMicroseconds(end - loadedAt) + "us after loading; "
+            + std::to_string(nDropped) + " stations dropped");
+    }
+
+    /*! \brief Record `event` on the current network.
+     *
+     *  Only call on the io_context. Events queued before the batch is
+     *  recorded go in the same batch, on whichever network is current by
+     *  then.
+     */
+    void QueuePassengerEvent(PassengerEvent event) {
+        if (pendingEvents_.empty()) {
+            boost::asio::post(ioc_, [this]() {
+                RecordPendingEvents();
+            });
+        }
+        pendingEvents_.push_back(std::move(event));
+    }
+
+    /*! \brief Get the network passenger events are recorded on.
+     *
+     *  Thread-safe. The network stays valid while it is held, even if a
+     *  reload swaps in a new one.
+     */
+    std::shared_ptr<const TransportNetwork> GetNetwork() const {
+        return std::atomic_load(&network_);
+    }
+
+    /*! \brief Load a binary layout image or a JSON layout file.
+     */
+    static bool LoadNetwork(
+        TransportNetwork& network,
+        const std::string& networkLayoutPath,
+        NetworkLoadStats& loadStats
+    ) {
+        // A layout compiled with compile-layout loads with no parsing.
+        return TransportNetwork::IsLayoutImage(networkLayoutPath)
+            ? network.FromLayoutImage(networkLayoutPath, &loadStats)
+            : network.FromJsonFile(networkLayoutPath, &loadStats);
+    }
+
+private:
+    void RecordPendingEvents() {
+        const auto nFailed = network_->RecordPassengerEvents(pendingEvents_);
+        if (nFailed > 0) {
+            LogMonitorEvent("RecordPendingEvents", std::to_string(nFailed) + " events at unknown stations");
+        }
+        pendingEvents_.clear();
+    }
+
+    boost::asio::io_context& ioc_;
+    // Only written on the io_context, and read elsewhere with
+    // std::atomic_load.
+    std::shared_ptr<TransportNetwork> network_ {std::make_shared<TransportNetwork>()};
+    std::vector<PassengerEvent> pendingEvents_ {};
+    std::atomic<bool> reloading_ {false};
+    std::thread reloadThread_ {};
+};
+
+} // namespace NetworkMonitor
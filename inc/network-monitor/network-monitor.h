@@ -1,11 +1,15 @@
 #pragma once
 
+#include "network-monitor/live-network.h"
 #include "network-monitor/transport-network.h"
 #include "network-monitor/stomp-client.h"
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
 #include <fstream>
 
@@ -27,9 +31,13 @@ public:
     NetworkMonitor() : ctx_{boost::asio::ssl::context::tlsv12_client} {};
 
     bool Configure(const NetworkMonitorConfig& config) {
-        if (!network_.FromJson(nlohmann::json::parse(std::ifstream{config.networkLayoutPath}))) {
+        NetworkLoadStats loadStats {};
+        if (!network_.Load(config.networkLayoutPath, loadStats)) {
             return false;
         }
+        LogMonitorEvent("Configure", "network layout loaded in "
+            + std::to_string(loadStats.loadTime.count()) + "us, peak memory "
+            + std::to_string(loadStats.peakMemory / 1024) + "kB");
         ctx_.load_verify_file(config.certPath);
         client_ = std::make_unique<Client>(
             config.url,
@@ -43,13 +51,13 @@ public:
             config.password,
             [this, config = std::move(config)](StompClientError error, std::string&& msg) {
                 if (error == StompClientError::kOk) {
-                    Log("OnConnect", "ok");
+                    LogMonitorEvent("OnConnect", "ok");
                     client_->Subscribe(
                         [this](StompClientError error, std::string&& msg) {
                             if (error == StompClientError::kOk) {
-                                Log("OnSubscribe", "ok");
+                                LogMonitorEvent("OnSubscribe", "ok");
                             } else {
-                                Log("OnSubscribe", "error: " + msg);
+                                LogMonitorEvent("OnSubscribe", "error: " + msg);
                             }
                         },
                         [this](StompClientError error, std::string&& msg) {
@@ -57,14 +65,14 @@ public:
                         }
                     );
                 } else {
-                    Log("OnConnect", "error: " + msg);
+                    LogMonitorEvent("OnConnect", "error: " + msg);
                 }
             },
             [this](StompClientError error, std::string&& msg) {
                 if (error == StompClientError::kOk) {
-                    Log("OnDisconnect", "ok");
+                    LogMonitorEvent("OnDisconnect", "ok");
                 } else {
-                    Log("OnDisconnect", "error: " + msg);
+                    LogMonitorEvent("OnDisconnect", "error: " + msg);
                 }
             }
         );
@@ -82,18 +90,41 @@ public:
             client_->Close(
                 [this](StompClientError error) {
                     if (error == StompClientError::kOk) {
-                        Log("OnClose", "ok");
+                        LogMonitorEvent("OnClose", "ok");
                     } else {
-                        Log("OnClose", "error");
+                        LogMonitorEvent("OnClose", "error");
                     }
                 }
             );
         });
         ioc_.run();
     }
+
+    /*! \brief Load a new network layout and swap it in for the current one,
+     *         without stopping the passenger event stream.
+     *
+     *  See LiveNetwork::Reload.
+     *
+     *  \returns false if a reload is already running.
+     */
+    bool Reload(
+        const std::string& networkLayoutPath,
+        std::function<void (bool)> onReloaded = nullptr
+    ) {
+        return network_.Reload(networkLayoutPath, std::move(onReloaded));
+    }
+
+    /*! \brief Get the network passenger events are recorded on.
+     *
+     *  Thread-safe. The network stays valid while it is held, even if a
+     *  reload swaps in a new one.
+     */
+    std::shared_ptr<const TransportNetwork> GetNetwork() const {
+        return network_.GetNetwork();
+    }
 private:
     void OnMessage(StompClientError error, std::string&& msg) {
-        Log("Received:", msg);
+        LogMonitorEvent("Received:", msg);
         if (error == StompClientError::kOk) {
             auto event = nlohmann::json::parse(msg);
             auto passengerEvent = event["passenger_event"].template get<std::string>();
@@ -101,23 +132,18 @@ private:
 
             auto eventType = PassengerEvent::ToType(passengerEvent);
             if (eventType.has_value()) {
-                PassengerEvent event {stationId, eventType.value()};
-                network_.RecordPassengerEvent(event);
+                network_.QueuePassengerEvent({stationId, eventType.value()});
             } else {
-                Log("OnMessage", "parse error: " + msg);
+                LogMonitorEvent("OnMessage", "parse error: " + msg);
             }
         } else {
-            Log("OnMessage", "receive error: " + msg);
+            LogMonitorEvent("OnMessage", "receive error: " + msg);
         }
     }
 
-    void Log(const std::string& source, const std::string& msg) const {
-        std::cout << " " << source << " | " << msg << std::endl;
-    }
-
-    TransportNetwork network_;
     boost::asio::io_context ioc_;
     boost::asio::ssl::context ctx_;
+    LiveNetwork network_ {ioc_};
     std::unique_ptr<Client> client_;
 };
 
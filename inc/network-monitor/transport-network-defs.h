@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace NetworkMonitor {
 
@@ -8,4 +12,55 @@ namespace NetworkMonitor {
  */
 using Id = std::string;
 
+/*! \brief Dense 32-bit handle of an interned ID.
+ */
+using IdHandle = std::uint32_t;
+
+/*! \brief Handle value that does not refer to any ID.
+ */
+constexpr IdHandle kInvalidIdHandle = std::numeric_limits<IdHandle>::max();
+
+/*! \brief Two-way table between IDs and dense handles.
+ *
+ *  Handles are assigned in insertion order, starting from 0, so they can be
+ *  used directly as indices into arrays.
+ */
+class IdTable {
+public:
+    /*! \brief Get the handle of an ID, adding the ID if it is not there yet.
+     */
+    IdHandle Intern(const Id& id) {
+        auto [it, inserted] = handles_.try_emplace(id, static_cast<IdHandle>(ids_.size()));
+        if (inserted) {
+            ids_.push_back(id);
+        }
+        return it->second;
+    }
+
+    /*! \brief Get the handle of an ID.
+     *
+     *  \returns kInvalidIdHandle if the ID was never interned.
+     */
+    IdHandle Find(const Id& id) const {
+        auto it = handles_.find(id);
+        return it == handles_.end() ? kInvalidIdHandle : it->second;
+    }
+
+    /*! \brief Get the ID of a valid handle.
+     */
+    const Id& Get(IdHandle handle) const {
+        return ids_[handle];
+    }
+
+    /*! \brief Number of interned IDs.
+     */
+    size_t Size() const {
+        return ids_.size();
+    }
+
+private:
+    std::vector<Id> ids_ {};
+    std::unordered_map<Id, IdHandle> handles_ {};
+};
+
 }
@@ -4,10 +4,20 @@
 
 #include <nlohmann/json.hpp>
 
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <iostream>
 
 namespace {
@@ -19,6 +29,14 @@ namespace {
 namespace NetworkMonitor {
 
 struct StationNode;
+struct RouteEdge;
+struct CompactGraph;
+struct LandmarkTable;
+struct ContractionHierarchy;
+struct Timetable;
+struct NetworkSnapshot;
+class LayoutBuilder;
+class RouteCache;
 
 /*! \brief Network station
  *
@@ -37,6 +55,29 @@ struct Station {
     bool operator!=(const Station& other) const;
 };
 
+/*! \brief When the trips of a route leave its first stop.
+ *
+ *  Times are in the unit of the travel times, from the start of the service
+ *  day. A trip takes the travel times of the route between its stops.
+ *
+ *  The default timetable has a trip leave whenever a passenger boards, so
+ *  journeys never wait.
+ */
+struct RouteTimetable {
+    // If not empty, the departure times of the trips, and the other fields
+    // are ignored.
+    std::vector<unsigned int> departures {};
+    // Otherwise a trip leaves every `headway` from `firstDeparture` to
+    // `lastDeparture`, or whenever a passenger boards in between if the
+    // headway is 0.
+    unsigned int headway {0};
+    unsigned int firstDeparture {0};
+    unsigned int lastDeparture {std::numeric_limits<unsigned int>::max()};
+
+    bool operator==(const RouteTimetable& other) const;
+    bool operator!=(const RouteTimetable& other) const;
+};
+
 /*! \brief Network route
  *
  *  Each underground line has one or more routes. A route represents a single
@@ -61,6 +102,7 @@ struct Route {
     Id startStationId {};
     Id endStationId {};
     std::vector<Id> stops {};
+    RouteTimetable timetable {};
 
     /*! \brief Route comparison
      *
@@ -114,50 +156,6 @@ struct TravelRoute {
     }
 };
 
-struct GraphStop {
-    Id stationId {};
-    std::optional<Id> routeId {};
-    std::optional<Id> lineId {};
-
-    // Define equality operator
-    bool operator==(const GraphStop& other) const {
-        return stationId == other.stationId &&
-               routeId == other.routeId &&
-               lineId == other.lineId;
-    }
-};
-
-struct GraphStopHash {
-    size_t operator()(const GraphStop& gs) const {
-        size_t h1 = std::hash<Id>{}(gs.stationId);
-        size_t h2 = gs.routeId ? std::hash<Id>{}(*gs.routeId) : 0;
-        size_t h3 = gs.lineId ? std::hash<Id>{}(*gs.lineId) : 0;
-        return h1 ^ (h2 << 1) ^ (h3 << 2);
-    }
-};
-
-// Custom equality function
-struct GraphStopEqual {
-    bool operator()(const GraphStop& lhs, const GraphStop& rhs) const {
-        return lhs.stationId == rhs.stationId &&
-               lhs.routeId == rhs.routeId &&
-               lhs.lineId == rhs.lineId;
-    }
-};
-
-struct GraphStopMetric {
-    GraphStop graphStop {};
-    unsigned int metric {};
-
-    bool operator>(const GraphStopMetric  & b) const {
-        return metric>b.metric;
-    }
-
-    bool operator<(const GraphStopMetric  & b) const {
-        return metric<b.metric;
-    }
-};
-
 /*! \brief Network line
  *
  *  A line is a collection of routes serving multiple stations.
@@ -192,6 +190,10 @@ struct PassengerEvent {
     Id stationId {};
     Type type {Type::In};
 
+    // When the event happened. The default, the clock's epoch, stands for the
+    // time the event is recorded.
+    std::chrono::system_clock::time_point time {};
+
     static std::optional<Type> ToType(const std::string& type) {
         if (type == "in") {
             return Type::In;
@@ -203,41 +205,150 @@ struct PassengerEvent {
     }
 };
 
+/*! \brief Search strategy of a route query.
+ *
+ *  All strategies find a journey of the same optimal cost. When several such
+ *  journeys exist, they may return different ones.
+ */
+enum class RouteSearchMode {
+    // Search from the origin until the destination is reached.
+    kDijkstra,
+    // Search from both ends until the two searches meet.
+    kBidirectional,
+    // Search from the origin, guided towards the destination by travel time
+    // lower bounds computed from landmark stations.
+    kAStar,
+    // Search a precomputed contraction hierarchy from both ends. Only
+    // supported for fastest routes, see
+    // TransportNetwork::BuildContractionHierarchy.
+    kContractionHierarchy,
+};
+
+/*! \brief Work done by a route query.
+ */
+struct RouteSearchStats {
+    // Number of (station, route) states expanded by the search.
+    size_t settledStates {0};
+};
+
+/*! \brief What a route query minimizes.
+ *
+ *  Profiles are registered by name with TransportNetwork::AddRouteProfile,
+ *  and picked by name with TransportNetwork::GetTravelRoute. Each kind of
+ *  profile runs a search specialized for its costs.
+ */
+struct RouteProfile {
+    enum class Kind {
+        // The travel time, line change penalties included.
+        kFastest,
+        // The passengers at each station entered, counted again at each line
+        // change.
+        kQuietest,
+        // The number of line changes, then the travel time.
+        kFewestTransfers,
+        // The weights below.
+        kWeighted,
+    };
+
+    Kind kind {Kind::kFastest};
+
+    // Only read for Kind::kWeighted. A step costs `timeWeight` per unit of
+    // travel time and `crowdingWeight` per passenger at the station it
+    // enters. A line change costs `transferWeight`, plus `crowdingWeight`
+    // per passenger at the station again.
+    unsigned int timeWeight {1};
+    unsigned int transferWeight {0};
+    unsigned int crowdingWeight {0};
+};
+
+/*! \brief Counters of the route query cache.
+ */
+struct RouteCacheStats {
+    size_t hits {0};
+    size_t misses {0};
+    // Entries dropped to make room for new ones.
+    size_t evictions {0};
+    size_t size {0};
+    size_t capacity {0};
+};
+
+/*! \brief Passenger entries and exits at a station over a time window.
+ */
+struct PassengerFlow {
+    long long int entries {0};
+    long long int exits {0};
+    double entriesPerSecond {0.0};
+    double exitsPerSecond {0.0};
+};
+
+/*! \brief A number of passengers at a station.
+ */
+struct StationPassengerCount {
+    Id stationId {};
+    long long int count {0};
+};
+
+/*! \brief Cost of loading a network layout.
+ */
+struct NetworkLoadStats {
+    std::chrono::microseconds loadTime {0};
+    // The peak resident memory of the whole process so far, in bytes.
+    size_t peakMemory {0};
+};
+
+/*! \brief A new travel time between 2 adjacent stations.
+ */
+struct TravelTimeUpdate {
+    Id stationA {};
+    Id stationB {};
+    unsigned int travelTime {0};
+};
+
 /*! \brief Underground network representation
+ *
+ *  Queries (the const methods) run against an immutable snapshot of the
+ *  network, and RecordPassengerEvent only updates atomic counters. So any
+ *  number of threads can run queries and record passenger events at the same
+ *  time, without locks, while one thread applies the other changes. Changes
+ *  other than passenger events must not run concurrently with each other.
+ *
+ *  A query sees either all or none of a change to the stations, lines or
+ *  travel times. Passenger counts are read as they are when the query reads
+ *  them.
  */
 class TransportNetwork {
 public:
     /*! \brief Default constructor
      */
-    TransportNetwork() = default;
+    TransportNetwork();
 
     /*! \brief Destructor
      */
-    ~TransportNetwork() = default;
+    ~TransportNetwork();
 
     /*! \brief Copy constructor
      */
     TransportNetwork(
         const TransportNetwork& copied
-    )  = default;
+    );
 
     /*! \brief Move constructor
      */
     TransportNetwork(
         TransportNetwork&& moved
-    ) = default;
+    );
 
     /*! \brief Copy assignment operator
      */
     TransportNetwork& operator=(
         const TransportNetwork& copied
-    ) = default;
+    );
 
     /*! \brief Move assignment operator
      */
     TransportNetwork& operator=(
         TransportNetwork&& moved
-    ) = default;
+    );
 
     /*! \brief Add a station to the network.
      *
@@ -246,26 +357,56 @@ public:
      *
      *  This function assumes that the Station object is well-formed.
      *
-     *  The station cannot already be in the network.
+     *  The station cannot already be in the network. A station no line
+     *  serves changes no journey, so the landmarks and cached routes are
+     *  kept.
      */
     bool AddStation(
         const Station& station
     );
 
-    /*! \brief Add a line to the network.
+    /*! \brief Add a line to the network, or put a removed line back in
+     *         service.
      *
-     *  \returns false if there was an error while adding the station to the
-     *           network.
+     *  \returns false, leaving the network unchanged, if a station served by
+     *           the line is not in the network, the line is already in
+     *           service, one of its routes belongs to another line, or a route
+     *           runs between the same two stations twice.
      *
      *  This function assumes that the Line object is well-formed.
      *
-     *  All stations served by this line must already be in the network. The
-     *  line cannot already be in the network.
+     *  All stations served by this line must already be in the network. A
+     *  removed line comes back with the routes given here. Its routes that
+     *  were suspended when it was removed stay suspended.
+     *
+     *  A removed line that comes back over the edges it ran over before is
+     *  put back on them in place, as with ResumeRoute. Otherwise the compact
+     *  graph is rebuilt. Either way the landmarks are kept, patched for the
+     *  new edges, and so are the cached routes that no journey on the line
+     *  can beat.
      */
     bool AddLine(
         const Line& line
     );
 
+    /*! \brief Take a line out of service.
+     *
+     *  The routes of the line no longer run, but the line and route IDs stay
+     *  known: adding the line again puts it back in service. Its routes
+     *  cannot be suspended or resumed while it is out of service, and the
+     *  ones that were suspended stay suspended once it is back.
+     *
+     *  Cheaper than rebuilding the network: the route lists of the edges the
+     *  line ran over are patched in place, the landmarks are kept, and cached
+     *  routes that do not take the line stay cached.
+     *
+     *  \returns false if the line is not in the network or was removed
+     *           already.
+     */
+    bool RemoveLine(
+        const Id& line
+    );
+
     /*! \brief Record a passenger event at a station.
      *
      *  \returns false if the station is not in the network or if the passenger
@@ -275,6 +416,56 @@ public:
         const PassengerEvent& event
     );
 
+    /*! \brief Record a passenger event at a station, skipping the station ID
+     *         lookup.
+     *
+     *  \param station A handle from GetStationHandle.
+     *
+     *  \returns false if the station is not in the network.
+     */
+    bool RecordPassengerEvent(
+        IdHandle station,
+        PassengerEvent::Type type,
+        std::chrono::system_clock::time_point time = {}
+    );
+
+    /*! \brief Record a batch of passenger events.
+     *
+     *  Cheaper than recording the events one by one: the events are added
+     *  up per station first, and each station's count is then updated once.
+     *  Other threads see the whole batch at a station at once.
+     *
+     *  \returns The number of events that were not recorded, because their
+     *           station is not in the network.
+     */
+    size_t RecordPassengerEvents(
+        const std::vector<PassengerEvent>& events
+    );
+
+    /*! \brief Add the passenger counts of `other` to the stations of this
+     *         network with the same IDs.
+     *
+     *  Used to carry the counts over to a reloaded network layout. Events
+     *  recorded on `other` while this runs may or may not be carried over.
+     *
+     *  \returns The number of stations of `other` that are not in this
+     *           network, whose counts were not carried over.
+     */
+    size_t AddPassengerCounts(
+        const TransportNetwork& other
+    );
+
+    /*! \brief Get the handle of a station, for the passenger methods that take
+     *         one.
+     *
+     *  A station keeps its handle for the lifetime of the network.
+     *
+     *  \returns kInvalidIdHandle if the station is not in the network.
+     */
+    IdHandle GetStationHandle(
+        const Id& station
+    ) const;
+
     /*! \brief Get the number of passengers currently recorded at a station.
      *
      *  The returned number can be negative: This happens if we start recording
@@ -287,6 +478,33 @@ public:
         const Id& station
     ) const;
 
+    /*! \brief Get the number of passengers currently recorded at a station,
+     *         from its handle.
+     *
+     *  \throws std::runtime_error if the station is not in the network.
+     */
+    long long int GetPassengerCount(
+        IdHandle station
+    ) const;
+
+    /*! \brief Get the `k` stations with the most passengers right now, most
+     *         crowded first.
+     *
+     *  The most crowded stations are ranked as passenger events come in, so
+     *  this takes O(k log k) rather than a scan of all stations, for `k` up
+     *  to 64, whichever threads record the events. It only scans all
+     *  stations again when many of the ranked stations emptied since the
+     *  last call.
+     *
+     *  \param nStationsScanned If set, receives the number of stations
+     *                          scanned: 0 unless the ranking was rebuilt or
+     *                          `k` is above 64.
+     */
+    std::vector<StationPassengerCount> GetMostCrowdedStations(
+        size_t k,
+        size_t* nStationsScanned = nullptr
+    ) const;
+
     /*! \brief Get list of routes serving a given station.
      *
      *  \returns An empty vector if there was an error getting the list of
@@ -316,6 +534,57 @@ public:
         const unsigned int travelTime
     );
 
+    /*! \brief Set several travel times at once, as if by SetTravelTime.
+     *
+     *  Queries see all of the new travel times at once, and the network
+     *  indices are updated once for the whole batch.
+     *
+     *  \returns The number of updates that were not applied, because their
+     *           stations are not in the network or not adjacent.
+     */
+    size_t UpdateTravelTimes(
+        const std::vector<TravelTimeUpdate>& updates
+    );
+
+    /*! \brief Stop a line route from running, until ResumeRoute.
+     *
+     *  \returns false if the route is not a route of the line, or is not
+     *           running.
+     */
+    bool SuspendRoute(
+        const Id& line,
+        const Id& route
+    );
+
+    /*! \brief Let a route stopped by SuspendRoute run again.
+     *
+     *  \returns false if the route is not a suspended route of the line.
+     */
+    bool ResumeRoute(
+        const Id& line,
+        const Id& route
+    );
+
+    /*! \brief Close a station to passengers.
+     *
+     *  Routes still run through a closed station, but journeys can neither
+     *  start, end nor change routes there.
+     *
+     *  \returns false if the station is not in the network or is already
+     *           closed.
+     */
+    bool CloseStation(
+        const Id& station
+    );
+
+    /*! \brief Open a station closed by CloseStation again.
+     *
+     *  \returns false if the station is not in the network or is not closed.
+     */
+    bool ReopenStation(
+        const Id& station
+    );
+
     /*! \brief Get the travel time between 2 adjacent stations.
      *
      *  \returns 0 if the function could not find the travel time between the
@@ -343,6 +612,10 @@ public:
      *
      *  The two stations must be both served by the `route`. The two stations
      *  must already be in the network.
+     *
+     *  Routes are stored as stop sequences with cumulative travel times, so
+     *  this takes a few lookups, whatever the length of the route, and does
+     *  not allocate.
      */
     unsigned int GetTravelTime(
         const Id& line,
@@ -352,8 +625,14 @@ public:
     ) const;
 
     /*! \brief Populate the network from a JSON object.
+     *
+     *  The items of each array are parsed, and the network is built, on
+     *  `nThreads` threads. The result, and the error thrown if any, are the
+     *  same whatever the number of threads.
      *
      *  \param src Ownership of the source JSON object is moved to this method.
+     *  \param nThreads The number of threads to use. 0 uses one thread per
+     *                  core.
      *
      *  \returns false if stations and lines where parsed successfully, but not
      *           the travel times.
@@ -365,39 +644,625 @@ public:
      *                                    JSON object.
      */
     bool FromJson(
-        nlohmann::json&& srcs
+        nlohmann::json&& srcs,
+        unsigned int nThreads = 0
+    );
+
+    /*! \brief Populate the network from a JSON network layout file.
+     *
+     *  The file is parsed as a stream and the network is built as it goes,
+     *  with no JSON object of the whole layout in memory. The items of the
+     *  layout can come in any order.
+     *
+     *  \param stats If not null, filled with the load time and memory.
+     *
+     *  \returns false if the file cannot be read or is not valid JSON.
+     *
+     *  \throws std::runtime_error Same as FromJson.
+     */
+    bool FromJsonFile(
+        const std::filesystem::path& file,
+        NetworkLoadStats* stats = nullptr
+    );
+
+    /*! \brief Write the network layout to a binary layout image.
+     *
+     *  The image holds the station, line and route IDs, the edges of the
+     *  network with their routes and travel times, and the landmark tables.
+     *  It is versioned and checksummed, and in native byte order: it is meant
+     *  to be compiled from the JSON layout once and loaded by
+     *  FromLayoutImage on each start, on the same kind of machine.
+     *
+     *  The file is replaced atomically, so readers never see a partial image.
+     *
+     *  \returns false if the file could not be written.
+     */
+    bool WriteLayoutImage(
+        const std::filesystem::path& file
+    ) const;
+
+    /*! \brief Populate an empty network from a binary layout image.
+     *
+     *  The image is memory-mapped and its arrays copied straight into the
+     *  network, with no parsing. Its landmark tables are used as they are if
+     *  the image has as many landmarks as this network is set to use.
+     *
+     *  \param stats If not null, filled with the load time and memory.
+     *
+     *  \returns false if the network is not empty, or if the file cannot be
+     *           read, is not a layout image of this version, fails its
+     *           checksum or is inconsistent. The network is left unchanged.
+     */
+    bool FromLayoutImage(
+        const std::filesystem::path& file,
+        NetworkLoadStats* stats = nullptr
+    );
+
+    /*! \brief Check whether a file starts like a binary layout image, as
+     *         opposed to a JSON layout.
+     */
+    static bool IsLayoutImage(
+        const std::filesystem::path& file
     );
 
+    /*! \brief Get the journey from `stationA` to `stationB` that arrives
+     *         first, leaving at `departureTime`.
+     *
+     *  Trips run to the route timetables, and journeys wait for them.
+     *  Changing line takes at least the line change penalty. The journey
+     *  arrives at `departureTime + totalTravelTime`, and each wait counts in
+     *  the travel time of the step that follows it.
+     *
+     *  The search goes round by round over the stop sequences of the routes
+     *  (RAPTOR), each round adding a trip to the journeys of the last one,
+     *  rather than over the route state graph.
+     *
+     *  \param stats If set, receives the number of route stops scanned, as
+     *               the settled states.
+     *
+     *  \returns A route with no steps if either station is not in the
+     *           network or closed, or if there is no journey between them
+     *           with up to 8 trips.
+     */
+    TravelRoute GetEarliestArrivalRoute(
+        const Id& stationA,
+        const Id& stationB,
+        unsigned int departureTime,
+        RouteSearchStats* stats = nullptr
+    ) const;
+
+    /*! \brief Get the journey from `stationA` to `stationB` with the
+     *         shortest total travel time.
+     *
+     *  Changing line costs a fixed penalty on top of the travel time.
+     *
+     *  Results are cached per station pair and search mode until the stations,
+     *  lines or travel times change. See SetRouteCacheCapacity.
+     *
+     *  \param stats If set, receives the amount of work done by the search.
+     *               The cache is bypassed, so that a search always runs.
+     *
+     *  \returns A route with no steps if either station is not in the
+     *           network or if there is no journey between them.
+     */
     TravelRoute GetFastestTravelRoute(
         const Id& stationA,
-        const Id& stationB) const;
+        const Id& stationB,
+        RouteSearchMode mode = RouteSearchMode::kDijkstra,
+        RouteSearchStats* stats = nullptr) const;
+
+    /*! \brief Get up to `count` distinct journeys from `stationA` to
+     *         `stationB`, fastest first.
+     *
+     *  The first journey is the fastest one. Each of the others is the
+     *  fastest journey once the stretches of track that the journeys found so
+     *  far run along have been made to cost half their travel time (and at
+     *  least 1) more, so
+     *  alternatives tend to avoid the track of the fastest journey rather
+     *  than differ from it by one stop. Journeys with the same steps, i.e.
+     *  through the same stations on the same routes, are only returned once.
+     *  If the first search finds no journey, no other search runs. All
+     *  searches share one workspace, and are guided by the landmark lower
+     *  bounds if there are any.
+     *
+     *  \param stats If set, receives the amount of work done by all the
+     *               searches.
+     *
+     *  \returns No route if either station is not in the network or closed,
+     *           or if there is no journey between them. Fewer than `count`
+     *           routes if the searches run out of new journeys.
+     */
+    std::vector<TravelRoute> GetAlternativeTravelRoutes(
+        const Id& stationA,
+        const Id& stationB,
+        size_t count,
+        RouteSearchStats* stats = nullptr) const;
+
+    /*! \brief Get the fastest journey of each pair of stations of a batch.
+     *
+     *  The queries are grouped by origin station, and each origin is searched
+     *  once: a whole network search if its queries go to several stations.
+     *  All the journeys from an origin are then read off the same search.
+     *  The origins are spread over `nThreads` threads. The route cache is
+     *  neither read nor filled.
+     *
+     *  Each route is one GetFastestTravelRoute would return, or one as fast
+     *  if there are several.
+     *
+     *  \param nThreads The number of threads to use. 0 uses one thread per
+     *                  core.
+     *  \param stats    If set, receives the amount of work done by all the
+     *                  searches.
+     *
+     *  \returns The routes, in the order of the queries.
+     */
+    std::vector<TravelRoute> GetFastestTravelRoutes(
+        const std::vector<std::pair<Id, Id>>& queries,
+        unsigned int nThreads = 0,
+        RouteSearchStats* stats = nullptr) const;
+
+    /*! \brief Get the journey from `stationA` to `stationB` that is best
+     *         for a route profile.
+     *
+     *  The profiles "fastest", "quietest" and "fewest_transfers" are always
+     *  there. Unlike GetFastestTravelRoute, the route cache is not used, and
+     *  unlike GetQuietTravelRoute, "quietest" journeys can be as slow as it
+     *  takes. Search modes that rely on travel time bounds
+     *  (RouteSearchMode::kAStar and RouteSearchMode::kContractionHierarchy)
+     *  fall back to RouteSearchMode::kDijkstra for other profiles than
+     *  RouteProfile::Kind::kFastest.
+     *
+     *  \param stats If set, receives the amount of work done by the search.
+     *
+     *  \returns A route with no steps if the profile is not registered, if
+     *           either station is not in the network or if there is no
+     *           journey between them.
+     */
+    TravelRoute GetTravelRoute(
+        const Id& stationA,
+        const Id& stationB,
+        const std::string& profile,
+        RouteSearchMode mode = RouteSearchMode::kDijkstra,
+        RouteSearchStats* stats = nullptr) const;
+
+    /*! \brief Register a route profile for GetTravelRoute.
+     *
+     *  \returns false if a profile with that name is already registered.
+     */
+    bool AddRouteProfile(
+        const std::string& name,
+        const RouteProfile& profile
+    );
 
+    /*! \brief Get the least crowded journey from `stationA` to `stationB`
+     *         that is less than 20% slower than the fastest one.
+     *
+     *  Each stop counts the passengers at the station, and a line change
+     *  counts them again. If no journey in that time is less crowded, this is
+     *  the fastest journey.
+     *
+     *  The fastest journey is found first, with the contraction hierarchy if
+     *  there is one. It then bounds a single search for a less crowded
+     *  journey, on both travel time and crowding.
+     *
+     *  \param stats If set, receives the amount of work done by the search.
+     *
+     *  \returns A route with no steps if either station is not in the
+     *           network or if there is no journey between them.
+     */
     TravelRoute GetQuietTravelRoute(
         const Id& stationA,
-        const Id& stationB) const;
+        const Id& stationB,
+        RouteSearchStats* stats = nullptr) const;
+
+    /*! \brief Travel time of the stations GetTravelTimesFrom cannot reach.
+     */
+    static constexpr unsigned int kUnreachable {
+        std::numeric_limits<unsigned int>::max()
+    };
+
+    /*! \brief Get the total travel time of the fastest journey from
+     *         `station` to every station.
+     *
+     *  This is the `totalTravelTime` of GetFastestTravelRoute for each
+     *  destination, from a single search of the whole network rather than
+     *  one per destination.
+     *
+     *  \param stats If set, receives the amount of work done by the search.
+     *
+     *  \returns The travel times, indexed by station handle (see
+     *           GetStationHandle and GetStationId), with kUnreachable for
+     *           the stations there is no journey to, closed ones included.
+     *           No travel times if `station` is not in the network.
+     */
+    std::vector<unsigned int> GetTravelTimesFrom(
+        const Id& station,
+        RouteSearchStats* stats = nullptr
+    ) const;
+
+    /*! \brief Get the stations that can be reached from `station` within
+     *         `maxTravelTime` (an isochrone), nearest first.
+     *
+     *  The search stops at `maxTravelTime`, so this costs less than
+     *  GetTravelTimesFrom for nearby stations.
+     *
+     *  \param stats If set, receives the amount of work done by the search.
+     *
+     *  \returns The station handles, `station` included. Stations as far as
+     *           each other are in handle order. No stations if `station` is
+     *           not in the network.
+     */
+    std::vector<IdHandle> GetStationsWithin(
+        const Id& station,
+        unsigned int maxTravelTime,
+        RouteSearchStats* stats = nullptr
+    ) const;
+
+    /*! \brief Get the ID of a station from its handle.
+     *
+     *  \returns An empty ID if no station has the handle.
+     */
+    Id GetStationId(
+        IdHandle station
+    ) const;
+
+    /*! \brief Set how many landmark stations RouteSearchMode::kAStar uses,
+     *         and recompute their travel time tables.
+     *
+     *  More landmarks give tighter lower bounds, and so fewer expanded states
+     *  per query, at the cost of 2 travel times per station and landmark.
+     *
+     *  The tables are computed by FromJson. Adding stations or lines discards
+     *  them: A* searches then expand as many states as Dijkstra until this
+     *  method is called again.
+     */
+    void SetLandmarkCount(
+        size_t count
+    );
+
+    /*! \brief Get the number of landmark stations used by A* searches.
+     */
+    size_t GetLandmarkCount() const;
+
+    /*! \brief Precompute the contraction hierarchy used by
+     *         RouteSearchMode::kContractionHierarchy.
+     *
+     *  This is worth it when the network is queried many more times than it
+     *  changes. Adding stations or lines discards the hierarchy. Other
+     *  changes rebuild it on another thread, and until the new one is
+     *  published those queries fall back to RouteSearchMode::kDijkstra.
+     */
+    void BuildContractionHierarchy();
+
+    /*! \brief Wait for the contraction hierarchy being rebuilt after a
+     *         change, if any, to be published.
+     *
+     *  Like other changes, this must not run concurrently with them.
+     */
+    void WaitForContractionHierarchy();
+
+    /*! \brief Check if a contraction hierarchy is available for queries.
+     */
+    bool HasContractionHierarchy() const;
+
+    /*! \brief Write the fastest travel time between every pair of stations,
+     *         and the next station on each journey, to a file.
+     *
+     *  The file is meant to be memory-mapped with TravelTimeMatrix::Open. It
+     *  takes 8 bytes per pair of stations, and one full route search per
+     *  station to compute. The searches are spread over `nThreads` threads.
+     *
+     *  The file is replaced atomically, so readers never see a partial matrix.
+     *
+     *  \param nThreads The number of threads to use. 0 uses one thread per
+     *                  core.
+     *
+     *  \returns false if the file could not be written.
+     */
+    bool WriteTravelTimeMatrix(
+        const std::filesystem::path& file,
+        unsigned int nThreads = 0
+    ) const;
+
+    /*! \brief Replace the route query cache with an empty one that holds up
+     *         to `capacity` routes.
+     *
+     *  A capacity of 0 disables the cache.
+     */
+    void SetRouteCacheCapacity(
+        size_t capacity
+    );
+
+    /*! \brief Get the route query cache counters since the cache was
+     *         created.
+     *
+     *  Copies of a network share their cache, and its counters.
+     */
+    RouteCacheStats GetRouteCacheStats() const;
+
+    /*! \brief Keep a per-second history of the passenger events at each
+     *         station over the last `horizon`.
+     *
+     *  Replaces the current history with an empty one. A horizon of 0, the
+     *  default, keeps no history.
+     *
+     *  The history takes 16 bytes per station and per second of horizon,
+     *  and is allocated for 64 stations at a time: about 3.7 MB per 64
+     *  stations for a one hour horizon.
+     *
+     *  Each station has one slot per second of horizon for its entries and
+     *  one for its exits, reused every horizon. Events recorded at times
+     *  before 1970, or from 2106 on, are left out of the history. An event
+     *  is also left out if its slot already counts a second at least a
+     *  horizon later, and an event dated in the future takes the slot of
+     *  the second one horizon before it. The passenger counts include all
+     *  the events.
+     *
+     *  \throws std::runtime_error if `horizon` is longer than 67108863
+     *          seconds, about 776 days.
+     */
+    void SetOccupancyHistoryHorizon(
+        std::chrono::seconds horizon
+    );
+
+    std::chrono::seconds GetOccupancyHistoryHorizon() const;
+
+    /*! \brief Get the number of passengers that were at a station at a past
+     *         time.
+     *
+     *  This is the current count, minus the events recorded since `time`.
+     *
+     *  \throws std::runtime_error if the station is not in the network, or if
+     *          `time` is further back than the occupancy history horizon.
+     */
+    long long int GetPassengerCount(
+        const Id& station,
+        std::chrono::system_clock::time_point time
+    ) const;
+
+    /*! \brief Get the passengers entering and exiting a station over the last
+     *         `window`, up to the occupancy history horizon.
+     *
+     *  \throws std::runtime_error if the station is not in the network.
+     */
+    PassengerFlow GetPassengerFlow(
+        const Id& station,
+        std::chrono::seconds window
+    ) const;
+
+    /*! \brief Get the `k` stations with the most entries and exits over the
+     *         last `window`, up to the occupancy history horizon, busiest
+     *         first.
+     *
+     *  This scans the history of every station.
+     */
+    std::vector<StationPassengerCount> GetBusiestStations(
+        size_t k,
+        std::chrono::seconds window
+    ) const;
     private:
-        StationNode* GetStationNode(const Id& stationId);
+        friend class LayoutBuilder;
 
-        const StationNode* GetStationNode(const Id& stationId) const;
+        bool AddStationNode(const Station& station);
 
-        unsigned int GetTravelTimeDirectional(
-            const Id& stationA,
-            const Id& stationB
-        ) const;
+        bool AddLineEdges(const Line& line);
 
-        bool SetTravelTimeDirectional(
-            const Id& stationA,
-            const Id& stationB,
+        /*! \brief Set the travel time of the edge from `stationA` to
+         *         `stationB`, without publishing it.
+         *
+         *  \returns false if the two stations are not adjacent.
+         */
+        bool SetEdgeTravelTime(
+            IdHandle stationA,
+            IdHandle stationB,
             const unsigned int travelTime);
 
+        /*! \brief Publish a snapshot with the current stations, lines and
+         *         travel times.
+         *
+         *  Queries only see changes to the topology once this has run.
+         */
+        void PublishTopology();
+
+        /*! \brief Publish a snapshot with the current stations and lines, and
+         *         `graph` as their compact graph.
+         */
+        void PublishTopology(std::shared_ptr<CompactGraph> graph);
+
+        /*! \brief Make a snapshot with the current stations and lines, and
+         *         `graph` as their compact graph, with no landmarks or
+         *         hierarchy. Its passenger counts and history share those of
+         *         the published snapshot.
+         */
+        std::shared_ptr<NetworkSnapshot> MakeTopologySnapshot(
+            std::shared_ptr<CompactGraph> graph) const;
+
+        /*! \brief Whether AddLineEdges would add all of `line` without error,
+         *         and the line is not in service yet.
+         */
+        bool CanAddLine(const Line& line) const;
+
+        /*! \brief Fill in `stationNodes_` and `edges_` from the published
+         *         compact graph, if a layout image load left them empty.
+         *
+         *  Called by every mutator before it reads or changes them.
+         */
+        void LoadPendingEdges();
+
+        void RebuildLandmarks();
+
+        /*! \brief Get the snapshot that queries run against.
+         */
+        std::shared_ptr<const NetworkSnapshot> GetSnapshot() const;
+
+        /*! \brief Give `snapshot` a new version and make it the one queries
+         *         run against.
+         */
+        void Publish(std::shared_ptr<NetworkSnapshot> snapshot);
+
+        /*! \brief Publish `snapshot` with `publishMutex_` held.
+         *
+         *  If `snapshot` has the published graph but no hierarchy, it gets
+         *  the one built for the graph in the meantime, if any.
+         *
+         *  \param isCachedRouteKept Which of the routes cached on the
+         *                           published snapshot are still optimal on
+         *                           `snapshot`. They are carried over before
+         *                           it is published. If null, none are.
+         */
+        void PublishLocked(
+            std::shared_ptr<NetworkSnapshot> snapshot,
+            const std::function<bool (const TravelRoute&)>& isCachedRouteKept = nullptr);
+
+        /*! \brief Publish `graph` in place of the current compact graph,
+         *         with the same topology tables.
+         *
+         *  If the current graph has a contraction hierarchy, one is rebuilt
+         *  for `graph` in the background.
+         *
+         *  \param landmarks The landmark lower bounds for `graph`, if any.
+         *  \param isCachedRouteKept Which of the cached routes are still
+         *                           optimal on `graph`. If null, none are.
+         *  \param timetable If set, replaces the timetable.
+         */
+        void PublishGraph(
+            std::shared_ptr<CompactGraph> graph,
+            std::shared_ptr<const LandmarkTable> landmarks,
+            const std::function<bool (const TravelRoute&)>& isCachedRouteKept,
+            std::shared_ptr<const Timetable> timetable = nullptr);
+
+        /*! \brief Publish `snapshot`, a change to the published network, and
+         *         carry the cached routes still optimal on it over.
+         *
+         *  If the published snapshot has a contraction hierarchy, one is
+         *  rebuilt for `snapshot` in the background. Only call with
+         *  `publishMutex_` held.
+         *
+         *  \param isCachedRouteKept Which of the cached routes are still
+         *                           optimal on `snapshot`. If null, none are.
+         */
+        void PublishChange(
+            std::shared_ptr<NetworkSnapshot> snapshot,
+            const std::function<bool (const TravelRoute&)>& isCachedRouteKept);
+
+        /*! \brief Build the contraction hierarchy for the published graph on
+         *         another thread, and publish it. If the graph changed in
+         *         the meantime, build it again for the new one.
+         *
+         *  Only call with `publishMutex_` held.
+         */
+        void RebuildHierarchyInBackground();
+
+        /*! \brief Take `route` off the build-side edges it runs over.
+         *
+         *  \returns The (edge, route) slots of `graph` to remove with
+         *           CompactGraph::UpdateEdgeRoutes.
+         */
+        std::vector<std::pair<uint32_t, IdHandle>> TakeRouteOffEdges(
+            IdHandle route,
+            const CompactGraph& graph);
+
         TravelRoute GetOptimalTravelRoute(
+            const NetworkSnapshot& snapshot,
+            const Id& stationA,
+            const Id& stationB,
+            const RouteProfile& profile,
+            RouteSearchMode mode = RouteSearchMode::kDijkstra,
+            RouteSearchStats* stats = nullptr) const;
+
+        /*! \brief Find the optimal journey between two stations.
+         *
+         *  \param states    The route states of the journey, origin first.
+         *  \param distances The travel time from the origin to each state.
+         *
+         *  \returns false if there is no journey.
+         */
+        bool FindOptimalPath(
+            const NetworkSnapshot& snapshot,
+            IdHandle stationA,
+            IdHandle stationB,
+            const RouteProfile& profile,
+            RouteSearchMode mode,
+            RouteSearchStats* stats,
+            std::vector<uint32_t>& states,
+            std::vector<unsigned int>& distances) const;
+
+        /*! \brief Search the network from `station` up to `maxTravelTime`.
+         *
+         *  \param travelTimes As returned by GetTravelTimesFrom, with the
+         *                     stations further than `maxTravelTime` as
+         *                     kUnreachable.
+         */
+        void FindTravelTimes(
+            const NetworkSnapshot& snapshot,
+            const Id& station,
+            unsigned int maxTravelTime,
+            RouteSearchStats* stats,
+            std::vector<unsigned int>& travelTimes) const;
+
+        /*! \brief Turn a journey over route states into a TravelRoute.
+         *
+         *  \param states    The route states of the journey, origin first.
+         *  \param distances The travel time from the origin to each state.
+         */
+        TravelRoute MakeTravelRoute(
+            const NetworkSnapshot& snapshot,
             const Id& stationA,
             const Id& stationB,
-            bool useDistance) const;
+            const std::vector<uint32_t>& states,
+            const std::vector<unsigned int>& distances) const;
+
+        // The network as mutators build it. Queries never read these, only
+        // the snapshots published from them.
+        // Station handles index `stationNodes_` and route handles index
+        // `routeLines_`.
+        IdTable stationIds_ {};
+        IdTable lineIds_ {};
+        IdTable routeIds_ {};
+        std::vector<IdHandle> routeLines_ {};
+        std::vector<StationNode> stationNodes_;
+        std::vector<RouteEdge> edges_;
+        // Set when `stationNodes_` and `edges_` are left empty, and the
+        // published compact graph is the only copy of the edges.
+        bool edgesPending_ {false};
+        // Indexed by station handle, or empty if no station is closed.
+        std::vector<uint8_t> closedStations_ {};
+        // The stations each suspended route ran between, as (from, to) pairs.
+        std::unordered_map<IdHandle, std::vector<std::pair<IdHandle, IdHandle>>>
+            suspendedRoutes_ {};
+        // The lines taken out of service. Their routes are off their edges.
+        std::unordered_set<IdHandle> removedLines_ {};
+        // The routes that do not run whenever a passenger boards.
+        std::unordered_map<IdHandle, RouteTimetable> routeTimetables_ {};
 
-        std::unordered_map<Id, std::shared_ptr<StationNode>> stationIdToNode_;
+        size_t landmarkCount_ {4};
+
+        // Only accessed with std::atomic_load and std::atomic_store.
+        std::shared_ptr<const NetworkSnapshot> snapshot_;
+
+        // Copies of a network can share the cache: cached routes are only
+        // served to snapshots with the same version. Only accessed with
+        // std::atomic_load and std::atomic_store.
+        std::shared_ptr<RouteCache> routeCache_;
+
+        // Route profiles by name. Replaced as a whole when a profile is
+        // added, and only accessed with std::atomic_load and
+        // std::atomic_store.
+        std::shared_ptr<const std::unordered_map<std::string, RouteProfile>> routeProfiles_;
 
         unsigned int penalty_ = 5;
+
+        // Held to publish a snapshot, so that hierarchies built in the
+        // background are only published for the graph they were built for.
+        std::mutex publishMutex_ {};
+        // Whether the published graph is to get a hierarchy built in the
+        // background, and whether one is being built. Guarded by
+        // `publishMutex_`.
+        bool hierarchyPending_ {false};
+        bool hierarchyBuilding_ {false};
+        // Last, so that the network waits for the build to finish before its
+        // other members go.
+        std::future<void> hierarchyBuild_ {};
 };
 
 } // namespace NetworkMonitor
\ No newline at end of file
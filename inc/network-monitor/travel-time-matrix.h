@@ -0,0 +1,115 @@
+#pragma once
+
+#include "network-monitor/transport-network-defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+
+namespace NetworkMonitor {
+
+/*! \brief Read-only view of a station-to-station travel time matrix file.
+ *
+ *  The file is written by TransportNetwork::WriteTravelTimeMatrix and memory
+ *  mapped by Open, so lookups are O(1) and many processes can share the same
+ *  pages. Station handles are the row and column indices of the matrix.
+ */
+class TravelTimeMatrix {
+public:
+    /*! \brief Travel time between two stations with no journey between them.
+     */
+    static constexpr unsigned int kUnreachable {
+        std::numeric_limits<uint32_t>::max()
+    };
+
+    /*! \brief Default constructor. The matrix is empty until Open is called.
+     */
+    TravelTimeMatrix();
+
+    /*! \brief Destructor. Unmaps the file.
+     */
+    ~TravelTimeMatrix();
+
+    TravelTimeMatrix(const TravelTimeMatrix& copied) = delete;
+
+    TravelTimeMatrix(TravelTimeMatrix&& moved) noexcept;
+
+    TravelTimeMatrix& operator=(const TravelTimeMatrix& copied) = delete;
+
+    TravelTimeMatrix& operator=(TravelTimeMatrix&& moved) noexcept;
+
+    /*! \brief Map a travel time matrix file.
+     *
+     *  Any previously mapped file is closed first.
+     *
+     *  \returns false if the file cannot be mapped or is not a valid matrix
+     *           file. The matrix is then empty.
+     */
+    bool Open(const std::filesystem::path& file);
+
+    /*! \brief Unmap the file, leaving the matrix empty.
+     */
+    void Close();
+
+    /*! \brief Get the number of stations in the matrix.
+     */
+    size_t GetStationCount() const;
+
+    /*! \brief Get the handle of a station, or kInvalidIdHandle if the
+     *         station is not in the matrix.
+     */
+    IdHandle GetStationHandle(const Id& stationId) const;
+
+    /*! \brief Get the ID of a station from its handle.
+     */
+    const Id& GetStationId(IdHandle station) const;
+
+    /*! \brief Get the total travel time of the fastest journey from
+     *         `stationA` to `stationB`.
+     *
+     *  This is the `totalTravelTime` of
+     *  TransportNetwork::GetFastestTravelRoute, line change penalties
+     *  included.
+     *
+     *  \returns kUnreachable if either station is not in the matrix or if
+     *           there is no journey between them.
+     */
+    unsigned int GetTravelTime(
+        const Id& stationA,
+        const Id& stationB
+    ) const;
+
+    unsigned int GetTravelTime(
+        IdHandle stationA,
+        IdHandle stationB
+    ) const;
+
+    /*! \brief Get the station after `stationA` on the fastest journey from
+     *         `stationA` to `stationB`.
+     *
+     *  \returns An empty ID if the two stations are the same, if either is not
+     *           in the matrix, or if there is no journey between them.
+     */
+    Id GetNextStation(
+        const Id& stationA,
+        const Id& stationB
+    ) const;
+
+    IdHandle GetNextStation(
+        IdHandle stationA,
+        IdHandle stationB
+    ) const;
+
+private:
+    void* mapping_ {nullptr};
+    size_t mappingSize_ {0};
+
+    size_t nStations_ {0};
+    const uint32_t* travelTimes_ {nullptr};
+    const uint32_t* nextStations_ {nullptr};
+
+    IdTable stationIds_ {};
+};
+
+} // namespace NetworkMonitor
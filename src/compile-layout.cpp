@@ -0,0 +1,54 @@
+#include "network-monitor/transport-network.h"
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <iostream>
+
+namespace po = boost::program_options;
+
+int main(int argc, char* argv[]) {
+    try {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("help,h", "produce help message")
+            ("network_layout_path", po::value<std::string>(), "Filesystem path to the JSON network layout file")
+            ("output_path,o", po::value<std::string>(), "Filesystem path to write the binary layout image to");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help") || !vm.count("network_layout_path") || !vm.count("output_path")) {
+            std::cout << desc << "\n";
+            return 1;
+        }
+
+        NetworkMonitor::TransportNetwork network {};
+        NetworkMonitor::NetworkLoadStats stats {};
+        if (!network.FromJsonFile(vm["network_layout_path"].as<std::string>(), &stats)) {
+            std::cerr << "Error: could not read the network layout\n";
+            return 1;
+        }
+        std::cout << "JSON layout loaded in " << stats.loadTime.count() << "us\n";
+        if (!network.WriteLayoutImage(vm["output_path"].as<std::string>())) {
+            std::cerr << "Error: could not write the layout image\n";
+            return 1;
+        }
+
+        NetworkMonitor::TransportNetwork compiled {};
+        if (!compiled.FromLayoutImage(vm["output_path"].as<std::string>(), &stats)) {
+            std::cerr << "Error: could not read back the layout image\n";
+            return 1;
+        }
+        std::cout << "Layout image loaded in " << stats.loadTime.count() << "us\n";
+    } catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    } catch (...) {
+        std::cerr << "Unknown error!\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,365 @@
+#include "network-monitor-internal/contraction-hierarchy.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+
+namespace {
+    using NetworkMonitor::CompactGraph;
+    using NetworkMonitor::ContractionHierarchy;
+    using NetworkMonitor::RoutingWorkspace;
+    using NetworkMonitor::kInvalidIdHandle;
+
+    constexpr unsigned int kInfiniteWeight = std::numeric_limits<unsigned int>::max();
+
+    // Witness searches give up after settling this many states; a missed
+    // witness only costs an unnecessary shortcut.
+    constexpr size_t kWitnessSettleLimit = 500;
+
+    /*! \brief Mutable graph used while contracting.
+     */
+    struct ContractionGraph {
+        void AddEdge(uint32_t from, uint32_t to, unsigned int weight, uint32_t first, uint32_t second) {
+            for (const auto edgeIdx : out_[from]) {
+                auto& edge = edges_[edgeIdx];
+                if (edge.to == to) {
+                    if (weight < edge.weight) {
+                        edge = {from, to, weight, first, second};
+                    }
+                    return;
+                }
+            }
+            const auto edgeIdx = static_cast<uint32_t>(edges_.size());
+            edges_.push_back({from, to, weight, first, second});
+            out_[from].push_back(edgeIdx);
+            in_[to].push_back(edgeIdx);
+        }
+
+        std::vector<ContractionHierarchy::Edge> edges_;
+        std::vector<std::vector<uint32_t>> out_;
+        std::vector<std::vector<uint32_t>> in_;
+        std::vector<bool> contracted_;
+    };
+
+    /*! \brief Shortest distance from `from` to each remaining node, ignoring
+     *         `skipped`, up to `limit`.
+     */
+    void RunWitnessSearch(
+        const ContractionGraph& graph,
+        uint32_t from,
+        uint32_t skipped,
+        unsigned int limit,
+        RoutingWorkspace& workspace) {
+        workspace.Reset(graph.out_.size());
+        workspace.Reach(from, 0, 0, from);
+        workspace.Push(0, from);
+        size_t settled = 0;
+        while (!workspace.queue_.empty() && settled < kWitnessSettleLimit) {
+            const auto [metric, node] = workspace.Pop();
+            if (metric != workspace.metric_[node]) {
+                continue;
+            }
+            if (metric > limit) {
+                break;
+            }
+            ++settled;
+            for (const auto edgeIdx : graph.out_[node]) {
+                const auto& edge = graph.edges_[edgeIdx];
+                if (edge.to == skipped || graph.contracted_[edge.to]) {
+                    continue;
+                }
+                const auto nextMetric = metric + edge.weight;
+                if (!workspace.IsReached(edge.to) || nextMetric < workspace.metric_[edge.to]) {
+                    workspace.Reach(edge.to, nextMetric, nextMetric, node);
+                    workspace.Push(nextMetric, edge.to);
+                }
+            }
+        }
+    }
+
+    /*! \brief Contract `node`, or only count the shortcuts that contracting
+     *         it would add if `simulate` is set.
+     */
+    int ContractNode(
+        ContractionGraph& graph,
+        uint32_t node,
+        bool simulate,
+        RoutingWorkspace& workspace) {
+        int shortcuts = 0;
+        // Copy: adding shortcuts may grow the adjacency lists.
+        const auto inEdges = graph.in_[node];
+        const auto outEdges = graph.out_[node];
+        for (const auto inIdx : inEdges) {
+            const auto from = graph.edges_[inIdx].from;
+            if (graph.contracted_[from] || from == node) {
+                continue;
+            }
+            const auto inWeight = graph.edges_[inIdx].weight;
+            bool hasTargets = false;
+            unsigned int limit = 0;
+            for (const auto outIdx : outEdges) {
+                const auto& outEdge = graph.edges_[outIdx];
+                if (!graph.contracted_[outEdge.to] && outEdge.to != from && outEdge.to != node) {
+                    hasTargets = true;
+                    limit = std::max(limit, inWeight + outEdge.weight);
+                }
+            }
+            if (!hasTargets) {
+                continue;
+            }
+            RunWitnessSearch(graph, from, node, limit, workspace);
+            for (const auto outIdx : outEdges) {
+                const auto outEdge = graph.edges_[outIdx];
+                if (graph.contracted_[outEdge.to] || outEdge.to == from || outEdge.to == node) {
+                    continue;
+                }
+                const auto viaWeight = inWeight + outEdge.weight;
+                if (workspace.IsReached(outEdge.to) && workspace.metric_[outEdge.to] <= viaWeight) {
+                    // A witness path makes the shortcut unnecessary.
+                    continue;
+                }
+                ++shortcuts;
+                if (!simulate) {
+                    graph.AddEdge(from, outEdge.to, viaWeight, inIdx, outIdx);
+                }
+            }
+        }
+        if (!simulate) {
+            graph.contracted_[node] = true;
+        }
+        return shortcuts;
+    }
+
+    int GetActiveDegree(const ContractionGraph& graph, uint32_t node) {
+        int degree = 0;
+        for (const auto edgeIdx : graph.in_[node]) {
+            degree += graph.contracted_[graph.edges_[edgeIdx].from] ? 0 : 1;
+        }
+        for (const auto edgeIdx : graph.out_[node]) {
+            degree += graph.contracted_[graph.edges_[edgeIdx].to] ? 0 : 1;
+        }
+        return degree;
+    }
+
+    void BuildAdjacency(
+        const std::vector<ContractionHierarchy::Edge>& edges,
+        size_t nNodes,
+        bool up,
+        const std::vector<uint32_t>& rank,
+        std::vector<uint32_t>& offsets,
+        std::vector<uint32_t>& adjacency) {
+        offsets.assign(nNodes + 1, 0);
+        auto owner = [&](const ContractionHierarchy::Edge& edge) {
+            return up ? edge.from : edge.to;
+        };
+        auto belongs = [&](const ContractionHierarchy::Edge& edge) {
+            return up ? rank[edge.from] < rank[edge.to] : rank[edge.from] > rank[edge.to];
+        };
+        for (const auto& edge : edges) {
+            if (belongs(edge)) {
+                ++offsets[owner(edge) + 1];
+            }
+        }
+        for (size_t idx = 1; idx <= nNodes; ++idx) {
+            offsets[idx] += offsets[idx - 1];
+        }
+        adjacency.resize(offsets[nNodes]);
+        auto cursor = offsets;
+        for (uint32_t edgeIdx = 0; edgeIdx < edges.size(); ++edgeIdx) {
+            if (belongs(edges[edgeIdx])) {
+                adjacency[cursor[owner(edges[edgeIdx])]++] = edgeIdx;
+            }
+        }
+    }
+
+    void UnpackEdge(
+        const std::vector<ContractionHierarchy::Edge>& edges,
+        uint32_t edgeIdx,
+        std::vector<uint32_t>& states,
+        std::vector<unsigned int>& distances) {
+        const auto& edge = edges[edgeIdx];
+        if (edge.firstChild == CompactGraph::kNoIndex) {
+            states.push_back(edge.to);
+            distances.push_back(distances.back() + edge.weight);
+            return;
+        }
+        UnpackEdge(edges, edge.firstChild, states, distances);
+        UnpackEdge(edges, edge.secondChild, states, distances);
+    }
+}
+
+namespace NetworkMonitor {
+    ContractionHierarchy ContractionHierarchy::Build(
+        const CompactGraph& graph,
+        unsigned int penalty) {
+        const auto nNodes = graph.GetStateCount();
+        ContractionGraph contraction;
+        contraction.out_.resize(nNodes);
+        contraction.in_.resize(nNodes);
+        contraction.contracted_.assign(nNodes, false);
+        for (uint32_t state = 0; state < nNodes; ++state) {
+            const auto station = graph.stateStations_[state];
+            const auto route = graph.stateRoutes_[state];
+            const bool closed = graph.IsClosed(station);
+            for (auto edge = graph.edgeOffsets_[station]; edge < graph.edgeOffsets_[station + 1]; ++edge) {
+                for (auto slot = graph.edgeRouteOffsets_[edge]; slot < graph.edgeRouteOffsets_[edge + 1]; ++slot) {
+                    const auto nextRoute = graph.edgeRoutes_[slot];
+                    if (closed && nextRoute != route) {
+                        continue;
+                    }
+                    auto weight = graph.edgeTravelTimes_[edge];
+                    if (route != kInvalidIdHandle
+                        && route != nextRoute
+                        && graph.routeLines_[route] != graph.routeLines_[nextRoute]) {
+                        weight += penalty;
+                    }
+                    contraction.AddEdge(
+                        state,
+                        graph.edgeRouteStates_[slot],
+                        weight,
+                        CompactGraph::kNoIndex,
+                        CompactGraph::kNoIndex);
+                }
+            }
+        }
+
+        // Contract nodes by increasing edge difference, penalizing nodes
+        // whose neighbors were already contracted to spread the contraction
+        // evenly. Priorities are refreshed lazily when a node is popped.
+        RoutingWorkspace witnessWorkspace;
+        std::vector<int> contractedNeighbors(nNodes, 0);
+        auto getPriority = [&](uint32_t node) {
+            return ContractNode(contraction, node, true, witnessWorkspace)
+                - GetActiveDegree(contraction, node)
+                + contractedNeighbors[node];
+        };
+        using QueueEntry = std::pair<int, uint32_t>;
+        std::vector<QueueEntry> queue;
+        queue.reserve(nNodes);
+        for (uint32_t node = 0; node < nNodes; ++node) {
+            queue.push_back({getPriority(node), node});
+        }
+        std::make_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+
+        ContractionHierarchy hierarchy;
+        hierarchy.rank_.assign(nNodes, 0);
+        uint32_t nextRank = 0;
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+            const auto node = queue.back().second;
+            queue.pop_back();
+            const auto priority = getPriority(node);
+            if (!queue.empty() && priority > queue.front().first) {
+                queue.push_back({priority, node});
+                std::push_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+                continue;
+            }
+            for (const auto edgeIdx : contraction.in_[node]) {
+                ++contractedNeighbors[contraction.edges_[edgeIdx].from];
+            }
+            for (const auto edgeIdx : contraction.out_[node]) {
+                ++contractedNeighbors[contraction.edges_[edgeIdx].to];
+            }
+            ContractNode(contraction, node, false, witnessWorkspace);
+            hierarchy.rank_[node] = nextRank++;
+        }
+
+        hierarchy.edges_ = std::move(contraction.edges_);
+        BuildAdjacency(
+            hierarchy.edges_, nNodes, true, hierarchy.rank_,
+            hierarchy.upOffsets_, hierarchy.upEdges_);
+        BuildAdjacency(
+            hierarchy.edges_, nNodes, false, hierarchy.rank_,
+            hierarchy.downOffsets_, hierarchy.downEdges_);
+        return hierarchy;
+    }
+
+    uint32_t ContractionHierarchy::Search(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        RoutingWorkspace& forward,
+        RoutingWorkspace& backward) const {
+        forward.Reset(rank_.size());
+        forward.Reach(source, 0, 0, CompactGraph::kNoIndex);
+        forward.Push(0, source);
+        backward.Reset(rank_.size());
+        for (auto state = graph.stationStateOffsets_[target];
+                state < graph.stationStateOffsets_[target + 1];
+                ++state) {
+            backward.Reach(state, 0, 0, CompactGraph::kNoIndex);
+            backward.Push(0, state);
+        }
+
+        unsigned int bestWeight = kInfiniteWeight;
+        uint32_t meetingState = CompactGraph::kNoIndex;
+        // Both searches only climb the hierarchy, so each one goes on until
+        // its own queue cannot improve on the best journey.
+        auto step = [&](RoutingWorkspace& workspace, const RoutingWorkspace& other, bool up) {
+            const auto [weight, state] = workspace.Pop();
+            if (weight != workspace.metric_[state]) {
+                return;
+            }
+            if (weight >= bestWeight) {
+                workspace.queue_.clear();
+                return;
+            }
+            ++workspace.settledStates_;
+            if (other.IsReached(state) && weight + other.metric_[state] < bestWeight) {
+                bestWeight = weight + other.metric_[state];
+                meetingState = state;
+            }
+            const auto& offsets = up ? upOffsets_ : downOffsets_;
+            const auto& adjacency = up ? upEdges_ : downEdges_;
+            for (auto idx = offsets[state]; idx < offsets[state + 1]; ++idx) {
+                const auto& edge = edges_[adjacency[idx]];
+                const auto next = up ? edge.to : edge.from;
+                const auto nextWeight = weight + edge.weight;
+                if (!workspace.IsReached(next) || nextWeight < workspace.metric_[next]) {
+                    workspace.Reach(next, nextWeight, nextWeight, adjacency[idx]);
+                    workspace.Push(nextWeight, next);
+                }
+            }
+        };
+        while (!forward.queue_.empty() || !backward.queue_.empty()) {
+            const bool forwardNext = backward.queue_.empty()
+                || (!forward.queue_.empty()
+                    && forward.queue_.front().metric <= backward.queue_.front().metric);
+            if (forwardNext) {
+                step(forward, backward, true);
+            } else {
+                step(backward, forward, false);
+            }
+        }
+        return meetingState;
+    }
+
+    void ContractionHierarchy::ExtractPath(
+        const RoutingWorkspace& forward,
+        const RoutingWorkspace& backward,
+        uint32_t meetingState,
+        std::vector<uint32_t>& states,
+        std::vector<unsigned int>& distances) const {
+        // Hierarchy edges from the origin to the meeting state, then on to
+        // the target.
+        std::vector<uint32_t> path;
+        for (auto state = meetingState; forward.parent_[state] != CompactGraph::kNoIndex; ) {
+            path.push_back(forward.parent_[state]);
+            state = edges_[forward.parent_[state]].from;
+        }
+        std::reverse(path.begin(), path.end());
+        for (auto state = meetingState; backward.parent_[state] != CompactGraph::kNoIndex; ) {
+            path.push_back(backward.parent_[state]);
+            state = edges_[backward.parent_[state]].to;
+        }
+
+        states.clear();
+        distances.clear();
+        states.push_back(path.empty() ? meetingState : edges_[path.front()].from);
+        distances.push_back(0);
+        for (const auto edgeIdx : path) {
+            UnpackEdge(edges_, edgeIdx, states, distances);
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#include "network-monitor-internal/landmarks.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace {
+    using NetworkMonitor::CompactGraph;
+    using NetworkMonitor::IdHandle;
+    using NetworkMonitor::LandmarkTable;
+
+    /*! \brief Shortest travel times over the station graph from (or, if
+     *         `reverse` is set, to) `landmark`.
+     */
+    void GetStationDistances(
+        const CompactGraph& graph,
+        IdHandle landmark,
+        bool reverse,
+        std::vector<unsigned int>& distances) {
+        using QueueEntry = std::pair<unsigned int, IdHandle>;
+        distances.assign(graph.GetStationCount(), LandmarkTable::kUnreachable);
+        std::vector<QueueEntry> queue {{0, landmark}};
+        distances[landmark] = 0;
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+            const auto [distance, station] = queue.back();
+            queue.pop_back();
+            if (distance > distances[station]) {
+                continue;
+            }
+            const auto first = reverse ? graph.inEdgeOffsets_[station] : graph.edgeOffsets_[station];
+            const auto last = reverse ? graph.inEdgeOffsets_[station + 1] : graph.edgeOffsets_[station + 1];
+            for (auto idx = first; idx < last; ++idx) {
+                const auto edge = reverse ? graph.inEdges_[idx] : idx;
+                const auto next = reverse ? graph.edgeSources_[edge] : graph.edgeTargets_[edge];
+                const auto nextDistance = distance + graph.edgeTravelTimes_[edge];
+                if (nextDistance < distances[next]) {
+                    distances[next] = nextDistance;
+                    queue.push_back({nextDistance, next});
+                    std::push_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+                }
+            }
+        }
+    }
+
+    /*! \brief Search on from the stations whose travel times from (or, if
+     *         `reverse` is set, to) a landmark got shorter, in the table
+     *         column starting at `distances` with one entry every `stride`.
+     */
+    void LowerStationDistances(
+        const CompactGraph& graph,
+        const std::vector<uint32_t>& edges,
+        bool reverse,
+        unsigned int* distances,
+        size_t stride) {
+        using QueueEntry = std::pair<unsigned int, IdHandle>;
+        auto distance = [distances, stride](IdHandle station) -> unsigned int& {
+            return distances[station * stride];
+        };
+        std::vector<QueueEntry> queue;
+        auto relax = [&](uint32_t edge) {
+            const auto from = reverse ? graph.edgeTargets_[edge] : graph.edgeSources_[edge];
+            const auto next = reverse ? graph.edgeSources_[edge] : graph.edgeTargets_[edge];
+            if (distance(from) == LandmarkTable::kUnreachable) {
+                return;
+            }
+            const auto nextDistance = distance(from) + graph.edgeTravelTimes_[edge];
+            if (nextDistance < distance(next)) {
+                distance(next) = nextDistance;
+                queue.push_back({nextDistance, next});
+                std::push_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+            }
+        };
+        for (const auto edge : edges) {
+            relax(edge);
+        }
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+            const auto [stationDistance, station] = queue.back();
+            queue.pop_back();
+            if (stationDistance > distance(station)) {
+                continue;
+            }
+            if (reverse) {
+                for (auto idx = graph.inEdgeOffsets_[station]; idx < graph.inEdgeOffsets_[station + 1]; ++idx) {
+                    relax(graph.inEdges_[idx]);
+                }
+            } else {
+                for (auto edge = graph.edgeOffsets_[station]; edge < graph.edgeOffsets_[station + 1]; ++edge) {
+                    relax(edge);
+                }
+            }
+        }
+    }
+}
+
+namespace NetworkMonitor {
+    LandmarkTable LandmarkTable::Build(const CompactGraph& graph, size_t count) {
+        LandmarkTable table;
+        const auto nStations = graph.GetStationCount();
+        count = std::min(count, nStations);
+        if (count == 0) {
+            return table;
+        }
+        table.landmarks_.reserve(count);
+        table.fromLandmark_.resize(nStations * count);
+        table.toLandmark_.resize(nStations * count);
+
+        // Farthest-point selection: each new landmark is the station whose
+        // round trip to the closest landmark so far is the longest. The first
+        // one is picked the same way from station 0.
+        std::vector<unsigned int> from;
+        std::vector<unsigned int> to;
+        std::vector<unsigned int> closest(nStations, kUnreachable);
+        IdHandle landmark = 0;
+        GetStationDistances(graph, 0, false, from);
+        for (IdHandle station = 0; station < nStations; ++station) {
+            if (from[station] != kUnreachable && from[station] > from[landmark]) {
+                landmark = station;
+            }
+        }
+        for (size_t idx = 0; idx < count; ++idx) {
+            table.landmarks_.push_back(landmark);
+            GetStationDistances(graph, landmark, false, from);
+            GetStationDistances(graph, landmark, true, to);
+            for (IdHandle station = 0; station < nStations; ++station) {
+                table.fromLandmark_[station * count + idx] = from[station];
+                table.toLandmark_[station * count + idx] = to[station];
+                if (from[station] != kUnreachable && to[station] != kUnreachable) {
+                    closest[station] = std::min(closest[station], from[station] + to[station]);
+                } else {
+                    closest[station] = std::min(closest[station], kUnreachable - 1);
+                }
+            }
+            closest[landmark] = 0;
+            landmark = static_cast<IdHandle>(
+                std::max_element(closest.begin(), closest.end()) - closest.begin());
+        }
+        return table;
+    }
+
+    LandmarkTable LandmarkTable::Lower(
+            const CompactGraph& graph,
+            const std::vector<uint32_t>& edges) const {
+        // Travel times only get shorter through the decreased edges, so
+        // each search starts from them and stops where nothing gets shorter.
+        LandmarkTable table {*this};
+        const auto nLandmarks = landmarks_.size();
+        for (size_t idx = 0; idx < nLandmarks; ++idx) {
+            LowerStationDistances(graph, edges, false, table.fromLandmark_.data() + idx, nLandmarks);
+            LowerStationDistances(graph, edges, true, table.toLandmark_.data() + idx, nLandmarks);
+        }
+        return table;
+    }
+
+    LandmarkTable LandmarkTable::Grow(size_t nStations) const {
+        // No edge reaches the new stations yet.
+        LandmarkTable table {*this};
+        table.fromLandmark_.resize(nStations * landmarks_.size(), kUnreachable);
+        table.toLandmark_.resize(nStations * landmarks_.size(), kUnreachable);
+        return table;
+    }
+}
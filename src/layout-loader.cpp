@@ -0,0 +1,1153 @@
+#include "network-monitor-internal/layout-loader.h"
+#include "network-monitor/transport-network.h"
+#include "network-monitor-internal/transport-network-internal.h"
+#include "network-monitor-internal/landmarks.h"
+#include "network-monitor-internal/network-snapshot.h"
+#include "network-monitor-internal/parallel.h"
+#include "network-monitor-internal/timetable.h"
+
+#include <nlohmann/json.hpp>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+    using NetworkMonitor::CompactGraph;
+    using NetworkMonitor::Id;
+    using NetworkMonitor::IdHandle;
+    using NetworkMonitor::IdTable;
+    using NetworkMonitor::LandmarkTable;
+    using NetworkMonitor::LayoutBuilder;
+    using NetworkMonitor::LayoutLine;
+    using NetworkMonitor::LayoutRoute;
+    using NetworkMonitor::NetworkLoadStats;
+    using NetworkMonitor::RouteEdge;
+    using NetworkMonitor::RunInParallel;
+    using NetworkMonitor::RouteTimetable;
+    using NetworkMonitor::SharedArray;
+    using NetworkMonitor::Timetable;
+
+    /*! \brief Parse the items of a layout array on `nThreads` threads.
+     *
+     *  \returns The items before the first one that failed to parse, and the
+     *           error of that one, if any. Adding the items, then rethrowing
+     *           the error, fails at the same point as parsing and adding them
+     *           one at a time.
+     */
+    template <typename Item, typename Parse>
+    std::pair<std::vector<Item>, std::exception_ptr> ParseItems(
+            const nlohmann::json& array,
+            unsigned int nThreads,
+            const Parse& parse) {
+        std::vector<const nlohmann::json*> items;
+        for (const auto& item : array) {
+            items.push_back(&item);
+        }
+        std::vector<Item> parsed(items.size());
+        std::vector<std::pair<size_t, std::exception_ptr>> errors(
+            nThreads, {items.size(), nullptr});
+        RunInParallel(nThreads, items.size(), [&](unsigned int worker, size_t begin, size_t end) {
+            for (auto idx = begin; idx < end; ++idx) {
+                try {
+                    parsed[idx] = parse(*items[idx]);
+                } catch (...) {
+                    errors[worker] = {idx, std::current_exception()};
+                    return;
+                }
+            }
+        });
+        // The ranges are in order, so the first error is that of the first
+        // worker that had one.
+        auto error = std::find_if(errors.begin(), errors.end(), [](const auto& workerError) {
+            return workerError.second != nullptr;
+        });
+        if (error == errors.end()) {
+            return {std::move(parsed), nullptr};
+        }
+        parsed.resize(error->first);
+        return {std::move(parsed), error->second};
+    }
+
+    /*! \brief Parse the optional timetable keys of a layout route.
+     */
+    RouteTimetable ParseTimetable(const nlohmann::json& route) {
+        RouteTimetable timetable {};
+        if (route.contains("departures")) {
+            timetable.departures = route["departures"].get<std::vector<unsigned int>>();
+        }
+        if (route.contains("headway")) {
+            timetable.headway = route["headway"].get<unsigned int>();
+        }
+        if (route.contains("first_departure")) {
+            timetable.firstDeparture = route["first_departure"].get<unsigned int>();
+        }
+        if (route.contains("last_departure")) {
+            timetable.lastDeparture = route["last_departure"].get<unsigned int>();
+        }
+        return timetable;
+    }
+
+    /*! \brief SAX handler that feeds a network layout to a LayoutBuilder as it
+     *         is parsed.
+     *
+     *  Only one line, and one item within it, is held at a time. Keys the
+     *  builder does not need, and whatever is nested under them, are skipped.
+     */
+    class LayoutSaxHandler : public nlohmann::json_sax<nlohmann::json> {
+    public:
+        explicit LayoutSaxHandler(LayoutBuilder& builder)
+            : builder_(builder) {
+        }
+
+        bool null() override {
+            return true;
+        }
+
+        bool boolean(bool) override {
+            return true;
+        }
+
+        bool number_integer(number_integer_t value) override {
+            return number_unsigned(static_cast<number_unsigned_t>(value));
+        }
+
+        bool number_unsigned(number_unsigned_t value) override {
+            const auto number = static_cast<unsigned int>(value);
+            switch (context_.back()) {
+            case Context::kRoute:
+                if (key_ == "headway") {
+                    routes_.back().timetable.headway = number;
+                } else if (key_ == "first_departure") {
+                    routes_.back().timetable.firstDeparture = number;
+                } else if (key_ == "last_departure") {
+                    routes_.back().timetable.lastDeparture = number;
+                }
+                break;
+            case Context::kRouteDepartures:
+                routes_.back().timetable.departures.push_back(number);
+                break;
+            case Context::kTravelTime:
+                if (key_ == "travel_time") {
+                    travelTime_ = number;
+                }
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+
+        bool number_float(number_float_t value, const string_t&) override {
+            return number_unsigned(static_cast<number_unsigned_t>(value));
+        }
+
+        bool string(string_t& value) override {
+            switch (context_.back()) {
+            case Context::kLine:
+                if (key_ == "line_id") {
+                    lineId_ = std::move(value);
+                }
+                break;
+            case Context::kRoute:
+                if (key_ == "route_id") {
+                    routes_.back().id = std::move(value);
+                }
+                break;
+            case Context::kRouteStops:
+                routes_.back().stops.push_back(builder_.AddStop(value));
+                break;
+            case Context::kStation:
+                if (key_ == "station_id") {
+                    stationId_ = std::move(value);
+                }
+                break;
+            case Context::kTravelTime:
+                if (key_ == "start_station_id") {
+                    stationA_ = std::move(value);
+                } else if (key_ == "end_station_id") {
+                    stationB_ = std::move(value);
+                }
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+
+        bool binary(binary_t&) override {
+            return true;
+        }
+
+        bool start_object(std::size_t) override {
+            Open(true);
+            return true;
+        }
+
+        bool key(string_t& value) override {
+            key_ = std::move(value);
+            return true;
+        }
+
+        bool end_object() override {
+            switch (context_.back()) {
+            case Context::kLine:
+                builder_.AddLine(lineId_, routes_);
+                lineId_.clear();
+                routes_.clear();
+                break;
+            case Context::kStation:
+                builder_.AddStation(stationId_);
+                stationId_.clear();
+                break;
+            case Context::kTravelTime:
+                builder_.AddTravelTime(stationA_, stationB_, travelTime_);
+                stationA_.clear();
+                stationB_.clear();
+                travelTime_ = 0;
+                break;
+            default:
+                break;
+            }
+            context_.pop_back();
+            return true;
+        }
+
+        bool start_array(std::size_t) override {
+            Open(false);
+            return true;
+        }
+
+        bool end_array() override {
+            context_.pop_back();
+            return true;
+        }
+
+        bool parse_error(
+                std::size_t,
+                const std::string&,
+                const nlohmann::detail::exception&) override {
+            return false;
+        }
+
+    private:
+        enum class Context {
+            kDocument,
+            kSkip,
+            kRoot,
+            kLines,
+            kLine,
+            kRoutes,
+            kRoute,
+            kRouteStops,
+            kRouteDepartures,
+            kStations,
+            kStation,
+            kTravelTimes,
+            kTravelTime,
+        };
+
+        void Open(bool isObject) {
+            auto context = Context::kSkip;
+            switch (context_.back()) {
+            case Context::kDocument:
+                context = isObject ? Context::kRoot : Context::kSkip;
+                break;
+            case Context::kRoot:
+                if (!isObject && key_ == "lines") {
+                    context = Context::kLines;
+                } else if (!isObject && key_ == "stations") {
+                    context = Context::kStations;
+                } else if (!isObject && key_ == "travel_times") {
+                    context = Context::kTravelTimes;
+                }
+                break;
+            case Context::kLines:
+                context = isObject ? Context::kLine : Context::kSkip;
+                break;
+            case Context::kLine:
+                context = !isObject && key_ == "routes" ? Context::kRoutes : Context::kSkip;
+                break;
+            case Context::kRoutes:
+                if (isObject) {
+                    context = Context::kRoute;
+                    routes_.push_back({});
+                }
+                break;
+            case Context::kRoute:
+                if (!isObject && key_ == "route_stops") {
+                    context = Context::kRouteStops;
+                } else if (!isObject && key_ == "departures") {
+                    context = Context::kRouteDepartures;
+                }
+                break;
+            case Context::kStations:
+                context = isObject ? Context::kStation : Context::kSkip;
+                break;
+            case Context::kTravelTimes:
+                context = isObject ? Context::kTravelTime : Context::kSkip;
+                break;
+            default:
+                break;
+            }
+            context_.push_back(context);
+            key_.clear();
+        }
+
+        LayoutBuilder& builder_;
+
+        std::vector<Context> context_ {Context::kDocument};
+        std::string key_ {};
+
+        Id lineId_ {};
+        std::vector<LayoutRoute> routes_ {};
+        Id stationId_ {};
+        Id stationA_ {};
+        Id stationB_ {};
+        unsigned int travelTime_ {0};
+    };
+
+    // Layout image, in native byte order:
+    // - ImageHeader.
+    // - ImageSection, kSectionCount times.
+    // - The sections, each at an offset that is a multiple of 8.
+    // The checksum covers everything after the header.
+    constexpr char kImageMagic[8] {'N', 'M', 'L', 'A', 'Y', 'O', 'U', 'T'};
+    constexpr uint32_t kImageVersion {2};
+
+    struct ImageHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t nSections;
+        uint64_t fileSize;
+        uint64_t checksum;
+    };
+
+    struct ImageSection {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // Each ID table is a section of nIds + 1 uint32_t offsets and a section
+    // of the IDs back to back. The other sections are uint32_t arrays,
+    // laid out as in CompactGraph, LandmarkTable and Timetable.
+    enum ImageSectionId : uint32_t {
+        kStationIdOffsets,
+        kStationIds,
+        kLineIdOffsets,
+        kLineIds,
+        kRouteIdOffsets,
+        kRouteIds,
+        kRouteLines,
+        kEdgeOffsets,
+        kEdgeTargets,
+        kEdgeTravelTimes,
+        kEdgeRouteOffsets,
+        kEdgeRoutes,
+        kLandmarks,
+        kFromLandmark,
+        kToLandmark,
+        kRouteHeadways,
+        kRouteFirstDepartures,
+        kRouteLastDepartures,
+        kRouteDepartureOffsets,
+        kRouteDepartures,
+        kSectionCount,
+    };
+
+    constexpr size_t kSectionsOffset {sizeof(ImageHeader)};
+
+    // 64-bit FNV-1a.
+    uint64_t GetImageChecksum(const char* data, size_t size) {
+        uint64_t hash {14695981039346656037ull};
+        for (size_t idx = 0; idx < size; ++idx) {
+            hash ^= static_cast<unsigned char>(data[idx]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    /*! \brief Lay out the sections of a layout image in memory.
+     */
+    class ImageWriter {
+    public:
+        ImageWriter()
+            : data_(kSectionsOffset + kSectionCount * sizeof(ImageSection), '\0') {
+        }
+
+        template <typename T>
+        void Add(ImageSectionId id, const std::vector<T>& values) {
+            static_assert(sizeof(T) == sizeof(uint32_t), "sections hold 32-bit values");
+            Add(id, values.data(), values.size() * sizeof(T));
+        }
+
+        template <typename T>
+        void Add(ImageSectionId id, const SharedArray<T>& values) {
+            static_assert(sizeof(T) == sizeof(uint32_t), "sections hold 32-bit values");
+            Add(id, values.data(), values.size() * sizeof(T));
+        }
+
+        void Add(ImageSectionId id, const IdTable& ids, ImageSectionId chars) {
+            std::vector<uint32_t> offsets {0};
+            std::string idChars;
+            for (IdHandle handle = 0; handle < ids.Size(); ++handle) {
+                idChars += ids.Get(handle);
+                offsets.push_back(static_cast<uint32_t>(idChars.size()));
+            }
+            Add(id, offsets);
+            Add(chars, idChars.data(), idChars.size());
+        }
+
+        std::vector<char> Finish() && {
+            ImageHeader header {};
+            std::memcpy(header.magic, kImageMagic, sizeof(kImageMagic));
+            header.version = kImageVersion;
+            header.nSections = kSectionCount;
+            header.fileSize = data_.size();
+            header.checksum = GetImageChecksum(
+                data_.data() + kSectionsOffset,
+                data_.size() - kSectionsOffset);
+            std::memcpy(data_.data(), &header, sizeof(header));
+            return std::move(data_);
+        }
+
+    private:
+        void Add(ImageSectionId id, const void* values, size_t size) {
+            data_.resize((data_.size() + 7) / 8 * 8, '\0');
+            const ImageSection section {data_.size(), size};
+            std::memcpy(
+                data_.data() + kSectionsOffset + id * sizeof(ImageSection),
+                &section,
+                sizeof(section));
+            const auto* bytes = static_cast<const char*>(values);
+            data_.insert(data_.end(), bytes, bytes + size);
+        }
+
+        std::vector<char> data_;
+    };
+
+    /*! \brief Read the sections of a mapped layout image.
+     */
+    class ImageReader {
+    public:
+        ImageReader(const char* data, size_t size)
+            : data_(data),
+              size_(size) {
+        }
+
+        /*! \brief Check the header and the checksum, and that every section
+         *         is within the file.
+         */
+        bool IsValid() const {
+            ImageHeader header {};
+            if (size_ < kSectionsOffset + kSectionCount * sizeof(ImageSection)) {
+                return false;
+            }
+            std::memcpy(&header, data_, sizeof(header));
+            if (std::memcmp(header.magic, kImageMagic, sizeof(kImageMagic)) != 0
+                || header.version != kImageVersion
+                || header.nSections != kSectionCount
+                || header.fileSize != size_
+                || header.checksum != GetImageChecksum(
+                    data_ + kSectionsOffset, size_ - kSectionsOffset)) {
+                return false;
+            }
+            for (uint32_t id = 0; id < kSectionCount; ++id) {
+                const auto section = GetSection(static_cast<ImageSectionId>(id));
+                if (section.offset % 8 != 0
+                    || section.offset > size_
+                    || section.size > size_ - section.offset) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /*! \brief Get a section of uint32_t values, with no copy.
+         *
+         *  \returns false if the section size is not a whole number of values.
+         */
+        bool Get(ImageSectionId id, const uint32_t*& values, size_t& count) const {
+            const auto section = GetSection(id);
+            values = reinterpret_cast<const uint32_t*>(data_ + section.offset);
+            count = section.size / sizeof(uint32_t);
+            return section.size % sizeof(uint32_t) == 0;
+        }
+
+        /*! \returns false if the offsets are inconsistent or an ID appears
+         *          twice.
+         */
+        bool Get(ImageSectionId id, ImageSectionId chars, IdTable& ids) const {
+            const uint32_t* offsets {nullptr};
+            size_t nOffsets {0};
+            const auto charSection = GetSection(chars);
+            if (!Get(id, offsets, nOffsets) || nOffsets == 0 || offsets[0] != 0) {
+                return false;
+            }
+            for (size_t idx = 1; idx < nOffsets; ++idx) {
+                if (offsets[idx] < offsets[idx - 1] || offsets[idx] > charSection.size) {
+                    return false;
+                }
+                ids.Intern(Id(
+                    data_ + charSection.offset + offsets[idx - 1],
+                    offsets[idx] - offsets[idx - 1]));
+            }
+            return ids.Size() == nOffsets - 1;
+        }
+
+    private:
+        ImageSection GetSection(ImageSectionId id) const {
+            ImageSection section {};
+            std::memcpy(
+                &section,
+                data_ + kSectionsOffset + id * sizeof(ImageSection),
+                sizeof(section));
+            return section;
+        }
+
+        const char* data_;
+        size_t size_;
+    };
+
+    /*! \brief What a layout image holds, checked and ready to be moved into a
+     *         network.
+     */
+    struct ImageContents {
+        IdTable stationIds {};
+        IdTable lineIds {};
+        IdTable routeIds {};
+        std::vector<IdHandle> routeLines {};
+        // Laid out as the image stores it, with its indices built.
+        std::shared_ptr<CompactGraph> graph {};
+        std::unordered_map<IdHandle, RouteTimetable> timetables {};
+        // Null if the image has no landmarks.
+        std::shared_ptr<LandmarkTable> landmarks {};
+    };
+
+    /*! \brief Copy the contents of a valid layout image.
+     *
+     *  \returns false if the sections are not consistent with each other.
+     */
+    bool ReadImage(const ImageReader& image, ImageContents& contents) {
+        if (!image.Get(kStationIdOffsets, kStationIds, contents.stationIds)
+            || !image.Get(kLineIdOffsets, kLineIds, contents.lineIds)
+            || !image.Get(kRouteIdOffsets, kRouteIds, contents.routeIds)) {
+            return false;
+        }
+        const auto nStations = contents.stationIds.Size();
+        const auto nLines = contents.lineIds.Size();
+        const auto nRoutes = contents.routeIds.Size();
+
+        const uint32_t* routeLines {nullptr};
+        size_t nRouteLines {0};
+        if (!image.Get(kRouteLines, routeLines, nRouteLines) || nRouteLines != nRoutes) {
+            return false;
+        }
+        for (size_t route = 0; route < nRoutes; ++route) {
+            if (routeLines[route] >= nLines) {
+                return false;
+            }
+        }
+        contents.routeLines.assign(routeLines, routeLines + nRoutes);
+
+        const uint32_t* edgeOffsets {nullptr};
+        const uint32_t* edgeTargets {nullptr};
+        const uint32_t* edgeTravelTimes {nullptr};
+        const uint32_t* edgeRouteOffsets {nullptr};
+        const uint32_t* edgeRoutes {nullptr};
+        size_t nEdgeOffsets {0};
+        size_t nEdges {0};
+        size_t nEdgeTravelTimes {0};
+        size_t nEdgeRouteOffsets {0};
+        size_t nEdgeRoutes {0};
+        if (!image.Get(kEdgeOffsets, edgeOffsets, nEdgeOffsets)
+            || !image.Get(kEdgeTargets, edgeTargets, nEdges)
+            || !image.Get(kEdgeTravelTimes, edgeTravelTimes, nEdgeTravelTimes)
+            || !image.Get(kEdgeRouteOffsets, edgeRouteOffsets, nEdgeRouteOffsets)
+            || !image.Get(kEdgeRoutes, edgeRoutes, nEdgeRoutes)
+            || nEdgeOffsets != nStations + 1
+            || edgeOffsets[0] != 0
+            || edgeOffsets[nStations] != nEdges
+            || nEdgeTravelTimes != nEdges
+            || nEdgeRouteOffsets != nEdges + 1
+            || edgeRouteOffsets[0] != 0
+            || edgeRouteOffsets[nEdges] != nEdgeRoutes) {
+            return false;
+        }
+        for (IdHandle station = 0; station < nStations; ++station) {
+            if (edgeOffsets[station + 1] < edgeOffsets[station]) {
+                return false;
+            }
+            for (auto edgeIdx = edgeOffsets[station]; edgeIdx < edgeOffsets[station + 1]; ++edgeIdx) {
+                if (edgeTargets[edgeIdx] >= nStations
+                    || (edgeIdx > edgeOffsets[station]
+                        && edgeTargets[edgeIdx] <= edgeTargets[edgeIdx - 1])
+                    || edgeRouteOffsets[edgeIdx + 1] < edgeRouteOffsets[edgeIdx]) {
+                    // Out of range, or not sorted by target station.
+                    return false;
+                }
+                for (auto idx = edgeRouteOffsets[edgeIdx]; idx < edgeRouteOffsets[edgeIdx + 1]; ++idx) {
+                    if (edgeRoutes[idx] >= nRoutes
+                        || (idx > edgeRouteOffsets[edgeIdx] && edgeRoutes[idx] <= edgeRoutes[idx - 1])) {
+                        return false;
+                    }
+                }
+            }
+        }
+        // The sections are laid out as in CompactGraph: they go in as they
+        // are, and only the indices derived from them are built.
+        auto graph = std::make_shared<CompactGraph>();
+        graph->routeLines_ = contents.routeLines;
+        graph->edgeOffsets_ = {edgeOffsets, edgeOffsets + nEdgeOffsets};
+        graph->edgeTargets_ = {edgeTargets, edgeTargets + nEdges};
+        graph->edgeTravelTimes_ = {edgeTravelTimes, edgeTravelTimes + nEdges};
+        graph->edgeRouteOffsets_ = {edgeRouteOffsets, edgeRouteOffsets + nEdgeRouteOffsets};
+        graph->edgeRoutes_ = {edgeRoutes, edgeRoutes + nEdgeRoutes};
+        graph->BuildIndices();
+        contents.graph = std::move(graph);
+
+        const uint32_t* headways {nullptr};
+        const uint32_t* firstDepartures {nullptr};
+        const uint32_t* lastDepartures {nullptr};
+        const uint32_t* departureOffsets {nullptr};
+        const uint32_t* departures {nullptr};
+        size_t nHeadways {0};
+        size_t nFirstDepartures {0};
+        size_t nLastDepartures {0};
+        size_t nDepartureOffsets {0};
+        size_t nDepartures {0};
+        if (!image.Get(kRouteHeadways, headways, nHeadways)
+            || !image.Get(kRouteFirstDepartures, firstDepartures, nFirstDepartures)
+            || !image.Get(kRouteLastDepartures, lastDepartures, nLastDepartures)
+            || !image.Get(kRouteDepartureOffsets, departureOffsets, nDepartureOffsets)
+            || !image.Get(kRouteDepartures, departures, nDepartures)
+            || nHeadways != nRoutes
+            || nFirstDepartures != nRoutes
+            || nLastDepartures != nRoutes
+            || nDepartureOffsets != nRoutes + 1
+            || departureOffsets[0] != 0
+            || departureOffsets[nRoutes] != nDepartures) {
+            return false;
+        }
+        for (IdHandle route = 0; route < nRoutes; ++route) {
+            if (departureOffsets[route + 1] < departureOffsets[route]) {
+                return false;
+            }
+            RouteTimetable timetable {
+                {departures + departureOffsets[route], departures + departureOffsets[route + 1]},
+                headways[route],
+                firstDepartures[route],
+                lastDepartures[route],
+            };
+            if (timetable != RouteTimetable {}) {
+                contents.timetables.emplace(route, std::move(timetable));
+            }
+        }
+
+        const uint32_t* landmarks {nullptr};
+        const uint32_t* fromLandmark {nullptr};
+        const uint32_t* toLandmark {nullptr};
+        size_t nLandmarks {0};
+        size_t nFromLandmark {0};
+        size_t nToLandmark {0};
+        if (!image.Get(kLandmarks, landmarks, nLandmarks)
+            || !image.Get(kFromLandmark, fromLandmark, nFromLandmark)
+            || !image.Get(kToLandmark, toLandmark, nToLandmark)
+            || nFromLandmark != nStations * nLandmarks
+            || nToLandmark != nStations * nLandmarks) {
+            return false;
+        }
+        for (size_t idx = 0; idx < nLandmarks; ++idx) {
+            if (landmarks[idx] >= nStations) {
+                return false;
+            }
+        }
+        if (nLandmarks > 0) {
+            contents.landmarks = std::make_shared<LandmarkTable>(LandmarkTable {
+                {landmarks, landmarks + nLandmarks},
+                {fromLandmark, fromLandmark + nFromLandmark},
+                {toLandmark, toLandmark + nToLandmark},
+            });
+        }
+        return true;
+    }
+
+    /*! \brief Map a whole file in memory, read-only.
+     *
+     *  \returns The mapping, or MAP_FAILED if the file cannot be read or is
+     *           empty.
+     */
+    void* MapLayoutFile(const std::filesystem::path& file, size_t& size) {
+        const int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return MAP_FAILED;
+        }
+        struct stat fileStat {};
+        if (fstat(fd, &fileStat) != 0) {
+            close(fd);
+            return MAP_FAILED;
+        }
+        size = static_cast<size_t>(fileStat.st_size);
+        void* mapping = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        return mapping;
+    }
+
+    void FillLoadStats(std::chrono::steady_clock::time_point start, NetworkLoadStats* stats) {
+        if (stats == nullptr) {
+            return;
+        }
+        stats->loadTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        struct rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        // In kilobytes on Linux.
+        stats->peakMemory = static_cast<size_t>(usage.ru_maxrss) * 1024;
+    }
+}
+
+namespace NetworkMonitor {
+
+LayoutBuilder::LayoutBuilder(TransportNetwork& network, unsigned int nThreads)
+    : network_(network),
+      nThreads_(GetThreadCount(nThreads)),
+      declared_(network.stationIds_.Size(), true),
+      firstLines_(network.stationIds_.Size(), kInvalidIdHandle) {
+    network_.LoadPendingEdges();
+}
+
+void LayoutBuilder::AddStation(const Id& stationId) {
+    const auto station = network_.stationIds_.Find(stationId);
+    if (station == kInvalidIdHandle) {
+        network_.AddStationNode(Station {stationId, {}});
+        declared_.push_back(true);
+        firstLines_.push_back(kInvalidIdHandle);
+        return;
+    }
+    if (declared_[station]) {
+        throw std::runtime_error("Unable to add station: " + stationId);
+    }
+    declared_[station] = true;
+}
+
+IdHandle LayoutBuilder::AddStop(const Id& stationId) {
+    const auto station = network_.stationIds_.Find(stationId);
+    if (station != kInvalidIdHandle) {
+        return station;
+    }
+    network_.AddStationNode(Station {stationId, {}});
+    declared_.push_back(false);
+    firstLines_.push_back(kInvalidIdHandle);
+    return static_cast<IdHandle>(declared_.size() - 1);
+}
+
+IdHandle LayoutBuilder::AddRoute(IdHandle line, const LayoutRoute& route) {
+    auto& network = network_;
+    const auto routeId = network.routeIds_.Intern(route.id);
+    if (routeId == network.routeLines_.size()) {
+        network.routeLines_.push_back(line);
+    }
+    if (route.timetable == RouteTimetable {}) {
+        network.routeTimetables_.erase(routeId);
+    } else {
+        network.routeTimetables_[routeId] = route.timetable;
+    }
+    for (const auto station : route.stops) {
+        if (!declared_[station] && firstLines_[station] == kInvalidIdHandle) {
+            firstLines_[station] = line;
+        }
+    }
+    return routeId;
+}
+
+void LayoutBuilder::AddLine(const Id& lineId, const std::vector<LayoutRoute>& routes) {
+    auto& network = network_;
+    const auto line = network.lineIds_.Intern(lineId);
+    for (const auto& route : routes) {
+        const auto routeId = AddRoute(line, route);
+        for (size_t idx = 1; idx < route.stops.size(); ++idx) {
+            const auto edgeIdx = network.stationNodes_[route.stops[idx - 1]].GetOrMakeEdge(
+                route.stops[idx], network.edges_);
+            if (!network.edges_[edgeIdx].AddRoute(routeId)) {
+                throw std::runtime_error("Unable to add line: " + lineId);
+            }
+        }
+    }
+}
+
+void LayoutBuilder::AddLines(const std::vector<LayoutLine>& lines) {
+    auto& network = network_;
+
+    // Look up the stops in parallel. Those not found are added in order
+    // below, so they get the same handles as with AddStop.
+    std::vector<std::vector<LayoutRoute>> lineRoutes(lines.size());
+    RunInParallel(nThreads_, lines.size(), [&](unsigned int, size_t begin, size_t end) {
+        for (auto idx = begin; idx < end; ++idx) {
+            for (const auto& route : lines[idx].routes) {
+                lineRoutes[idx].push_back({route.id, {}, route.timetable});
+                for (const auto& stop : route.stops) {
+                    lineRoutes[idx].back().stops.push_back(network.stationIds_.Find(stop));
+                }
+            }
+        }
+    });
+    for (size_t idx = 0; idx < lines.size(); ++idx) {
+        for (size_t routeIdx = 0; routeIdx < lineRoutes[idx].size(); ++routeIdx) {
+            auto& stops = lineRoutes[idx][routeIdx].stops;
+            for (size_t stopIdx = 0; stopIdx < stops.size(); ++stopIdx) {
+                if (stops[stopIdx] == kInvalidIdHandle) {
+                    stops[stopIdx] = AddStop(lines[idx].routes[routeIdx].stops[stopIdx]);
+                }
+            }
+        }
+    }
+    if (!network.edges_.empty()) {
+        // Edge indices are shared with the existing edges: add the lines one
+        // at a time.
+        for (size_t idx = 0; idx < lines.size(); ++idx) {
+            AddLine(lines[idx].id, lineRoutes[idx]);
+        }
+        return;
+    }
+
+    // Intern the lines and routes, and bucket the hops of every route by
+    // the station they leave, in layout order.
+    struct Hop {
+        IdHandle to;
+        IdHandle route;
+        uint32_t line;
+    };
+    const auto nStations = network.stationNodes_.size();
+    std::vector<uint32_t> hopOffsets(nStations + 1, 0);
+    for (size_t idx = 0; idx < lines.size(); ++idx) {
+        const auto line = network.lineIds_.Intern(lines[idx].id);
+        for (const auto& route : lineRoutes[idx]) {
+            AddRoute(line, route);
+            for (size_t stopIdx = 1; stopIdx < route.stops.size(); ++stopIdx) {
+                ++hopOffsets[route.stops[stopIdx - 1] + 1];
+            }
+        }
+    }
+    for (size_t station = 0; station < nStations; ++station) {
+        hopOffsets[station + 1] += hopOffsets[station];
+    }
+    std::vector<Hop> hops(hopOffsets.back());
+    auto nextHops = hopOffsets;
+    for (size_t idx = 0; idx < lines.size(); ++idx) {
+        for (const auto& route : lineRoutes[idx]) {
+            const auto routeId = network.routeIds_.Find(route.id);
+            for (size_t stopIdx = 1; stopIdx < route.stops.size(); ++stopIdx) {
+                hops[nextHops[route.stops[stopIdx - 1]]++] = Hop {
+                    route.stops[stopIdx],
+                    routeId,
+                    static_cast<uint32_t>(idx),
+                };
+            }
+        }
+    }
+
+    // Each worker builds the edges leaving its stations, numbered from 0,
+    // and notes the first line to run a route twice over one of them: that
+    // is the line AddLine would have failed on.
+    std::vector<std::vector<RouteEdge>> workerEdges(nThreads_);
+    std::vector<uint32_t> failedLines(nThreads_, static_cast<uint32_t>(lines.size()));
+    RunInParallel(nThreads_, nStations, [&](unsigned int worker, size_t begin, size_t end) {
+        auto& edges = workerEdges[worker];
+        for (auto station = begin; station < end; ++station) {
+            auto& node = network.stationNodes_[station];
+            for (auto hopIdx = hopOffsets[station]; hopIdx < hopOffsets[station + 1]; ++hopIdx) {
+                const auto& hop = hops[hopIdx];
+                const auto edgeIdx = node.GetOrMakeEdge(hop.to, edges);
+                if (!edges[edgeIdx].AddRoute(hop.route)) {
+                    failedLines[worker] = std::min(failedLines[worker], hop.line);
+                }
+            }
+        }
+    });
+    const auto failedLine = *std::min_element(failedLines.begin(), failedLines.end());
+    if (failedLine < lines.size()) {
+        throw std::runtime_error("Unable to add line: " + lines[failedLine].id);
+    }
+
+    // The workers own consecutive stations, so their edges go in station
+    // order whatever the number of threads.
+    std::vector<uint32_t> edgeBases(nThreads_, 0);
+    for (unsigned int worker = 0; worker < nThreads_; ++worker) {
+        edgeBases[worker] = static_cast<uint32_t>(network.edges_.size());
+        network.edges_.insert(
+            network.edges_.end(),
+            std::make_move_iterator(workerEdges[worker].begin()),
+            std::make_move_iterator(workerEdges[worker].end()));
+    }
+    RunInParallel(nThreads_, nStations, [&](unsigned int worker, size_t begin, size_t end) {
+        for (auto station = begin; station < end; ++station) {
+            for (auto& [_, edgeIdx] : network.stationNodes_[station].toStationIdToEdge_) {
+                edgeIdx += edgeBases[worker];
+            }
+        }
+    });
+}
+
+void LayoutBuilder::AddTravelTime(
+        const Id& stationA,
+        const Id& stationB,
+        unsigned int travelTime) {
+    const auto stationIdA = network_.stationIds_.Find(stationA);
+    const auto stationIdB = network_.stationIds_.Find(stationB);
+    if (stationIdA == kInvalidIdHandle || stationIdB == kInvalidIdHandle) {
+        pendingTravelTimes_.emplace_back(stationA, stationB, travelTime);
+        return;
+    }
+    travelTimes_.emplace_back(stationIdA, stationIdB, travelTime);
+}
+
+void LayoutBuilder::Finish() {
+    auto& network = network_;
+    for (IdHandle station = 0; station < declared_.size(); ++station) {
+        if (!declared_[station]) {
+            throw std::runtime_error(
+                "Unable to add line: " + network.lineIds_.Get(firstLines_[station]));
+        }
+    }
+    for (const auto& [stationA, stationB, travelTime] : pendingTravelTimes_) {
+        const auto stationIdA = network.stationIds_.Find(stationA);
+        const auto stationIdB = network.stationIds_.Find(stationB);
+        if (stationIdA != kInvalidIdHandle && stationIdB != kInvalidIdHandle) {
+            travelTimes_.emplace_back(stationIdA, stationIdB, travelTime);
+        }
+    }
+
+    // Bucket both directions of every travel time by the station they
+    // leave, in layout order.
+    struct Leg {
+        IdHandle to;
+        unsigned int travelTime;
+    };
+    const auto nStations = declared_.size();
+    std::vector<uint32_t> legOffsets(nStations + 1, 0);
+    for (const auto& [stationA, stationB, travelTime] : travelTimes_) {
+        ++legOffsets[stationA + 1];
+        ++legOffsets[stationB + 1];
+    }
+    for (size_t station = 0; station < nStations; ++station) {
+        legOffsets[station + 1] += legOffsets[station];
+    }
+    std::vector<Leg> legs(legOffsets.back());
+    auto nextLegs = legOffsets;
+    for (const auto& [stationA, stationB, travelTime] : travelTimes_) {
+        legs[nextLegs[stationA]++] = Leg {stationB, travelTime};
+        legs[nextLegs[stationB]++] = Leg {stationA, travelTime};
+    }
+
+    // An edge is only set by the worker that owns the station it leaves, in
+    // layout order, so the last travel time listed for it wins.
+    RunInParallel(nThreads_, nStations, [&](unsigned int, size_t begin, size_t end) {
+        for (auto station = begin; station < end; ++station) {
+            for (auto legIdx = legOffsets[station]; legIdx < legOffsets[station + 1]; ++legIdx) {
+                const auto& leg = legs[legIdx];
+                network.SetEdgeTravelTime(static_cast<IdHandle>(station), leg.to, leg.travelTime);
+            }
+        }
+    });
+    network.PublishTopology();
+    network.RebuildLandmarks();
+}
+
+bool TransportNetwork::FromJson(
+    nlohmann::json&& src,
+    unsigned int nThreads) {
+    nThreads = GetThreadCount(nThreads);
+    LayoutBuilder builder {*this, nThreads};
+
+    auto [stations, stationsError] = ParseItems<Id>(
+        src["stations"],
+        nThreads,
+        [](const nlohmann::json& station) {
+            return station["station_id"].template get<std::string>();
+        });
+    for (const auto& station : stations) {
+        builder.AddStation(station);
+    }
+    if (stationsError != nullptr) {
+        std::rethrow_exception(stationsError);
+    }
+
+    auto [lines, linesError] = ParseItems<LayoutLine>(
+        src["lines"],
+        nThreads,
+        [](const nlohmann::json& line) {
+            LayoutLine parsed {};
+            for (const auto& route : line["routes"]) {
+                parsed.routes.push_back({route["route_id"].template get<std::string>(), {}});
+                for (const auto& stop : route["route_stops"]) {
+                    parsed.routes.back().stops.push_back(stop.template get<std::string>());
+                }
+                parsed.routes.back().timetable = ParseTimetable(route);
+            }
+            parsed.id = line["line_id"].template get<std::string>();
+            return parsed;
+        });
+    builder.AddLines(lines);
+    if (linesError != nullptr) {
+        std::rethrow_exception(linesError);
+    }
+
+    auto [travelTimes, travelTimesError] = ParseItems<std::tuple<Id, Id, unsigned int>>(
+        src["travel_times"],
+        nThreads,
+        [](const nlohmann::json& travelTime) {
+            return std::make_tuple(
+                travelTime["start_station_id"].template get<std::string>(),
+                travelTime["end_station_id"].template get<std::string>(),
+                travelTime["travel_time"].template get<unsigned int>());
+        });
+    if (travelTimesError != nullptr) {
+        std::rethrow_exception(travelTimesError);
+    }
+    for (const auto& [stationA, stationB, travelTime] : travelTimes) {
+        builder.AddTravelTime(stationA, stationB, travelTime);
+    }
+    builder.Finish();
+    return true;
+}
+
+bool TransportNetwork::FromJsonFile(
+        const std::filesystem::path& file,
+        NetworkLoadStats* stats) {
+    const auto start = std::chrono::steady_clock::now();
+    size_t size {0};
+    void* mapping = MapLayoutFile(file, size);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    LayoutBuilder builder {*this};
+    LayoutSaxHandler handler {builder};
+    const auto* begin = static_cast<const char*>(mapping);
+    bool parsed {false};
+    try {
+        parsed = nlohmann::json::sax_parse(begin, begin + size, &handler);
+    } catch (...) {
+        munmap(mapping, size);
+        throw;
+    }
+    munmap(mapping, size);
+    if (!parsed) {
+        return false;
+    }
+    builder.Finish();
+    FillLoadStats(start, stats);
+    return true;
+}
+
+bool TransportNetwork::WriteLayoutImage(const std::filesystem::path& file) const {
+    // The routes and travel times are written as queries see them, from one
+    // snapshot.
+    const auto snapshot = GetSnapshot();
+    const auto& graph = *snapshot->graph;
+    ImageWriter writer;
+    writer.Add(kStationIdOffsets, *snapshot->stationIds, kStationIds);
+    writer.Add(kLineIdOffsets, *snapshot->lineIds, kLineIds);
+    writer.Add(kRouteIdOffsets, *snapshot->routeIds, kRouteIds);
+    writer.Add(kRouteLines, graph.routeLines_);
+    writer.Add(kEdgeOffsets, graph.edgeOffsets_);
+    writer.Add(kEdgeTargets, graph.edgeTargets_);
+    writer.Add(kEdgeTravelTimes, graph.edgeTravelTimes_);
+    writer.Add(kEdgeRouteOffsets, graph.edgeRouteOffsets_);
+    writer.Add(kEdgeRoutes, graph.edgeRoutes_);
+    const LandmarkTable noLandmarks {};
+    const auto& landmarks = snapshot->landmarks == nullptr ? noLandmarks : *snapshot->landmarks;
+    writer.Add(kLandmarks, landmarks.landmarks_);
+    writer.Add(kFromLandmark, landmarks.fromLandmark_);
+    writer.Add(kToLandmark, landmarks.toLandmark_);
+    const auto& timetable = *snapshot->timetable;
+    writer.Add(kRouteHeadways, timetable.headways_);
+    writer.Add(kRouteFirstDepartures, timetable.firstDepartures_);
+    writer.Add(kRouteLastDepartures, timetable.lastDepartures_);
+    writer.Add(kRouteDepartureOffsets, timetable.departureOffsets_);
+    writer.Add(kRouteDepartures, timetable.departures_);
+    const auto data = std::move(writer).Finish();
+
+    // Written next to the destination and moved in place once complete, like
+    // the travel time matrix.
+    auto partialFile = file;
+    partialFile += ".partial";
+    std::ofstream out {partialFile, std::ios::binary | std::ios::trunc};
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    out.close();
+    std::error_code ec {};
+    if (out) {
+        std::filesystem::rename(partialFile, file, ec);
+    }
+    if (!out || ec) {
+        Log("Could not write " + file.string(), "WriteLayoutImage");
+        std::filesystem::remove(partialFile, ec);
+        return false;
+    }
+    return true;
+}
+
+bool TransportNetwork::FromLayoutImage(
+        const std::filesystem::path& file,
+        NetworkLoadStats* stats) {
+    const auto start = std::chrono::steady_clock::now();
+    if (stationIds_.Size() != 0 || lineIds_.Size() != 0) {
+        return false;
+    }
+    size_t size {0};
+    void* mapping = MapLayoutFile(file, size);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    const ImageReader image {static_cast<const char*>(mapping), size};
+    ImageContents contents {};
+    const bool read = image.IsValid() && ReadImage(image, contents);
+    munmap(mapping, size);
+    if (!read) {
+        return false;
+    }
+
+    stationIds_ = std::move(contents.stationIds);
+    lineIds_ = std::move(contents.lineIds);
+    routeIds_ = std::move(contents.routeIds);
+    routeLines_ = std::move(contents.routeLines);
+    routeTimetables_ = std::move(contents.timetables);
+    // The build-side edges are only filled in if the network is changed.
+    edgesPending_ = true;
+    PublishTopology(std::move(contents.graph));
+    if (contents.landmarks != nullptr && contents.landmarks->landmarks_.size() == landmarkCount_) {
+        auto snapshot = std::make_shared<NetworkSnapshot>(*GetSnapshot());
+        snapshot->landmarks = std::move(contents.landmarks);
+        Publish(std::move(snapshot));
+    } else {
+        RebuildLandmarks();
+    }
+    FillLoadStats(start, stats);
+    return true;
+}
+
+bool TransportNetwork::IsLayoutImage(const std::filesystem::path& file) {
+    std::ifstream in {file, std::ios::binary};
+    char magic[sizeof(kImageMagic)] {};
+    in.read(magic, sizeof(magic));
+    return in && std::memcmp(magic, kImageMagic, sizeof(kImageMagic)) == 0;
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,195 @@
+#include "network-monitor-internal/network-snapshot.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+    using NetworkMonitor::IdHandle;
+
+    // Most crowded first, then by handle so that ties rank the same way
+    // every time.
+    bool IsMoreCrowded(
+            const std::pair<IdHandle, long long int>& a,
+            const std::pair<IdHandle, long long int>& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    }
+}
+
+namespace NetworkMonitor {
+    PassengerCounters::PassengerCounters()
+        : ranking_(std::make_shared<Ranking>()) {
+    }
+
+    PassengerCounters PassengerCounters::Grow(size_t nStations) const {
+        PassengerCounters counters {*this};
+        while (counters.chunks_.size() / kShardCount * kChunkSize < nStations) {
+            for (size_t shard = 0; shard < kShardCount; ++shard) {
+                // Value-initialized: all counts start at 0.
+                counters.chunks_.push_back(std::make_shared<Chunk>());
+            }
+        }
+        if (nStations > size_) {
+            // The new stations are unranked, with a count of 0.
+            std::lock_guard<std::mutex> lock {ranking_->mutex};
+            ranking_->bound = std::max(ranking_->bound.load(), 0ll);
+        }
+        counters.size_ = std::max(size_, nStations);
+        return counters;
+    }
+
+    PassengerCounters PassengerCounters::Clone() const {
+        PassengerCounters counters {};
+        counters.size_ = size_;
+        // Locked, so that no station is ranked or unranked while the counts,
+        // which carry the ranked flags, are copied.
+        std::lock_guard<std::mutex> lock {ranking_->mutex};
+        for (const auto& chunk : chunks_) {
+            counters.chunks_.push_back(std::make_shared<Chunk>());
+            for (size_t idx = 0; idx < kChunkSize; ++idx) {
+                counters.chunks_.back()->counts[idx].store(
+                    chunk->counts[idx].load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+            }
+        }
+        counters.ranking_->stations = ranking_->stations;
+        counters.ranking_->bound = ranking_->bound.load();
+        return counters;
+    }
+
+    size_t PassengerCounters::GetThreadShard() {
+        // Threads take the shards in turn, so up to kShardCount threads
+        // never share one.
+        static std::atomic<size_t> nextShard {0};
+        thread_local const size_t shard {nextShard++ % kShardCount};
+        return shard;
+    }
+
+    void PassengerCounters::SetRanked(IdHandle station, bool ranked) const {
+        for (size_t shard = 0; shard < kShardCount; ++shard) {
+            if (ranked) {
+                Counter(shard, station).fetch_add(kRankedOffset);
+            } else {
+                Counter(shard, station).fetch_sub(kRankedOffset);
+            }
+        }
+        if (!ranked) {
+            // An Add that comes before the flag is taken off its shard is in
+            // the count read here, and the bound is raised to cover it. An Add
+            // that comes after sees the station unranked, and ranks it if it
+            // goes above the bound.
+            auto& bound = ranking_->bound;
+            bound.store(std::max(bound.load(), Get(station)));
+        }
+    }
+
+    void PassengerCounters::Rank(IdHandle station) {
+        auto& ranking = *ranking_;
+        std::lock_guard<std::mutex> lock {ranking.mutex};
+        auto& bound = ranking.bound;
+        const auto count = Get(station);
+        if (IsRanked(Counter(0, station).load()) || count <= bound.load()) {
+            // Another thread got here first.
+            return;
+        }
+        if (ranking.stations.size() < kRankedStations) {
+            SetRanked(station, true);
+            ranking.stations.push_back(station);
+            return;
+        }
+        auto least = ranking.stations.begin();
+        auto leastCount = Get(*least);
+        for (auto it = least + 1; it != ranking.stations.end(); ++it) {
+            const auto itCount = Get(*it);
+            if (itCount < leastCount) {
+                least = it;
+                leastCount = itCount;
+            }
+        }
+        if (leastCount >= count) {
+            bound.store(count);
+            return;
+        }
+        SetRanked(*least, false);
+        SetRanked(station, true);
+        *least = station;
+    }
+
+    void PassengerCounters::Rerank() const {
+        auto& ranking = *ranking_;
+        std::vector<std::pair<IdHandle, long long int>> counts;
+        counts.reserve(size_);
+        for (IdHandle station = 0; station < size_; ++station) {
+            counts.emplace_back(station, Get(station));
+        }
+        const auto nRanked = std::min(kRankedStations, counts.size());
+        std::partial_sort(counts.begin(), counts.begin() + nRanked, counts.end(), IsMoreCrowded);
+        for (const auto station : ranking.stations) {
+            SetRanked(station, false);
+        }
+        ranking.stations.clear();
+        for (size_t idx = 0; idx < nRanked; ++idx) {
+            SetRanked(counts[idx].first, true);
+            ranking.stations.push_back(counts[idx].first);
+        }
+
+        // Lowering the bound races with an Add that read the old one. So the
+        // bound is stored, then the unranked counts are read again and the
+        // bound raised to cover them. An Add that comes before that second
+        // read in the counter's order is in it. An Add that comes after reads
+        // the bound stored before it, or a higher one.
+        auto bound = std::numeric_limits<long long int>::min();
+        for (int pass = 0; pass < 2; ++pass) {
+            for (size_t idx = nRanked; idx < counts.size(); ++idx) {
+                bound = std::max(bound, Get(counts[idx].first));
+            }
+            ranking.bound.store(bound);
+        }
+    }
+
+    std::vector<std::pair<IdHandle, long long int>> PassengerCounters::GetMostCrowded(
+            size_t k,
+            size_t* nScanned) const {
+        k = std::min(k, size_);
+        std::vector<std::pair<IdHandle, long long int>> crowded;
+        if (nScanned != nullptr) {
+            *nScanned = 0;
+        }
+        if (k > kRankedStations) {
+            if (nScanned != nullptr) {
+                *nScanned = size_;
+            }
+            crowded.reserve(size_);
+            for (IdHandle station = 0; station < size_; ++station) {
+                crowded.emplace_back(station, Get(station));
+            }
+            std::partial_sort(crowded.begin(), crowded.begin() + k, crowded.end(), IsMoreCrowded);
+            crowded.resize(k);
+            return crowded;
+        }
+        if (k == 0) {
+            return crowded;
+        }
+
+        auto& ranking = *ranking_;
+        std::lock_guard<std::mutex> lock {ranking.mutex};
+        auto readRanked = [&]() {
+            crowded.clear();
+            for (const auto station : ranking.stations) {
+                crowded.emplace_back(station, Get(station));
+            }
+            std::sort(crowded.begin(), crowded.end(), IsMoreCrowded);
+        };
+        readRanked();
+        // The ranked stations are only the most crowded ones if they have
+        // more passengers than any unranked station might.
+        if (crowded.size() < k || crowded[k - 1].second < ranking.bound.load()) {
+            Rerank();
+            readRanked();
+            if (nScanned != nullptr) {
+                *nScanned = size_;
+            }
+        }
+        crowded.resize(std::min(k, crowded.size()));
+        return crowded;
+    }
+}
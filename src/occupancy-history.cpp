@@ -0,0 +1,91 @@
+#include "network-monitor-internal/occupancy-history.h"
+
+#include <algorithm>
+
+namespace NetworkMonitor {
+    OccupancyHistory::OccupancyHistory(uint32_t horizon)
+        : horizon_(std::max(horizon, 1u)) {
+    }
+
+    OccupancyHistory OccupancyHistory::Grow(size_t nStations) const {
+        OccupancyHistory history {*this};
+        const size_t nSlots = kChunkSize * horizon_;
+        while (history.chunks_.size() * kChunkSize < nStations) {
+            // Value-initialized: all slots start at count 0, second 0.
+            history.chunks_.push_back(std::make_shared<Chunk>(Chunk {
+                Slots(nSlots),
+                Slots(nSlots),
+            }));
+        }
+        return history;
+    }
+
+    OccupancyHistory OccupancyHistory::Clone() const {
+        OccupancyHistory history {horizon_};
+        const size_t nSlots = kChunkSize * horizon_;
+        for (const auto& chunk : chunks_) {
+            auto copy = std::make_shared<Chunk>(Chunk {Slots(nSlots), Slots(nSlots)});
+            for (size_t idx = 0; idx < nSlots; ++idx) {
+                copy->entries[idx].store(
+                    chunk->entries[idx].load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+                copy->exits[idx].store(
+                    chunk->exits[idx].load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+            }
+            history.chunks_.push_back(std::move(copy));
+        }
+        return history;
+    }
+
+    void OccupancyHistory::Add(IdHandle station, PassengerEvent::Type type, uint32_t second) {
+        auto& chunk = *chunks_[station / kChunkSize];
+        auto& slots = type == PassengerEvent::Type::In ? chunk.entries : chunk.exits;
+        Bump(slots[station % kChunkSize * horizon_ + second % horizon_], second);
+    }
+
+    void OccupancyHistory::Bump(std::atomic<uint64_t>& slot, uint32_t second) {
+        auto value = slot.load(std::memory_order_relaxed);
+        while (true) {
+            const auto slotSecond = static_cast<uint32_t>(value >> 32);
+            if (slotSecond == second) {
+                slot.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (slotSecond > second) {
+                // The slot has moved on to a later lap of the ring.
+                return;
+            }
+            const uint64_t reset {(static_cast<uint64_t>(second) << 32) | 1};
+            if (slot.compare_exchange_weak(value, reset, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    OccupancyHistory::Totals OccupancyHistory::GetTotals(
+            IdHandle station,
+            uint32_t from,
+            uint32_t to) const {
+        Totals totals {};
+        if (to <= from) {
+            return totals;
+        }
+        from = std::max(from, to - std::min(to, horizon_));
+        const auto& chunk = *chunks_[station / kChunkSize];
+        const auto offset = station % kChunkSize * horizon_;
+        for (uint32_t second = from + 1; second <= to; ++second) {
+            const auto entries = chunk.entries[offset + second % horizon_].load(
+                std::memory_order_relaxed);
+            if (entries >> 32 == second) {
+                totals.entries += static_cast<uint32_t>(entries);
+            }
+            const auto exits = chunk.exits[offset + second % horizon_].load(
+                std::memory_order_relaxed);
+            if (exits >> 32 == second) {
+                totals.exits += static_cast<uint32_t>(exits);
+            }
+        }
+        return totals;
+    }
+}
@@ -0,0 +1,110 @@
+#include "network-monitor-internal/route-cache.h"
+
+#include <algorithm>
+
+namespace {
+    constexpr size_t kMaxShards {16};
+}
+
+namespace NetworkMonitor {
+    RouteCache::RouteCache(size_t capacity)
+        : capacity_(capacity) {
+        const auto nShards = std::min(capacity, kMaxShards);
+        shards_.reserve(nShards);
+        for (size_t idx = 0; idx < nShards; ++idx) {
+            shards_.push_back(std::make_unique<Shard>());
+            shards_.back()->capacity = capacity / nShards + (idx < capacity % nShards ? 1 : 0);
+        }
+    }
+
+    RouteCache::Shard& RouteCache::GetShard(const Key& key) {
+        // The high bits, as the low ones also pick the bucket within a shard.
+        return *shards_[(KeyHash {}(key) >> 48) % shards_.size()];
+    }
+
+    std::optional<TravelRoute> RouteCache::Find(const Key& key, uint64_t version) {
+        if (shards_.empty()) {
+            return std::nullopt;
+        }
+        auto& shard = GetShard(key);
+        std::lock_guard<std::mutex> lock {shard.mutex};
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            ++misses_;
+            return std::nullopt;
+        }
+        if (it->second->version != version) {
+            // Only a newer graph makes an entry stale: a query on an older
+            // snapshot leaves the entries of the newer one in place.
+            if (it->second->version < version) {
+                shard.entries.erase(it->second);
+                shard.index.erase(it);
+            }
+            ++misses_;
+            return std::nullopt;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        ++hits_;
+        return it->second->route;
+    }
+
+    void RouteCache::Insert(const Key& key, uint64_t version, const TravelRoute& route) {
+        if (shards_.empty()) {
+            return;
+        }
+        auto& shard = GetShard(key);
+        std::lock_guard<std::mutex> lock {shard.mutex};
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            // Another thread computed the same route concurrently, or on a
+            // newer graph, whose route is kept.
+            if (it->second->version > version) {
+                return;
+            }
+            it->second->version = version;
+            it->second->route = route;
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            return;
+        }
+        if (shard.entries.size() == shard.capacity) {
+            shard.index.erase(shard.entries.back().key);
+            shard.entries.pop_back();
+            ++evictions_;
+        }
+        shard.entries.push_front({key, version, route});
+        shard.index.emplace(key, shard.entries.begin());
+    }
+
+    void RouteCache::Carry(
+            uint64_t fromVersion,
+            uint64_t toVersion,
+            const std::function<bool (const TravelRoute&)>& isKept) {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock {shard->mutex};
+            for (auto it = shard->entries.begin(); it != shard->entries.end();) {
+                if (it->version != fromVersion) {
+                    ++it;
+                } else if (isKept(it->route)) {
+                    it->version = toVersion;
+                    ++it;
+                } else {
+                    shard->index.erase(it->key);
+                    it = shard->entries.erase(it);
+                }
+            }
+        }
+    }
+
+    RouteCacheStats RouteCache::GetStats() const {
+        RouteCacheStats stats {};
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.evictions = evictions_;
+        stats.capacity = capacity_;
+        for (const auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock {shard->mutex};
+            stats.size += shard->entries.size();
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,675 @@
+#include "network-monitor-internal/routing-engine.h"
+#include "network-monitor-internal/landmarks.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+namespace {
+    using NetworkMonitor::CompactGraph;
+    using NetworkMonitor::IdHandle;
+    using NetworkMonitor::LandmarkTable;
+    using NetworkMonitor::PassengerCounters;
+    using NetworkMonitor::RouteCostModel;
+    using NetworkMonitor::RouteProfile;
+    using NetworkMonitor::RoutingWorkspace;
+    using NetworkMonitor::kInvalidIdHandle;
+
+    constexpr unsigned int kInfiniteMetric = std::numeric_limits<unsigned int>::max();
+
+    struct StepCost {
+        unsigned int metric;
+        unsigned int distance;
+    };
+
+    // Cost policies. Each one gets the cost of riding `nextRoute` along
+    // `edge`, having arrived on `route` (kInvalidIdHandle at the journey
+    // origin), and the searches are instantiated once per policy.
+
+    bool IsLineChange(const CompactGraph& graph, IdHandle route, IdHandle nextRoute) {
+        return route != kInvalidIdHandle
+            && route != nextRoute
+            && graph.routeLines_[route] != graph.routeLines_[nextRoute];
+    }
+
+    unsigned int GetPassengers(
+            const PassengerCounters& passengers,
+            const CompactGraph& graph,
+            uint32_t edge) {
+        return static_cast<unsigned int>(passengers.Get(graph.edgeTargets_[edge]));
+    }
+
+    struct FastestCost {
+        unsigned int penalty;
+
+        StepCost operator()(
+                const CompactGraph& graph,
+                IdHandle route,
+                IdHandle nextRoute,
+                uint32_t edge) const {
+            const auto distance = graph.edgeTravelTimes_[edge]
+                + penalty * IsLineChange(graph, route, nextRoute);
+            return {distance, distance};
+        }
+    };
+
+    struct QuietestCost {
+        unsigned int penalty;
+        const PassengerCounters& passengers;
+
+        StepCost operator()(
+                const CompactGraph& graph,
+                IdHandle route,
+                IdHandle nextRoute,
+                uint32_t edge) const {
+            const unsigned int change = IsLineChange(graph, route, nextRoute);
+            return {
+                GetPassengers(passengers, graph, edge) * (1 + change),
+                graph.edgeTravelTimes_[edge] + penalty * change,
+            };
+        }
+    };
+
+    struct FewestTransfersCost {
+        // A line change outweighs this much travel time.
+        static constexpr unsigned int kTransferMetric {1u << 16};
+
+        unsigned int penalty;
+
+        StepCost operator()(
+                const CompactGraph& graph,
+                IdHandle route,
+                IdHandle nextRoute,
+                uint32_t edge) const {
+            const unsigned int change = IsLineChange(graph, route, nextRoute);
+            const auto travelTime = graph.edgeTravelTimes_[edge];
+            return {travelTime + kTransferMetric * change, travelTime + penalty * change};
+        }
+    };
+
+    struct WeightedCost {
+        unsigned int penalty;
+        const PassengerCounters& passengers;
+        RouteProfile weights;
+
+        StepCost operator()(
+                const CompactGraph& graph,
+                IdHandle route,
+                IdHandle nextRoute,
+                uint32_t edge) const {
+            const unsigned int change = IsLineChange(graph, route, nextRoute);
+            const auto travelTime = graph.edgeTravelTimes_[edge];
+            const auto crowding = weights.crowdingWeight * GetPassengers(passengers, graph, edge);
+            return {
+                weights.timeWeight * travelTime
+                    + crowding
+                    + (weights.transferWeight + crowding) * change,
+                travelTime + penalty * change,
+            };
+        }
+    };
+
+    /*! \brief Another policy, plus a surcharge per edge on the metric.
+     */
+    template <typename Cost>
+    struct SurchargedCost {
+        Cost cost;
+        const std::vector<unsigned int>& surcharges;
+
+        StepCost operator()(
+                const CompactGraph& graph,
+                IdHandle route,
+                IdHandle nextRoute,
+                uint32_t edge) const {
+            auto step = cost(graph, route, nextRoute, edge);
+            step.metric += surcharges[edge];
+            return step;
+        }
+    };
+
+    /*! \brief Call `visitor` with the cost policy of `costs`.
+     */
+    template <typename Visitor>
+    decltype(auto) VisitCost(const RouteCostModel& costs, Visitor&& visitor) {
+        const auto visit = [&costs, &visitor](const auto& cost) -> decltype(auto) {
+            if (costs.edgeSurcharges != nullptr) {
+                return visitor(SurchargedCost<std::decay_t<decltype(cost)>> {
+                    cost, *costs.edgeSurcharges
+                });
+            }
+            return visitor(cost);
+        };
+        switch (costs.profile.kind) {
+        case RouteProfile::Kind::kQuietest:
+            return visit(QuietestCost {costs.penalty, *costs.passengers});
+        case RouteProfile::Kind::kFewestTransfers:
+            return visit(FewestTransfersCost {costs.penalty});
+        case RouteProfile::Kind::kWeighted:
+            return visit(WeightedCost {costs.penalty, *costs.passengers, costs.profile});
+        case RouteProfile::Kind::kFastest:
+            break;
+        }
+        return visit(FastestCost {costs.penalty});
+    }
+
+    /*! \brief Heuristic of a plain Dijkstra search.
+     */
+    struct NoHeuristic {
+        unsigned int operator()(IdHandle) const {
+            return 0;
+        }
+    };
+
+    /*! \brief Relax every state that follows `state`.
+     *
+     *  States are queued by metric plus `heuristic(station)`. `onReach` is
+     *  called for each state whose label improved.
+     */
+    template <typename Cost, typename Heuristic, typename OnReach>
+    void ScanForward(
+        const CompactGraph& graph,
+        const Cost& costs,
+        RoutingWorkspace& workspace,
+        uint32_t state,
+        const Heuristic& heuristic,
+        OnReach&& onReach) {
+        const auto station = graph.stateStations_[state];
+        const auto route = graph.stateRoutes_[state];
+        const auto metric = workspace.metric_[state];
+        const auto distance = workspace.distance_[state];
+        // At a closed station, passengers stay on the route they came in on.
+        const bool closed = graph.IsClosed(station);
+        for (auto edge = graph.edgeOffsets_[station]; edge < graph.edgeOffsets_[station + 1]; ++edge) {
+            for (auto slot = graph.edgeRouteOffsets_[edge]; slot < graph.edgeRouteOffsets_[edge + 1]; ++slot) {
+                if (closed && graph.edgeRoutes_[slot] != route) {
+                    continue;
+                }
+                const auto nextState = graph.edgeRouteStates_[slot];
+                const auto nextStation = graph.edgeTargets_[edge];
+                const auto cost = costs(graph, route, graph.edgeRoutes_[slot], edge);
+                const auto nextMetric = metric + cost.metric;
+                if (!workspace.IsReached(nextState) || nextMetric < workspace.metric_[nextState]) {
+                    workspace.Reach(nextState, nextMetric, distance + cost.distance, state);
+                    workspace.Push(nextMetric + heuristic(nextStation), nextState);
+                    onReach(nextState);
+                }
+            }
+        }
+    }
+
+    /*! \brief Relax every state that precedes `state` in a search towards
+     *         the journey destination.
+     *
+     *  The workspace labels are costs to the destination and `parent_` holds
+     *  the next state on the journey. Of all origin states, only the one of
+     *  `source` can precede another state.
+     */
+    template <typename Cost, typename OnReach>
+    void ScanBackward(
+        const CompactGraph& graph,
+        const Cost& costs,
+        RoutingWorkspace& workspace,
+        IdHandle source,
+        uint32_t state,
+        OnReach&& onReach) {
+        const auto station = graph.stateStations_[state];
+        const auto route = graph.stateRoutes_[state];
+        if (route == kInvalidIdHandle) {
+            // Origin states start journeys, nothing precedes them.
+            return;
+        }
+        const auto metric = workspace.metric_[state];
+        const auto distance = workspace.distance_[state];
+        auto relax = [&](uint32_t prevState, uint32_t edge) {
+            const auto cost = costs(graph, graph.stateRoutes_[prevState], route, edge);
+            const auto prevMetric = metric + cost.metric;
+            if (!workspace.IsReached(prevState) || prevMetric < workspace.metric_[prevState]) {
+                workspace.Reach(prevState, prevMetric, distance + cost.distance, state);
+                workspace.Push(prevMetric, prevState);
+                onReach(prevState);
+            }
+        };
+        for (auto idx = graph.inEdgeOffsets_[station]; idx < graph.inEdgeOffsets_[station + 1]; ++idx) {
+            const auto edge = graph.inEdges_[idx];
+            const auto firstRoute = graph.edgeRoutes_.begin() + graph.edgeRouteOffsets_[edge];
+            const auto lastRoute = graph.edgeRoutes_.begin() + graph.edgeRouteOffsets_[edge + 1];
+            if (!std::binary_search(firstRoute, lastRoute, route)) {
+                continue;
+            }
+            const auto prevStation = graph.edgeSources_[edge];
+            const bool closed = graph.IsClosed(prevStation);
+            for (auto prevState = graph.stationStateOffsets_[prevStation];
+                    prevState < graph.stationStateOffsets_[prevStation + 1];
+                    ++prevState) {
+                if (!closed || graph.stateRoutes_[prevState] == route) {
+                    relax(prevState, edge);
+                }
+            }
+            if (prevStation == source && !closed) {
+                relax(source, edge);
+            }
+        }
+    }
+
+    /*! \brief Pop queue entries until a current one is found, and count it
+     *         as settled.
+     *
+     *  \returns false if the queue ran out.
+     */
+    template <typename Heuristic = NoHeuristic>
+    bool PopCurrent(
+        const CompactGraph& graph,
+        RoutingWorkspace& workspace,
+        uint32_t& state,
+        const Heuristic& heuristic = {}) {
+        while (!workspace.queue_.empty()) {
+            const auto entry = workspace.Pop();
+            const auto station = graph.stateStations_[entry.state];
+            if (entry.metric == workspace.metric_[entry.state] + heuristic(station)) {
+                state = entry.state;
+                ++workspace.settledStates_;
+                return true;
+            }
+            // Stale queue entry: the state was reached more cheaply since.
+        }
+        return false;
+    }
+
+    unsigned int PeekMetric(const RoutingWorkspace& workspace) {
+        return workspace.queue_.empty() ? kInfiniteMetric : workspace.queue_.front().metric;
+    }
+
+    // The searches of routing-engine.h, for one cost policy.
+
+    template <typename Cost>
+    uint32_t SearchRoutesWith(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const Cost& costs,
+        RoutingWorkspace& workspace,
+        unsigned int maxMetric) {
+        workspace.Reset(graph.GetStateCount());
+        workspace.Reach(source, 0, 0, source);
+        workspace.Push(0, source);
+
+        uint32_t state;
+        while (PopCurrent(graph, workspace, state)) {
+            if (workspace.metric_[state] > maxMetric) {
+                // All the states still queued are further away.
+                break;
+            }
+            if (graph.stateStations_[state] == target) {
+                // States leave the queue in metric order, so this is the best
+                // way to reach the target.
+                return state;
+            }
+            ScanForward(graph, costs, workspace, state, NoHeuristic {}, [](uint32_t) {});
+        }
+        return CompactGraph::kNoIndex;
+    }
+
+    template <typename Cost>
+    uint32_t SearchRoutesAStarWith(
+        const CompactGraph& graph,
+        const LandmarkTable& landmarks,
+        IdHandle source,
+        IdHandle target,
+        const Cost& costs,
+        RoutingWorkspace& workspace) {
+        auto heuristic = [&landmarks, target](IdHandle station) {
+            return landmarks.GetLowerBound(station, target);
+        };
+        workspace.Reset(graph.GetStateCount());
+        workspace.Reach(source, 0, 0, source);
+        workspace.Push(heuristic(source), source);
+
+        uint32_t state;
+        while (PopCurrent(graph, workspace, state, heuristic)) {
+            if (graph.stateStations_[state] == target) {
+                // The bounds are consistent, so as with Dijkstra the first
+                // state of the target to leave the queue is the best one.
+                return state;
+            }
+            ScanForward(graph, costs, workspace, state, heuristic, [](uint32_t) {});
+        }
+        return CompactGraph::kNoIndex;
+    }
+
+    template <typename Cost>
+    uint32_t SearchRoutesBidirectionalWith(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const Cost& costs,
+        RoutingWorkspace& forward,
+        RoutingWorkspace& backward) {
+        forward.Reset(graph.GetStateCount());
+        forward.Reach(source, 0, 0, source);
+        forward.Push(0, source);
+        backward.Reset(graph.GetStateCount());
+        for (auto state = graph.stationStateOffsets_[target];
+                state < graph.stationStateOffsets_[target + 1];
+                ++state) {
+            backward.Reach(state, 0, 0, state);
+            backward.Push(0, state);
+        }
+
+        // Best journey found so far, through `meetingState`.
+        unsigned int bestMetric = kInfiniteMetric;
+        uint32_t meetingState = CompactGraph::kNoIndex;
+        auto meet = [&](uint32_t state) {
+            if (forward.IsReached(state) && backward.IsReached(state)) {
+                const auto metric = forward.metric_[state] + backward.metric_[state];
+                if (metric < bestMetric) {
+                    bestMetric = metric;
+                    meetingState = state;
+                }
+            }
+        };
+
+        // Any journey cheaper than the best one so far would have to go
+        // through states that are still queued on both sides.
+        while (!forward.queue_.empty() && !backward.queue_.empty()) {
+            const auto forwardMin = PeekMetric(forward);
+            const auto backwardMin = PeekMetric(backward);
+            if (bestMetric != kInfiniteMetric && forwardMin + backwardMin >= bestMetric) {
+                break;
+            }
+            uint32_t state;
+            if (forwardMin <= backwardMin) {
+                if (PopCurrent(graph, forward, state)) {
+                    meet(state);
+                    ScanForward(graph, costs, forward, state, NoHeuristic {}, meet);
+                }
+            } else {
+                if (PopCurrent(graph, backward, state)) {
+                    meet(state);
+                    ScanBackward(graph, costs, backward, source, state, meet);
+                }
+            }
+        }
+        return meetingState;
+    }
+
+    template <typename Cost>
+    uint32_t SearchRoutesParetoWith(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const Cost& costs,
+        double maxDistance,
+        unsigned int maxMetric,
+        const LandmarkTable* landmarks,
+        RoutingWorkspace& workspace) {
+        using Label = RoutingWorkspace::Label;
+        using LabelEntry = RoutingWorkspace::LabelEntry;
+        workspace.Reset(graph.GetStateCount());
+        auto& labels = workspace.labels_;
+        auto& queue = workspace.labelQueue_;
+        const auto later = [](const LabelEntry& lhs, const LabelEntry& rhs) {
+            return lhs.metric != rhs.metric
+                ? lhs.metric > rhs.metric
+                : lhs.estimate > rhs.estimate;
+        };
+        // Labels are settled by metric, so a label is dominated by any settled
+        // label on its state that is at least as fast. For each state,
+        // distance_ holds the fastest settled label and parent_ the fastest
+        // queued one, which also dominates the labels it is better than: it,
+        // or whatever ends up dominating it, is settled first.
+        const auto isDominated = [&workspace, &labels](
+            uint32_t state,
+            unsigned int distance,
+            unsigned int metric) {
+            if (!workspace.IsReached(state)) {
+                return false;
+            }
+            const auto& queued = labels[workspace.parent_[state]];
+            return workspace.distance_[state] <= distance
+                || (queued.distance <= distance && queued.metric <= metric);
+        };
+        const auto enqueue = [&](const Label& label) {
+            const auto labelIdx = static_cast<uint32_t>(labels.size());
+            labels.push_back(label);
+            queue.push_back({label.estimate, label.metric, labelIdx});
+            std::push_heap(queue.begin(), queue.end(), later);
+            if (!workspace.IsReached(label.state)) {
+                workspace.Reach(label.state, 0, kInfiniteMetric, labelIdx);
+            } else if (label.distance < labels[workspace.parent_[label.state]].distance) {
+                workspace.parent_[label.state] = labelIdx;
+            }
+        };
+        const auto getEstimate = [&graph, landmarks, target](uint32_t state, unsigned int distance) {
+            return landmarks == nullptr
+                ? distance
+                : distance + landmarks->GetLowerBound(graph.stateStations_[state], target);
+        };
+
+        enqueue({0, 0, getEstimate(source, 0), source, CompactGraph::kNoIndex});
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), later);
+            const auto labelIdx = queue.back().label;
+            queue.pop_back();
+            const Label label = labels[labelIdx];
+            if (workspace.distance_[label.state] <= label.distance) {
+                continue;
+            }
+            workspace.distance_[label.state] = label.distance;
+            ++workspace.settledStates_;
+            const auto station = graph.stateStations_[label.state];
+            if (station == target) {
+                return labelIdx;
+            }
+            const auto route = graph.stateRoutes_[label.state];
+            const bool closed = graph.IsClosed(station);
+            for (auto edge = graph.edgeOffsets_[station]; edge < graph.edgeOffsets_[station + 1]; ++edge) {
+                for (auto slot = graph.edgeRouteOffsets_[edge]; slot < graph.edgeRouteOffsets_[edge + 1]; ++slot) {
+                    if (closed && graph.edgeRoutes_[slot] != route) {
+                        continue;
+                    }
+                    const auto nextState = graph.edgeRouteStates_[slot];
+                    const auto cost = costs(graph, route, graph.edgeRoutes_[slot], edge);
+                    const auto nextMetric = label.metric + cost.metric;
+                    const auto nextDistance = label.distance + cost.distance;
+                    if (nextMetric >= maxMetric
+                        || isDominated(nextState, nextDistance, nextMetric)) {
+                        continue;
+                    }
+                    const auto estimate = getEstimate(nextState, nextDistance);
+                    if (static_cast<double>(estimate) >= maxDistance) {
+                        continue;
+                    }
+                    enqueue({nextDistance, nextMetric, estimate, nextState, labelIdx});
+                }
+            }
+        }
+        return CompactGraph::kNoIndex;
+    }
+
+    template <typename Cost>
+    unsigned int GetPathMetricWith(
+        const CompactGraph& graph,
+        const Cost& costs,
+        const std::vector<uint32_t>& states) {
+        unsigned int metric {0};
+        for (size_t idx = 1; idx < states.size(); ++idx) {
+            const auto edge = graph.FindEdge(
+                graph.stateStations_[states[idx - 1]],
+                graph.stateStations_[states[idx]]);
+            metric += costs(
+                graph,
+                graph.stateRoutes_[states[idx - 1]],
+                graph.stateRoutes_[states[idx]],
+                edge).metric;
+        }
+        return metric;
+    }
+}
+
+namespace NetworkMonitor {
+    void RoutingWorkspace::Reset(size_t nStates) {
+        if (generation_.size() < nStates) {
+            generation_.resize(nStates, 0);
+            metric_.resize(nStates);
+            distance_.resize(nStates);
+            parent_.resize(nStates);
+        }
+        queue_.clear();
+        labels_.clear();
+        labelQueue_.clear();
+        settledStates_ = 0;
+        if (++currentGeneration_ == 0) {
+            // The counter wrapped around: stale generations could match again.
+            std::fill(generation_.begin(), generation_.end(), 0);
+            currentGeneration_ = 1;
+        }
+    }
+
+    void RoutingWorkspace::Push(unsigned int metric, uint32_t state) {
+        queue_.push_back({metric, state});
+        std::push_heap(queue_.begin(), queue_.end(), std::greater<QueueEntry>());
+    }
+
+    RoutingWorkspace::QueueEntry RoutingWorkspace::Pop() {
+        std::pop_heap(queue_.begin(), queue_.end(), std::greater<QueueEntry>());
+        auto entry = queue_.back();
+        queue_.pop_back();
+        return entry;
+    }
+
+    uint32_t SearchRoutes(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        RoutingWorkspace& workspace,
+        unsigned int maxMetric) {
+        return VisitCost(costs, [&](const auto& cost) {
+            return SearchRoutesWith(graph, source, target, cost, workspace, maxMetric);
+        });
+    }
+
+    uint32_t SearchRoutesAStar(
+        const CompactGraph& graph,
+        const LandmarkTable& landmarks,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        RoutingWorkspace& workspace) {
+        return VisitCost(costs, [&](const auto& cost) {
+            return SearchRoutesAStarWith(graph, landmarks, source, target, cost, workspace);
+        });
+    }
+
+    uint32_t SearchRoutesBidirectional(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        RoutingWorkspace& forward,
+        RoutingWorkspace& backward) {
+        return VisitCost(costs, [&](const auto& cost) {
+            return SearchRoutesBidirectionalWith(graph, source, target, cost, forward, backward);
+        });
+    }
+
+    uint32_t FindBestState(
+        const CompactGraph& graph,
+        const RoutingWorkspace& workspace,
+        IdHandle station) {
+        uint32_t best = CompactGraph::kNoIndex;
+        for (auto state = graph.stationStateOffsets_[station];
+                state < graph.stationStateOffsets_[station + 1];
+                ++state) {
+            if (workspace.IsReached(state)
+                && (best == CompactGraph::kNoIndex
+                    || workspace.metric_[state] < workspace.metric_[best])) {
+                best = state;
+            }
+        }
+        return best;
+    }
+
+    uint32_t SearchRoutesPareto(
+        const CompactGraph& graph,
+        IdHandle source,
+        IdHandle target,
+        const RouteCostModel& costs,
+        double maxDistance,
+        unsigned int maxMetric,
+        const LandmarkTable* landmarks,
+        RoutingWorkspace& workspace) {
+        return VisitCost(costs, [&](const auto& cost) {
+            return SearchRoutesParetoWith(
+                graph, source, target, cost, maxDistance, maxMetric, landmarks, workspace);
+        });
+    }
+
+    unsigned int GetPathMetric(
+        const CompactGraph& graph,
+        const RouteCostModel& costs,
+        const std::vector<uint32_t>& states) {
+        return VisitCost(costs, [&](const auto& cost) {
+            return GetPathMetricWith(graph, cost, states);
+        });
+    }
+
+    void GetStationDistances(
+        const CompactGraph& graph,
+        const RoutingWorkspace& workspace,
+        unsigned int maxMetric,
+        std::vector<unsigned int>& distances) {
+        distances.assign(graph.GetStationCount(), kInfiniteMetric);
+        for (uint32_t state = 0; state < graph.GetStateCount(); ++state) {
+            if (!workspace.IsReached(state) || workspace.metric_[state] > maxMetric) {
+                continue;
+            }
+            auto& distance = distances[graph.stateStations_[state]];
+            distance = std::min(distance, workspace.distance_[state]);
+        }
+    }
+
+    void ExtractLabelPath(
+        const RoutingWorkspace& workspace,
+        uint32_t label,
+        std::vector<uint32_t>& states,
+        std::vector<unsigned int>& distances) {
+        states.clear();
+        distances.clear();
+        for (; label != CompactGraph::kNoIndex; label = workspace.labels_[label].parent) {
+            states.push_back(workspace.labels_[label].state);
+            distances.push_back(workspace.labels_[label].distance);
+        }
+        std::reverse(states.begin(), states.end());
+        std::reverse(distances.begin(), distances.end());
+    }
+
+    void ExtractPath(
+        const RoutingWorkspace& forward,
+        const RoutingWorkspace* backward,
+        uint32_t lastState,
+        std::vector<uint32_t>& states,
+        std::vector<unsigned int>& distances) {
+        states.clear();
+        distances.clear();
+        for (auto state = lastState; ; state = forward.parent_[state]) {
+            states.push_back(state);
+            distances.push_back(forward.distance_[state]);
+            if (forward.parent_[state] == state) {
+                break;
+            }
+        }
+        std::reverse(states.begin(), states.end());
+        std::reverse(distances.begin(), distances.end());
+        if (backward == nullptr) {
+            return;
+        }
+        const auto meetingDistance = forward.distance_[lastState] + backward->distance_[lastState];
+        for (auto state = lastState; backward->parent_[state] != state; ) {
+            state = backward->parent_[state];
+            states.push_back(state);
+            distances.push_back(meetingDistance - backward->distance_[state]);
+        }
+    }
+}
@@ -0,0 +1,276 @@
+#include "network-monitor-internal/timetable.h"
+
+#include <algorithm>
+
+namespace {
+    using NetworkMonitor::CompactGraph;
+    using NetworkMonitor::IdHandle;
+    using NetworkMonitor::Timetable;
+    using NetworkMonitor::TimetableWorkspace;
+    using NetworkMonitor::kInvalidIdHandle;
+
+    constexpr unsigned int kNoTrip = Timetable::kNoTrip;
+
+    bool IsReached(const TimetableWorkspace& workspace, IdHandle station) {
+        return workspace.stationGenerations_[station] == workspace.currentGeneration_;
+    }
+
+    unsigned int GetBestArrival(const TimetableWorkspace& workspace, IdHandle station) {
+        return IsReached(workspace, station) ? workspace.bestArrivals_[station] : kNoTrip;
+    }
+
+    /*! \brief Check whether an earlier arrival at `station` leaves as early
+     *         as one on `line` at `arrival` for any route.
+     */
+    bool IsBeaten(
+            const TimetableWorkspace& workspace,
+            IdHandle station,
+            IdHandle line,
+            unsigned int arrival,
+            unsigned int changeTime) {
+        if (!IsReached(workspace, station)) {
+            return false;
+        }
+        const uint64_t best {workspace.bestArrivals_[station]};
+        if (workspace.bestLines_[station] == line) {
+            return best <= arrival;
+        }
+        return best + changeTime <= arrival
+            || (workspace.otherLines_[station] == line
+                && workspace.otherArrivals_[station] <= arrival);
+    }
+
+    /*! \brief Record an arrival at `station` on `line` that IsBeaten let
+     *         through.
+     */
+    void Note(
+            TimetableWorkspace& workspace,
+            IdHandle station,
+            IdHandle line,
+            unsigned int arrival) {
+        if (!IsReached(workspace, station)) {
+            workspace.stationGenerations_[station] = workspace.currentGeneration_;
+            workspace.bestArrivals_[station] = arrival;
+            workspace.bestLines_[station] = line;
+            workspace.otherArrivals_[station] = kNoTrip;
+            workspace.otherLines_[station] = kInvalidIdHandle;
+        } else if (arrival < workspace.bestArrivals_[station]) {
+            if (workspace.bestLines_[station] != line) {
+                workspace.otherArrivals_[station] = workspace.bestArrivals_[station];
+                workspace.otherLines_[station] = workspace.bestLines_[station];
+            }
+            workspace.bestArrivals_[station] = arrival;
+            workspace.bestLines_[station] = line;
+        } else if (arrival < workspace.otherArrivals_[station]) {
+            workspace.otherArrivals_[station] = arrival;
+            workspace.otherLines_[station] = line;
+        }
+        if (!workspace.isMarked_[station]) {
+            workspace.isMarked_[station] = true;
+            workspace.markedStations_.push_back(station);
+        }
+    }
+}
+
+namespace NetworkMonitor {
+    Timetable Timetable::Build(
+            size_t nRoutes,
+            const std::unordered_map<IdHandle, RouteTimetable>& timetables) {
+        Timetable timetable;
+        timetable.headways_.assign(nRoutes, 0);
+        timetable.firstDepartures_.assign(nRoutes, 0);
+        timetable.lastDepartures_.assign(nRoutes, kNoTrip);
+        timetable.departureOffsets_.reserve(nRoutes + 1);
+        timetable.departureOffsets_.push_back(0);
+        for (IdHandle route = 0; route < nRoutes; ++route) {
+            const auto it = timetables.find(route);
+            if (it != timetables.end()) {
+                timetable.headways_[route] = it->second.headway;
+                timetable.firstDepartures_[route] = it->second.firstDeparture;
+                timetable.lastDepartures_[route] = it->second.lastDeparture;
+                auto& departures = timetable.departures_;
+                const auto first = departures.size();
+                departures.insert(
+                    departures.end(),
+                    it->second.departures.begin(),
+                    it->second.departures.end());
+                std::sort(departures.begin() + first, departures.end());
+            }
+            timetable.departureOffsets_.push_back(
+                static_cast<uint32_t>(timetable.departures_.size()));
+        }
+        return timetable;
+    }
+
+    unsigned int Timetable::GetNextDeparture(IdHandle route, unsigned int time) const {
+        const auto first = departures_.begin() + departureOffsets_[route];
+        const auto last = departures_.begin() + departureOffsets_[route + 1];
+        if (first != last) {
+            const auto it = std::lower_bound(first, last, time);
+            return it == last ? kNoTrip : *it;
+        }
+        const uint64_t firstDeparture {firstDepartures_[route]};
+        const uint64_t headway {headways_[route]};
+        uint64_t departure {std::max<uint64_t>(time, firstDeparture)};
+        if (headway > 0) {
+            // Round up to the next trip.
+            departure = firstDeparture
+                + (departure - firstDeparture + headway - 1) / headway * headway;
+        }
+        return departure > lastDepartures_[route] ? kNoTrip : static_cast<unsigned int>(departure);
+    }
+
+    void TimetableWorkspace::Reset(
+            size_t nStations,
+            size_t nRouteStops,
+            size_t nRoutes,
+            size_t nRounds) {
+        const auto nLabels = nRouteStops * (nRounds + 1);
+        if (labels_.size() < nLabels) {
+            labels_.resize(nLabels, Label {});
+        }
+        if (stationGenerations_.size() < nStations) {
+            stationGenerations_.resize(nStations, 0);
+            bestArrivals_.resize(nStations);
+            bestLines_.resize(nStations);
+            otherArrivals_.resize(nStations);
+            otherLines_.resize(nStations);
+            isMarked_.resize(nStations, false);
+        }
+        if (queuedPositions_.size() < nRoutes) {
+            queuedPositions_.resize(nRoutes, CompactGraph::kNoIndex);
+        }
+        nRouteStops_ = nRouteStops;
+        markedStations_.clear();
+        queuedRoutes_.clear();
+        scannedStops_ = 0;
+        if (++currentGeneration_ == 0) {
+            // The counter wrapped around: stale generations could match again.
+            std::fill(stationGenerations_.begin(), stationGenerations_.end(), 0);
+            for (auto& label : labels_) {
+                label.generation = 0;
+            }
+            currentGeneration_ = 1;
+        }
+    }
+
+    uint32_t SearchEarliestArrival(
+            const CompactGraph& graph,
+            const Timetable& timetable,
+            IdHandle source,
+            IdHandle target,
+            unsigned int departureTime,
+            unsigned int changeTime,
+            size_t nRounds,
+            TimetableWorkspace& workspace) {
+        const auto nRouteStops = graph.routeStops_.size();
+        workspace.Reset(graph.GetStationCount(), nRouteStops, graph.routeLines_.size(), nRounds);
+        workspace.isMarked_[source] = true;
+        workspace.markedStations_.push_back(source);
+        uint32_t targetLabel {CompactGraph::kNoIndex};
+
+        for (uint32_t round = 1; round <= nRounds && !workspace.markedStations_.empty(); ++round) {
+            // Scan each route serving a station labelled in the last round,
+            // from the first such station along it.
+            for (const auto station : workspace.markedStations_) {
+                workspace.isMarked_[station] = false;
+                for (auto idx = graph.stationStopOffsets_[station];
+                        idx < graph.stationStopEnds_[station];
+                        ++idx) {
+                    const auto route = graph.stationStopRoutes_[idx];
+                    auto& position = workspace.queuedPositions_[route];
+                    if (position == CompactGraph::kNoIndex) {
+                        workspace.queuedRoutes_.push_back(route);
+                    }
+                    position = std::min(position, graph.stationStopPositions_[idx]);
+                }
+            }
+            workspace.markedStations_.clear();
+
+            const auto previousLabels = static_cast<uint32_t>((round - 1) * nRouteStops);
+            const auto labels = static_cast<uint32_t>(round * nRouteStops);
+            for (const auto route : workspace.queuedRoutes_) {
+                const auto line = graph.routeLines_[route];
+                const auto firstStop = graph.routeStopOffsets_[route];
+                const auto nStops = graph.routeStopEnds_[route] - firstStop;
+                auto tripDeparture = kNoTrip;
+                uint32_t boardPosition {0};
+                uint32_t boardLabel {CompactGraph::kNoIndex};
+                for (auto position = workspace.queuedPositions_[route]; position < nStops; ++position) {
+                    ++workspace.scannedStops_;
+                    const auto stop = firstStop + position;
+                    const auto station = graph.routeStops_[stop];
+                    const auto offset = graph.routeStopTimes_[stop];
+                    if (graph.IsClosed(station)) {
+                        continue;
+                    }
+                    if (tripDeparture != kNoTrip && station != source) {
+                        const auto arrival = tripDeparture + offset;
+                        if (arrival < GetBestArrival(workspace, target)
+                            && !IsBeaten(workspace, station, line, arrival, changeTime)) {
+                            Note(workspace, station, line, arrival);
+                            workspace.labels_[labels + stop] = {
+                                arrival,
+                                route,
+                                tripDeparture,
+                                boardPosition,
+                                position,
+                                boardLabel,
+                                workspace.currentGeneration_,
+                            };
+                            if (station == target) {
+                                targetLabel = labels + stop;
+                            }
+                        }
+                    }
+
+                    // Catch an earlier trip here, from the origin or from an
+                    // arrival of the last round.
+                    auto ready = kNoTrip;
+                    auto readyLabel = CompactGraph::kNoIndex;
+                    if (station == source) {
+                        ready = round == 1 ? departureTime : kNoTrip;
+                    } else if (round > 1 && IsReached(workspace, station)) {
+                        for (auto idx = graph.stationStopOffsets_[station];
+                                idx < graph.stationStopEnds_[station];
+                                ++idx) {
+                            const auto fromRoute = graph.stationStopRoutes_[idx];
+                            const auto from = previousLabels
+                                + graph.routeStopOffsets_[fromRoute]
+                                + graph.stationStopPositions_[idx];
+                            const auto& label = workspace.labels_[from];
+                            if (label.generation != workspace.currentGeneration_) {
+                                continue;
+                            }
+                            const auto time = label.arrival
+                                + (graph.routeLines_[fromRoute] == line ? 0 : changeTime);
+                            if (time < ready) {
+                                ready = time;
+                                readyLabel = from;
+                            }
+                        }
+                    }
+                    if (ready == kNoTrip
+                        || (tripDeparture != kNoTrip && ready >= tripDeparture + offset)) {
+                        continue;
+                    }
+                    const auto departure = timetable.GetNextDeparture(
+                        route, ready > offset ? ready - offset : 0);
+                    if (departure < tripDeparture) {
+                        tripDeparture = departure;
+                        boardPosition = position;
+                        boardLabel = readyLabel;
+                    }
+                }
+            }
+            for (const auto route : workspace.queuedRoutes_) {
+                workspace.queuedPositions_[route] = CompactGraph::kNoIndex;
+            }
+            workspace.queuedRoutes_.clear();
+        }
+        for (const auto station : workspace.markedStations_) {
+            workspace.isMarked_[station] = false;
+        }
+        return targetLabel;
+    }
+}
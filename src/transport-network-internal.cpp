@@ -1,105 +1,637 @@
 #include "network-monitor-internal/transport-network-internal.h"
 
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace {
+    using NetworkMonitor::CompactGraph;
+    using NetworkMonitor::IdHandle;
+
+    /*! \brief Scratch space to follow the edges of routes into their stops.
+     */
+    struct RouteWalk {
+        /*! \brief Write the stops of `route` from `stops`, and the position
+         *         along the route of each state it reaches to
+         *         `stateStopPositions`.
+         *
+         *  \returns The number of stops.
+         */
+        uint32_t Follow(
+            const CompactGraph& graph,
+            IdHandle route,
+            IdHandle* stops,
+            uint32_t* stateStopPositions) {
+            const auto* first = graph.routeEdges_.begin() + graph.routeEdgeOffsets_[route];
+            const auto* last = graph.routeEdges_.begin() + graph.routeEdgeEnds_[route];
+            if (first == last) {
+                return 0;
+            }
+            targets_.clear();
+            for (auto it = first; it != last; ++it) {
+                targets_.push_back(graph.edgeTargets_[*it]);
+            }
+            std::sort(targets_.begin(), targets_.end());
+            const auto origin = std::find_if(first, last, [&](uint32_t edge) {
+                return !std::binary_search(targets_.begin(), targets_.end(), graph.edgeSources_[edge]);
+            });
+            auto station = graph.edgeSources_[origin == last ? *first : *origin];
+            followed_.assign(last - first, false);
+            uint32_t nStops {0};
+            stops[nStops++] = station;
+            while (true) {
+                // The first edge of the route out of the station, as in the
+                // target order of the station's edges.
+                const auto next = std::lower_bound(first, last, station,
+                    [&graph](uint32_t edge, IdHandle source) {
+                        return graph.edgeSources_[edge] < source;
+                    });
+                if (next == last
+                    || graph.edgeSources_[*next] != station
+                    || followed_[next - first]) {
+                    break;
+                }
+                followed_[next - first] = true;
+                station = graph.edgeTargets_[*next];
+                const auto state = graph.FindState(station, route);
+                if (stateStopPositions[state] == CompactGraph::kNoIndex) {
+                    stateStopPositions[state] = nStops;
+                }
+                stops[nStops++] = station;
+            }
+            return nStops;
+        }
+
+        std::vector<IdHandle> targets_ {};
+        std::vector<bool> followed_ {};
+    };
+}
+
 namespace NetworkMonitor {
-    bool RouteEdge::AddRoute(const Id& routeId, const Id& lineId) {
-        if (HasRoute(lineId, routeId)) {
+    bool RouteEdge::AddRoute(IdHandle routeId) {
+        if (HasRoute(routeId)) {
             return false;
         }
-        auto routeIdsIt = lineToRouteIds_.find(lineId);
-        if (routeIdsIt == lineToRouteIds_.end()) {
-            lineToRouteIds_[lineId] = {routeId};
-            return true;
+        routeIds_.push_back(routeId);
+        return true;
+    }
+
+    bool RouteEdge::HasRoute(IdHandle routeId) const {
+        return std::find(routeIds_.begin(), routeIds_.end(), routeId) != routeIds_.end();
+    }
+
+    bool RouteEdge::RemoveRoute(IdHandle routeId) {
+        const auto it = std::find(routeIds_.begin(), routeIds_.end(), routeId);
+        if (it == routeIds_.end()) {
+            return false;
         }
-        routeIdsIt->second.emplace_back(routeId);
+        routeIds_.erase(it);
         return true;
     }
 
-    std::vector<RouteMetadata> RouteEdge::GetRouteMetadata() const {
-        std::vector<RouteMetadata> routeMetadatas;
-        for (auto& [lineId, routeIds] : lineToRouteIds_) {
-            for (auto& routeId : routeIds) {
-                routeMetadatas.emplace_back(
-                    lineId,
-                    routeId,
-                    travelTime_
-                );
-            }
+    uint32_t StationNode::GetOrMakeEdge(IdHandle endStationId, std::vector<RouteEdge>& edges) {
+        auto [stationIdEdgeIt, inserted] = toStationIdToEdge_.try_emplace(
+            endStationId,
+            static_cast<uint32_t>(edges.size()));
+        if (inserted) {
+            edges.push_back(RouteEdge {0u, {}});
         }
-        return routeMetadatas;
+        return stationIdEdgeIt->second;
     }
 
-    bool RouteEdge::HasRoute(const Id& lineId, const Id& routeId) const {
-        auto routes = GetRoutes(lineId);
-        return std::find(routes.begin(), routes.end(), routeId) != routes.end();
+    uint32_t StationNode::GetEdge(IdHandle stationId) const {
+        auto stationIdEdgeIt = toStationIdToEdge_.find(stationId);
+        if (stationIdEdgeIt == toStationIdToEdge_.end()) {
+            return CompactGraph::kNoIndex;
+        }
+        return stationIdEdgeIt->second;
     }
 
-    std::vector<Id> RouteEdge::GetRoutes(const Id& lineId) const {
-        const auto& routeIdsIt = lineToRouteIds_.find(lineId);
-        if (routeIdsIt == lineToRouteIds_.end()) {
-            return {};
+    CompactGraph CompactGraph::Build(
+        const std::vector<StationNode>& nodes,
+        const std::vector<RouteEdge>& edges,
+        const std::vector<IdHandle>& routeLines) {
+        CompactGraph graph;
+        graph.routeLines_ = routeLines;
+
+        const auto nStations = nodes.size();
+        std::vector<uint32_t> edgeOffsets;
+        std::vector<IdHandle> edgeTargets;
+        std::vector<unsigned int> edgeTravelTimes;
+        std::vector<uint32_t> edgeRouteOffsets;
+        std::vector<IdHandle> edgeRoutes;
+        edgeOffsets.reserve(nStations + 1);
+        edgeOffsets.push_back(0);
+        edgeTargets.reserve(edges.size());
+        edgeTravelTimes.reserve(edges.size());
+        edgeRouteOffsets.reserve(edges.size() + 1);
+        edgeRouteOffsets.push_back(0);
+        std::vector<std::pair<IdHandle, uint32_t>> outEdges;
+        for (IdHandle from = 0; from < nStations; ++from) {
+            outEdges.assign(
+                nodes[from].toStationIdToEdge_.begin(),
+                nodes[from].toStationIdToEdge_.end());
+            std::sort(outEdges.begin(), outEdges.end());
+            for (const auto& [to, edgeIdx] : outEdges) {
+                const auto& edge = edges[edgeIdx];
+                edgeTargets.push_back(to);
+                edgeTravelTimes.push_back(edge.travelTime_);
+                edgeRoutes.insert(
+                    edgeRoutes.end(),
+                    edge.routeIds_.begin(),
+                    edge.routeIds_.end());
+                std::sort(
+                    edgeRoutes.end() - edge.routeIds_.size(),
+                    edgeRoutes.end());
+                edgeRouteOffsets.push_back(static_cast<uint32_t>(edgeRoutes.size()));
+            }
+            edgeOffsets.push_back(static_cast<uint32_t>(edgeTargets.size()));
         }
-        return routeIdsIt->second;
+        graph.edgeOffsets_ = std::move(edgeOffsets);
+        graph.edgeTargets_ = std::move(edgeTargets);
+        graph.edgeTravelTimes_ = std::move(edgeTravelTimes);
+        graph.edgeRouteOffsets_ = std::move(edgeRouteOffsets);
+        graph.edgeRoutes_ = std::move(edgeRoutes);
+        graph.BuildIndices();
+        return graph;
     }
 
-    std::vector<Id> RouteEdge::GetRoutes() const {
-            std::vector<Id> routes;
-        for (const auto& [_, routeIds] : lineToRouteIds_) {
-            routes.insert(routes.end(), routeIds.begin(), routeIds.end());
+    void CompactGraph::BuildIndices() {
+        const auto nStations = GetStationCount();
+        std::vector<IdHandle> edgeSources(edgeTargets_.size());
+        for (IdHandle from = 0; from < nStations; ++from) {
+            std::fill(
+                edgeSources.begin() + edgeOffsets_[from],
+                edgeSources.begin() + edgeOffsets_[from + 1],
+                from);
         }
-        return routes;
+        edgeSources_ = std::move(edgeSources);
+
+        // Reverse adjacency: bucket the edge indices by target station.
+        std::vector<uint32_t> inEdgeOffsets(nStations + 1, 0);
+        for (const auto to : edgeTargets_) {
+            ++inEdgeOffsets[to + 1];
+        }
+        for (size_t idx = 1; idx <= nStations; ++idx) {
+            inEdgeOffsets[idx] += inEdgeOffsets[idx - 1];
+        }
+        std::vector<uint32_t> inEdges(edgeTargets_.size());
+        auto cursor = inEdgeOffsets;
+        for (uint32_t edge = 0; edge < edgeTargets_.size(); ++edge) {
+            inEdges[cursor[edgeTargets_[edge]]++] = edge;
+        }
+        inEdgeOffsets_ = std::move(inEdgeOffsets);
+        inEdges_ = std::move(inEdges);
+
+        // Route states: one per station for journey origins, then one per
+        // (station, arriving route) pair.
+        std::vector<IdHandle> stateStations(nStations);
+        std::vector<IdHandle> stateRoutes(nStations, kInvalidIdHandle);
+        for (IdHandle station = 0; station < nStations; ++station) {
+            stateStations[station] = station;
+        }
+        std::vector<uint32_t> stationStateOffsets;
+        stationStateOffsets.reserve(nStations + 1);
+        std::vector<uint32_t> edgeRouteStates(edgeRoutes_.size());
+        std::vector<IdHandle> arrivingRoutes;
+        for (IdHandle station = 0; station < nStations; ++station) {
+            const auto firstState = static_cast<uint32_t>(stateRoutes.size());
+            stationStateOffsets.push_back(firstState);
+            arrivingRoutes.clear();
+            for (auto idx = inEdgeOffsets_[station]; idx < inEdgeOffsets_[station + 1]; ++idx) {
+                const auto edge = inEdges_[idx];
+                arrivingRoutes.insert(
+                    arrivingRoutes.end(),
+                    edgeRoutes_.begin() + edgeRouteOffsets_[edge],
+                    edgeRoutes_.begin() + edgeRouteOffsets_[edge + 1]);
+            }
+            std::sort(arrivingRoutes.begin(), arrivingRoutes.end());
+            arrivingRoutes.erase(
+                std::unique(arrivingRoutes.begin(), arrivingRoutes.end()),
+                arrivingRoutes.end());
+            for (const auto route : arrivingRoutes) {
+                stateStations.push_back(station);
+                stateRoutes.push_back(route);
+            }
+            for (auto idx = inEdgeOffsets_[station]; idx < inEdgeOffsets_[station + 1]; ++idx) {
+                const auto edge = inEdges_[idx];
+                for (auto slot = edgeRouteOffsets_[edge]; slot < edgeRouteOffsets_[edge + 1]; ++slot) {
+                    const auto it = std::lower_bound(
+                        arrivingRoutes.begin(),
+                        arrivingRoutes.end(),
+                        edgeRoutes_[slot]);
+                    edgeRouteStates[slot] = firstState
+                        + static_cast<uint32_t>(it - arrivingRoutes.begin());
+                }
+            }
+        }
+        stationStateOffsets.push_back(static_cast<uint32_t>(stateRoutes.size()));
+        stationStateOffsets_ = std::move(stationStateOffsets);
+        stateStations_ = std::move(stateStations);
+        stateRoutes_ = std::move(stateRoutes);
+        edgeRouteStates_ = std::move(edgeRouteStates);
+        BuildRouteStops();
     }
 
-    std::shared_ptr<RouteEdge> StationNode::GetOrMakeEdge(const Id& endStationId) {
-        auto stationIdEdgeIt = toStationIdToEdge_.find(endStationId);
-        if (stationIdEdgeIt != toStationIdToEdge_.end()) {
-            return stationIdEdgeIt->second;
+    void CompactGraph::BuildRouteStops() {
+        const auto nRoutes = routeLines_.size();
+        const auto nStations = GetStationCount();
+
+        // Bucket the edges by route. Each bucket ends up sorted by source
+        // station, then target station.
+        std::vector<uint32_t> routeEdgeOffsets(nRoutes + 1, 0);
+        for (const auto route : edgeRoutes_) {
+            ++routeEdgeOffsets[route + 1];
+        }
+        for (size_t idx = 1; idx <= nRoutes; ++idx) {
+            routeEdgeOffsets[idx] += routeEdgeOffsets[idx - 1];
+        }
+        std::vector<uint32_t> routeEdges(edgeRoutes_.size());
+        auto cursor = routeEdgeOffsets;
+        for (uint32_t edge = 0; edge < edgeTargets_.size(); ++edge) {
+            for (auto slot = edgeRouteOffsets_[edge]; slot < edgeRouteOffsets_[edge + 1]; ++slot) {
+                routeEdges[cursor[edgeRoutes_[slot]]++] = edge;
+            }
+        }
+        routeEdgeEnds_ = std::vector<uint32_t>(routeEdgeOffsets.begin() + 1, routeEdgeOffsets.end());
+        routeEdgeOffsets_ = std::move(routeEdgeOffsets);
+        routeEdges_ = std::move(routeEdges);
+
+        // A route has room for one more stop than it has edges, all it can
+        // need if it is taken off some of them and put back on.
+        std::vector<uint32_t> routeStopOffsets(nRoutes + 1, 0);
+        for (IdHandle route = 0; route < nRoutes; ++route) {
+            const auto nEdges = routeEdgeEnds_[route] - routeEdgeOffsets_[route];
+            routeStopOffsets[route + 1] = routeStopOffsets[route] + (nEdges == 0 ? 0 : nEdges + 1);
+        }
+        std::vector<uint32_t> routeStopEnds(nRoutes);
+        std::vector<IdHandle> routeStops(routeStopOffsets.back(), 0);
+        std::vector<uint32_t> stateStopPositions(stateRoutes_.size(), kNoIndex);
+        RouteWalk walk;
+        for (IdHandle route = 0; route < nRoutes; ++route) {
+            routeStopEnds[route] = routeStopOffsets[route] + walk.Follow(
+                *this,
+                route,
+                routeStops.data() + routeStopOffsets[route],
+                stateStopPositions.data());
+        }
+        routeStopOffsets_ = std::move(routeStopOffsets);
+        routeStopEnds_ = std::move(routeStopEnds);
+        routeStops_ = std::move(routeStops);
+        stateStopPositions_ = std::move(stateStopPositions);
+        std::vector<unsigned int> routeStopTimes(routeStops_.size(), 0);
+        for (IdHandle route = 0; route < nRoutes; ++route) {
+            ComputeRouteTimes(route, routeStopTimes.data());
+        }
+        routeStopTimes_ = std::move(routeStopTimes);
+
+        // Bucket the stops by station, in route order.
+        std::vector<uint32_t> stationStopOffsets(nStations + 1, 0);
+        for (IdHandle route = 0; route < nRoutes; ++route) {
+            for (auto stop = routeStopOffsets_[route]; stop < routeStopEnds_[route]; ++stop) {
+                ++stationStopOffsets[routeStops_[stop] + 1];
+            }
+        }
+        for (size_t idx = 1; idx <= nStations; ++idx) {
+            stationStopOffsets[idx] += stationStopOffsets[idx - 1];
         }
-        auto edge = std::make_shared<RouteEdge>();
-        toStationIdToEdge_[endStationId] = edge;
-        return edge;
+        std::vector<IdHandle> stationStopRoutes(stationStopOffsets.back());
+        std::vector<uint32_t> stationStopPositions(stationStopOffsets.back());
+        std::vector<uint32_t> stationStopEnds(stationStopOffsets.begin(), stationStopOffsets.end() - 1);
+        for (IdHandle route = 0; route < nRoutes; ++route) {
+            for (auto stop = routeStopOffsets_[route]; stop < routeStopEnds_[route]; ++stop) {
+                const auto idx = stationStopEnds[routeStops_[stop]]++;
+                stationStopRoutes[idx] = route;
+                stationStopPositions[idx] = stop - routeStopOffsets_[route];
+            }
+        }
+        stationStopOffsets_ = std::move(stationStopOffsets);
+        stationStopEnds_ = std::move(stationStopEnds);
+        stationStopRoutes_ = std::move(stationStopRoutes);
+        stationStopPositions_ = std::move(stationStopPositions);
     }
 
-    bool StationNode::AddIncomingEdge(const Id& fromStationId, std::shared_ptr<RouteEdge> edge) {
-        auto stationIdEdgeIt = fromStationIdToEdge_.find(fromStationId);
-        if (stationIdEdgeIt != fromStationIdToEdge_.end() && stationIdEdgeIt->second != edge) {
-            return false;
+    bool CompactGraph::UpdateRouteStops(
+            const std::vector<std::pair<uint32_t, IdHandle>>& removed,
+            const std::vector<std::pair<uint32_t, IdHandle>>& added) {
+        // The (route, edge) pairs, by route.
+        auto byRoute = [](const std::vector<std::pair<uint32_t, IdHandle>>& pairs) {
+            std::vector<std::pair<IdHandle, uint32_t>> routeEdges;
+            routeEdges.reserve(pairs.size());
+            for (const auto& [edge, route] : pairs) {
+                routeEdges.emplace_back(route, edge);
+            }
+            std::sort(routeEdges.begin(), routeEdges.end());
+            return routeEdges;
+        };
+        const auto removedEdges = byRoute(removed);
+        const auto addedEdges = byRoute(added);
+        std::vector<IdHandle> routes;
+        for (const auto& pairs : {&removedEdges, &addedEdges}) {
+            for (const auto& [route, _] : *pairs) {
+                if (routes.empty() || routes.back() != route) {
+                    routes.push_back(route);
+                }
+            }
+        }
+        if (routes.empty()) {
+            return true;
+        }
+        std::sort(routes.begin(), routes.end());
+        routes.erase(std::unique(routes.begin(), routes.end()), routes.end());
+
+        // The new edges of each route, which must fit in its room.
+        std::vector<uint32_t> newEdgeOffsets {0};
+        std::vector<uint32_t> newEdges;
+        std::vector<uint32_t> kept;
+        for (const auto route : routes) {
+            auto edgesOf = [route](const std::vector<std::pair<IdHandle, uint32_t>>& pairs) {
+                const auto first = std::lower_bound(
+                    pairs.begin(), pairs.end(), std::make_pair(route, uint32_t {0}));
+                std::vector<uint32_t> edges;
+                for (auto it = first; it != pairs.end() && it->first == route; ++it) {
+                    edges.push_back(it->second);
+                }
+                return edges;
+            };
+            const auto removedFromRoute = edgesOf(removedEdges);
+            const auto addedToRoute = edgesOf(addedEdges);
+            kept.clear();
+            std::set_difference(
+                routeEdges_.begin() + routeEdgeOffsets_[route],
+                routeEdges_.begin() + routeEdgeEnds_[route],
+                removedFromRoute.begin(),
+                removedFromRoute.end(),
+                std::back_inserter(kept));
+            std::set_union(
+                kept.begin(),
+                kept.end(),
+                addedToRoute.begin(),
+                addedToRoute.end(),
+                std::back_inserter(newEdges));
+            const auto nEdges = newEdges.size() - newEdgeOffsets.back();
+            if (nEdges > routeEdgeOffsets_[route + 1] - routeEdgeOffsets_[route]) {
+                return false;
+            }
+            newEdgeOffsets.push_back(static_cast<uint32_t>(newEdges.size()));
+        }
+
+        auto* routeEdges = routeEdges_.Mutable();
+        auto* routeEdgeEnds = routeEdgeEnds_.Mutable();
+        auto* routeStops = routeStops_.Mutable();
+        auto* routeStopEnds = routeStopEnds_.Mutable();
+        auto* routeStopTimes = routeStopTimes_.Mutable();
+        auto* stateStopPositions = stateStopPositions_.Mutable();
+        auto* stationStopEnds = stationStopEnds_.Mutable();
+        auto* stationStopRoutes = stationStopRoutes_.Mutable();
+        auto* stationStopPositions = stationStopPositions_.Mutable();
+
+        // Take the old stops off the stations first, to make room for the
+        // new ones.
+        for (const auto route : routes) {
+            for (auto stop = routeStopOffsets_[route]; stop < routeStopEnds[route]; ++stop) {
+                const auto station = routeStops[stop];
+                const auto state = FindState(station, route);
+                if (state != kNoIndex) {
+                    stateStopPositions[state] = kNoIndex;
+                }
+                // The stops of the route at the station are next to each
+                // other, and all go at its first stop there.
+                const auto first = stationStopRoutes + stationStopOffsets_[station];
+                const auto last = stationStopRoutes + stationStopEnds[station];
+                const auto [from, to] = std::equal_range(first, last, route);
+                if (from == to) {
+                    continue;
+                }
+                const auto nErased = static_cast<uint32_t>(to - from);
+                std::copy(to, last, from);
+                std::copy(
+                    stationStopPositions + (to - stationStopRoutes),
+                    stationStopPositions + stationStopEnds[station],
+                    stationStopPositions + (from - stationStopRoutes));
+                stationStopEnds[station] -= nErased;
+            }
+            routeStopEnds[route] = routeStopOffsets_[route];
+        }
+
+        RouteWalk walk;
+        for (size_t idx = 0; idx < routes.size(); ++idx) {
+            const auto route = routes[idx];
+            std::copy(
+                newEdges.begin() + newEdgeOffsets[idx],
+                newEdges.begin() + newEdgeOffsets[idx + 1],
+                routeEdges + routeEdgeOffsets_[route]);
+            routeEdgeEnds[route] = routeEdgeOffsets_[route]
+                + (newEdgeOffsets[idx + 1] - newEdgeOffsets[idx]);
+            const auto firstStop = routeStopOffsets_[route];
+            routeStopEnds[route] = firstStop + walk.Follow(
+                *this, route, routeStops + firstStop, stateStopPositions);
+            ComputeRouteTimes(route, routeStopTimes);
+
+            // Stations keep their stops sorted by route, then position.
+            for (auto stop = firstStop; stop < routeStopEnds[route]; ++stop) {
+                const auto station = routeStops[stop];
+                const auto position = stop - firstStop;
+                if (stationStopEnds[station] == stationStopOffsets_[station + 1]) {
+                    return false;
+                }
+                auto slot = stationStopEnds[station]++;
+                while (slot > stationStopOffsets_[station]
+                        && (stationStopRoutes[slot - 1] > route
+                            || (stationStopRoutes[slot - 1] == route
+                                && stationStopPositions[slot - 1] > position))) {
+                    stationStopRoutes[slot] = stationStopRoutes[slot - 1];
+                    stationStopPositions[slot] = stationStopPositions[slot - 1];
+                    --slot;
+                }
+                stationStopRoutes[slot] = route;
+                stationStopPositions[slot] = position;
+            }
         }
-        fromStationIdToEdge_[fromStationId] = edge;
         return true;
     }
 
-    RouteEdge* StationNode::GetEdge(const Id& stationId) {
-        auto stationIdEdgeIt = toStationIdToEdge_.find(stationId);
-        if (stationIdEdgeIt == toStationIdToEdge_.end()) {
-            return nullptr;
+    void CompactGraph::ComputeRouteTimes(IdHandle route, unsigned int* routeStopTimes) const {
+        const auto first = routeStopOffsets_[route];
+        const auto last = routeStopEnds_[route];
+        if (first == last) {
+            return;
+        }
+        routeStopTimes[first] = 0;
+        for (auto idx = first + 1; idx < last; ++idx) {
+            routeStopTimes[idx] = routeStopTimes[idx - 1]
+                + edgeTravelTimes_[FindEdge(routeStops_[idx - 1], routeStops_[idx])];
         }
-        return stationIdEdgeIt->second.get();
     }
 
-    const RouteEdge* StationNode::GetEdge(const Id& stationId) const {
-        return const_cast<StationNode*>(this)->GetEdge(stationId);
+    void CompactGraph::UpdateRouteTimes(const std::vector<uint32_t>& edges) {
+        std::vector<IdHandle> routes;
+        for (const auto edge : edges) {
+            routes.insert(
+                routes.end(),
+                edgeRoutes_.begin() + edgeRouteOffsets_[edge],
+                edgeRoutes_.begin() + edgeRouteOffsets_[edge + 1]);
+        }
+        if (routes.empty()) {
+            return;
+        }
+        std::sort(routes.begin(), routes.end());
+        routes.erase(std::unique(routes.begin(), routes.end()), routes.end());
+        auto* routeStopTimes = routeStopTimes_.Mutable();
+        for (const auto route : routes) {
+            ComputeRouteTimes(route, routeStopTimes);
+        }
+    }
+
+    uint32_t CompactGraph::FindState(IdHandle station, IdHandle route) const {
+        const auto first = stateRoutes_.begin() + stationStateOffsets_[station];
+        const auto last = stateRoutes_.begin() + stationStateOffsets_[station + 1];
+        const auto it = std::lower_bound(first, last, route);
+        if (it == last || *it != route) {
+            return kNoIndex;
+        }
+        return static_cast<uint32_t>(it - stateRoutes_.begin());
     }
 
-    std::vector<Id> StationNode::GetRoutes() const {
-        std::unordered_set<Id> routes;
-        for (const auto& stationIdAndEdge : toStationIdToEdge_) {
-            for (const auto& routeId : stationIdAndEdge.second->GetRoutes()) {
-                routes.emplace(routeId);
+    uint32_t CompactGraph::FindRouteStop(IdHandle route, IdHandle station) const {
+        const auto first = routeStopOffsets_[route];
+        if (first == routeStopEnds_[route]) {
+            return kNoIndex;
+        }
+        if (routeStops_[first] == station) {
+            // No state for the first stop, unless the route loops back to it.
+            return 0;
+        }
+        const auto state = FindState(station, route);
+        return state == kNoIndex ? kNoIndex : stateStopPositions_[state];
+    }
+
+    unsigned int CompactGraph::GetRouteTravelTime(
+            IdHandle route,
+            IdHandle fromStation,
+            IdHandle toStation) const {
+        const auto from = FindRouteStop(route, fromStation);
+        const auto to = FindRouteStop(route, toStation);
+        if (from == kNoIndex || to == kNoIndex || from == to) {
+            return 0;
+        }
+        const auto first = routeStopOffsets_[route];
+        if (from < to) {
+            return routeStopTimes_[first + to] - routeStopTimes_[first + from];
+        }
+        // Only a loop gets from a later stop back to an earlier one.
+        const auto last = routeStopEnds_[route] - 1;
+        if (routeStops_[first] != routeStops_[last]) {
+            return 0;
+        }
+        return routeStopTimes_[last] - routeStopTimes_[first + from] + routeStopTimes_[first + to];
+    }
+
+    size_t CompactGraph::GetStationCount() const {
+        return edgeOffsets_.size() - 1;
+    }
+
+    size_t CompactGraph::GetStateCount() const {
+        return stateRoutes_.size();
+    }
+
+    uint32_t CompactGraph::FindEdge(IdHandle fromStation, IdHandle toStation) const {
+        const auto first = edgeTargets_.begin() + edgeOffsets_[fromStation];
+        const auto last = edgeTargets_.begin() + edgeOffsets_[fromStation + 1];
+        const auto it = std::lower_bound(first, last, toStation);
+        if (it == last || *it != toStation) {
+            return kNoIndex;
+        }
+        return static_cast<uint32_t>(it - edgeTargets_.begin());
+    }
+
+    std::vector<uint32_t> CompactGraph::GetRouteEdges(IdHandle route) const {
+        return {
+            routeEdges_.begin() + routeEdgeOffsets_[route],
+            routeEdges_.begin() + routeEdgeEnds_[route],
+        };
+    }
+
+    bool CompactGraph::UpdateEdgeRoutes(
+            std::vector<std::pair<uint32_t, IdHandle>> removed,
+            std::vector<std::pair<uint32_t, IdHandle>> added) {
+        std::sort(removed.begin(), removed.end());
+        std::sort(added.begin(), added.end());
+        added.erase(std::unique(added.begin(), added.end()), added.end());
+        std::vector<uint32_t> addedStates;
+        addedStates.reserve(added.size());
+        for (const auto& [edge, route] : added) {
+            const auto state = FindState(edgeTargets_[edge], route);
+            if (state == kNoIndex) {
+                return false;
             }
+            addedStates.push_back(state);
         }
-        for (const auto& stationIdAndEdge : fromStationIdToEdge_) {
-            for (const auto& routeId : stationIdAndEdge.second->GetRoutes()) {
-                routes.emplace(routeId);
+
+        // Merge the sorted routes of each edge with those added to it,
+        // skipping those removed from it.
+        std::vector<uint32_t> routeOffsets {0};
+        std::vector<IdHandle> routes;
+        std::vector<uint32_t> routeStates;
+        routeOffsets.reserve(edgeRouteOffsets_.size());
+        routes.reserve(edgeRoutes_.size() + added.size());
+        routeStates.reserve(edgeRoutes_.size() + added.size());
+        auto nextRemoved = removed.begin();
+        size_t nextAdded {0};
+        for (uint32_t edge = 0; edge < edgeTargets_.size(); ++edge) {
+            auto slot = edgeRouteOffsets_[edge];
+            const auto lastSlot = edgeRouteOffsets_[edge + 1];
+            while (slot < lastSlot || (nextAdded < added.size() && added[nextAdded].first == edge)) {
+                const bool takeAdded = nextAdded < added.size()
+                    && added[nextAdded].first == edge
+                    && (slot == lastSlot || added[nextAdded].second <= edgeRoutes_[slot]);
+                if (takeAdded) {
+                    if (slot < lastSlot && added[nextAdded].second == edgeRoutes_[slot]) {
+                        // Already on the edge.
+                        ++slot;
+                    }
+                    routes.push_back(added[nextAdded].second);
+                    routeStates.push_back(addedStates[nextAdded]);
+                    ++nextAdded;
+                    continue;
+                }
+                const std::pair<uint32_t, IdHandle> current {edge, edgeRoutes_[slot]};
+                while (nextRemoved != removed.end() && *nextRemoved < current) {
+                    ++nextRemoved;
+                }
+                if (nextRemoved == removed.end() || *nextRemoved != current) {
+                    routes.push_back(edgeRoutes_[slot]);
+                    routeStates.push_back(edgeRouteStates_[slot]);
+                }
+                ++slot;
             }
+            routeOffsets.push_back(static_cast<uint32_t>(routes.size()));
+        }
+        edgeRouteOffsets_ = std::move(routeOffsets);
+        edgeRoutes_ = std::move(routes);
+        edgeRouteStates_ = std::move(routeStates);
+        if (!UpdateRouteStops(removed, added)) {
+            BuildRouteStops();
         }
-        return {routes.begin(), routes.end()};
+        return true;
     }
 
-    std::unordered_map<Id, std::vector<RouteMetadata>> StationNode::GetStationIdToRoutesMetadata() const {
-        std::unordered_map<Id, std::vector<RouteMetadata>> metadataMap;
-        for (auto& [stationId, edgePtr] : toStationIdToEdge_) {
-            metadataMap[stationId] = edgePtr->GetRouteMetadata();
+    std::vector<IdHandle> CompactGraph::GetRoutesServingStation(IdHandle station) const {
+        std::vector<IdHandle> routes;
+        auto addEdgeRoutes = [this, &routes](uint32_t edge) {
+            routes.insert(
+                routes.end(),
+                edgeRoutes_.begin() + edgeRouteOffsets_[edge],
+                edgeRoutes_.begin() + edgeRouteOffsets_[edge + 1]);
+        };
+        for (auto edge = edgeOffsets_[station]; edge < edgeOffsets_[station + 1]; ++edge) {
+            addEdgeRoutes(edge);
         }
-        return metadataMap;
+        for (auto idx = inEdgeOffsets_[station]; idx < inEdgeOffsets_[station + 1]; ++idx) {
+            addEdgeRoutes(inEdges_[idx]);
+        }
+        std::sort(routes.begin(), routes.end());
+        routes.erase(std::unique(routes.begin(), routes.end()), routes.end());
+        return routes;
     }
 }
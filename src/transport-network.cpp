@@ -1,13 +1,24 @@
 #include "network-monitor/transport-network-defs.h"
 #include "network-monitor/transport-network.h"
 #include "network-monitor-internal/transport-network-internal.h"
+#include "network-monitor-internal/routing-engine.h"
+#include "network-monitor-internal/landmarks.h"
+#include "network-monitor-internal/contraction-hierarchy.h"
+#include "network-monitor-internal/route-cache.h"
+#include "network-monitor-internal/occupancy-history.h"
+#include "network-monitor-internal/parallel.h"
+#include "network-monitor-internal/timetable.h"
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <optional>
 #include <string>
+#include <tuple>
+#include <unordered_set>
 #include <vector>
-#include <deque>
-#include <queue>
 #include <limits>
 #include <functional>
 
@@ -24,21 +35,114 @@ namespace {
         }
         return true;
     }
+
+    // Route queries on a thread reuse this scratch space, so they do not
+    // allocate once it has grown to the size of the network.
+    thread_local NetworkMonitor::RoutingWorkspace routingWorkspace;
+    thread_local NetworkMonitor::RoutingWorkspace backwardRoutingWorkspace;
+    thread_local NetworkMonitor::TimetableWorkspace timetableWorkspace;
+
+    // Per-station deltas of a batch of passenger events, all 0 between
+    // batches, and the stations with a delta.
+    thread_local std::vector<long long int> passengerDeltas;
+    thread_local std::vector<NetworkMonitor::IdHandle> passengerDeltaStations;
+
+    constexpr size_t kDefaultRouteCacheCapacity {4096};
+
+    // A quiet route may take up to this many times as long as the fastest.
+    constexpr double kQuietRouteSlack {1.2};
+
+    constexpr NetworkMonitor::RouteProfile kFastestProfile {};
+
+    // An alternative route search gives up after this many searches per
+    // requested journey.
+    constexpr size_t kAlternativeRouteAttempts {3};
+
+    // Timetable searches stop after this many rounds, i.e. trips.
+    constexpr size_t kMaxTimetableTrips {8};
+
+    uint64_t MakeGraphVersion() {
+        static std::atomic<uint64_t> lastVersion {0};
+        return ++lastVersion;
+    }
+
+    long long int GetEpochSeconds(std::chrono::system_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+    }
+
+    // Occupancy history slots are tagged with seconds since the epoch, in a
+    // uint32_t: times before 1970, or from 2106 on, are clamped to that
+    // range.
+    uint32_t GetHistorySecond(std::chrono::system_clock::time_point time) {
+        return static_cast<uint32_t>(std::clamp<long long int>(
+            GetEpochSeconds(time), 0, std::numeric_limits<uint32_t>::max()));
+    }
+
+    // The second of the occupancy history an event at `time` is counted in,
+    // if `time` does not need clamping.
+    std::optional<uint32_t> GetEventSecond(std::chrono::system_clock::time_point time) {
+        const auto second = GetHistorySecond(time);
+        if (second != GetEpochSeconds(time)) {
+            return std::nullopt;
+        }
+        return second;
+    }
+
+    // The part of `window` that a history over `horizon` seconds covers.
+    uint32_t ClampHistoryWindow(std::chrono::seconds window, uint32_t horizon) {
+        return static_cast<uint32_t>(
+            std::clamp<long long int>(window.count(), 0, horizon));
+    }
+
+    // Whether no journey through one of `edges` can be faster than `route`,
+    // going by the lower bounds of `landmarks`, if any.
+    bool IsFasterThroughNone(
+            const NetworkMonitor::TravelRoute& route,
+            NetworkMonitor::IdHandle start,
+            NetworkMonitor::IdHandle end,
+            const NetworkMonitor::CompactGraph& graph,
+            const NetworkMonitor::LandmarkTable* landmarks,
+            const std::vector<uint32_t>& edges) {
+        const auto getLowerBound = [landmarks](
+                NetworkMonitor::IdHandle from,
+                NetworkMonitor::IdHandle to) -> uint64_t {
+            return landmarks == nullptr ? 0 : landmarks->GetLowerBound(from, to);
+        };
+        return std::all_of(edges.begin(), edges.end(), [&](uint32_t edge) {
+            const auto lowerBound = getLowerBound(start, graph.edgeSources_[edge])
+                + graph.edgeTravelTimes_[edge]
+                + getLowerBound(graph.edgeTargets_[edge], end);
+            return lowerBound > route.totalTravelTime;
+        });
+    }
+
+    unsigned int GetEdgeTravelTime(
+            const NetworkMonitor::CompactGraph& graph,
+            NetworkMonitor::IdHandle stationA,
+            NetworkMonitor::IdHandle stationB) {
+        const auto edge = graph.FindEdge(stationA, stationB);
+        if (edge == NetworkMonitor::CompactGraph::kNoIndex) {
+            return 0;
+        }
+        return graph.edgeTravelTimes_[edge];
+    }
 }
 
 namespace NetworkMonitor {
 
 bool TravelRoute::operator==(const TravelRoute& other) const {
-    bool equal = startStationId == other.startStationId
+    if (!(startStationId == other.startStationId
         && endStationId == other.endStationId
         && totalTravelTime == other.totalTravelTime
-        && steps.size() == other.steps.size();
+        && steps.size() == other.steps.size())) {
+        return false;
+    }
     for (size_t i = 0; i < steps.size(); i++) {
         if (!(steps[i] == other.steps[i])) {
-            equal = false;
+            return false;
         }
     }
-    return equal;
+    return true;
 }
 
 bool Step::operator==(const Step& other) const {
@@ -62,6 +166,17 @@ bool Route::operator==(const Route& other) const {
         && isEqual(stops, other.stops);
 }
 
+bool RouteTimetable::operator==(const RouteTimetable& other) const {
+    return departures == other.departures
+        && headway == other.headway
+        && firstDeparture == other.firstDeparture
+        && lastDeparture == other.lastDeparture;
+}
+
+bool RouteTimetable::operator!=(const RouteTimetable& other) const {
+    return !(*this == other);
+}
+
 bool Line::operator==(const Line& other) const {
     return id == other.id
         && name == other.name
@@ -80,228 +195,1022 @@ bool Line::operator!=(const Line& other) const {
     return !(*this == other);
 }
 
+TransportNetwork::TransportNetwork()
+    : routeCache_(std::make_shared<RouteCache>(kDefaultRouteCacheCapacity)),
+      routeProfiles_(std::make_shared<const std::unordered_map<std::string, RouteProfile>>(
+          std::unordered_map<std::string, RouteProfile> {
+              {"fastest", {RouteProfile::Kind::kFastest}},
+              {"quietest", {RouteProfile::Kind::kQuietest}},
+              {"fewest_transfers", {RouteProfile::Kind::kFewestTransfers}},
+          })) {
+    PublishTopology();
+}
+
+TransportNetwork::~TransportNetwork() = default;
+
+TransportNetwork::TransportNetwork(const TransportNetwork& copied)
+    : stationIds_(copied.stationIds_),
+      lineIds_(copied.lineIds_),
+      routeIds_(copied.routeIds_),
+      routeLines_(copied.routeLines_),
+      stationNodes_(copied.stationNodes_),
+      edges_(copied.edges_),
+      edgesPending_(copied.edgesPending_),
+      closedStations_(copied.closedStations_),
+      suspendedRoutes_(copied.suspendedRoutes_),
+      removedLines_(copied.removedLines_),
+      routeTimetables_(copied.routeTimetables_),
+      landmarkCount_(copied.landmarkCount_),
+      routeCache_(std::atomic_load(&copied.routeCache_)),
+      routeProfiles_(std::atomic_load(&copied.routeProfiles_)),
+      penalty_(copied.penalty_) {
+    // The copy shares everything but the passenger counts and history, the
+    // only parts of a snapshot that change once published.
+    auto snapshot = std::make_shared<NetworkSnapshot>(*copied.GetSnapshot());
+    snapshot->passengers = std::make_shared<PassengerCounters>(
+        snapshot->passengers->Clone());
+    if (snapshot->history != nullptr) {
+        snapshot->history = std::make_shared<OccupancyHistory>(
+            snapshot->history->Clone());
+    }
+    Publish(std::move(snapshot));
+}
+
+TransportNetwork::TransportNetwork(TransportNetwork&& moved)
+    : TransportNetwork() {
+    *this = std::move(moved);
+}
+
+TransportNetwork& TransportNetwork::operator=(const TransportNetwork& copied) {
+    if (this != &copied) {
+        *this = TransportNetwork(copied);
+    }
+    return *this;
+}
+
+TransportNetwork& TransportNetwork::operator=(TransportNetwork&& moved) {
+    // Hierarchies built in the background are for the network they started
+    // from.
+    WaitForContractionHierarchy();
+    moved.WaitForContractionHierarchy();
+    // Swap, so the moved-from network is still a valid one.
+    std::swap(stationIds_, moved.stationIds_);
+    std::swap(lineIds_, moved.lineIds_);
+    std::swap(routeIds_, moved.routeIds_);
+    std::swap(routeLines_, moved.routeLines_);
+    std::swap(stationNodes_, moved.stationNodes_);
+    std::swap(edges_, moved.edges_);
+    std::swap(edgesPending_, moved.edgesPending_);
+    std::swap(closedStations_, moved.closedStations_);
+    std::swap(suspendedRoutes_, moved.suspendedRoutes_);
+    std::swap(removedLines_, moved.removedLines_);
+    std::swap(routeTimetables_, moved.routeTimetables_);
+    std::swap(landmarkCount_, moved.landmarkCount_);
+    std::swap(penalty_, moved.penalty_);
+    auto snapshot = GetSnapshot();
+    auto routeCache = std::atomic_load(&routeCache_);
+    Publish(std::make_shared<NetworkSnapshot>(*moved.GetSnapshot()));
+    std::atomic_store(&routeCache_, std::atomic_load(&moved.routeCache_));
+    moved.Publish(std::make_shared<NetworkSnapshot>(*snapshot));
+    std::atomic_store(&moved.routeCache_, std::move(routeCache));
+    auto routeProfiles = std::atomic_load(&routeProfiles_);
+    std::atomic_store(&routeProfiles_, std::atomic_load(&moved.routeProfiles_));
+    std::atomic_store(&moved.routeProfiles_, std::move(routeProfiles));
+    return *this;
+}
+
 bool TransportNetwork::AddStation(const Station& station) {
-    auto nodePt = GetStationNode(station.id);
-    if (nodePt != nullptr) {
+    if (!AddStationNode(station)) {
         return false;
     }
-    stationIdToNode_[station.id] = std::make_shared<StationNode>();
+    // The station states come first, so the graph is laid out again. No
+    // edge reaches the station yet: no landmark bound or journey changes.
+    const auto previous = GetSnapshot();
+    auto graph = std::make_shared<CompactGraph>(
+        CompactGraph::Build(stationNodes_, edges_, routeLines_));
+    auto snapshot = MakeTopologySnapshot(std::move(graph));
+    if (previous->landmarks != nullptr) {
+        snapshot->landmarks = std::make_shared<LandmarkTable>(
+            previous->landmarks->Grow(stationIds_.Size()));
+    }
+    std::lock_guard<std::mutex> lock {publishMutex_};
+    PublishChange(std::move(snapshot), [](const TravelRoute&) { return true; });
     return true;
 }
 
 bool TransportNetwork::AddLine(const Line& line) {
+    if (!CanAddLine(line)) {
+        return false;
+    }
+    LoadPendingEdges();
+    const auto previous = GetSnapshot();
+    const auto& previousGraph = *previous->graph;
+    std::vector<std::vector<std::pair<IdHandle, IdHandle>>> routeStops;
+    // A removed line that comes back over the edges it ran over before only
+    // needs its routes put back on them.
+    bool isOnGraph {true};
     for (const auto& route : line.routes) {
-        for (size_t idx = 1; idx < route.stops.size(); idx++) {
-            const auto& prevStationId = route.stops[idx-1];
-            const auto& curStationId = route.stops[idx];
+        isOnGraph &= routeIds_.Find(route.id) != kInvalidIdHandle;
+        routeStops.emplace_back();
+        for (size_t idx = 1; idx < route.stops.size(); ++idx) {
+            const auto from = stationIds_.Find(route.stops[idx - 1]);
+            const auto to = stationIds_.Find(route.stops[idx]);
+            isOnGraph &= previousGraph.FindEdge(from, to) != CompactGraph::kNoIndex;
+            routeStops.back().emplace_back(from, to);
+        }
+    }
 
-            auto nodePt = GetStationNode(prevStationId);
-            if (nodePt == nullptr) {
-                return false;
+    std::shared_ptr<CompactGraph> graph {nullptr};
+    // The edges the line runs over on `graph`, and the ones it adds.
+    std::vector<uint32_t> lineEdges;
+    std::vector<uint32_t> newEdges;
+    if (isOnGraph) {
+        graph = std::make_shared<CompactGraph>(previousGraph);
+        std::vector<std::pair<uint32_t, IdHandle>> added;
+        for (size_t idx = 0; idx < line.routes.size(); ++idx) {
+            const auto& route = line.routes[idx];
+            const auto routeId = routeIds_.Find(route.id);
+            if (route.timetable == RouteTimetable {}) {
+                routeTimetables_.erase(routeId);
+            } else {
+                routeTimetables_[routeId] = route.timetable;
             }
-            auto edge = nodePt->GetOrMakeEdge(curStationId);
-            bool success = edge->AddRoute(
-                route.id,
-                route.lineId
-            );
-            if (!success) {
-                return false;
+            const auto suspended = suspendedRoutes_.find(routeId);
+            if (suspended != suspendedRoutes_.end()) {
+                suspended->second = routeStops[idx];
+                continue;
+            }
+            for (const auto& [from, to] : routeStops[idx]) {
+                edges_[stationNodes_[from].GetEdge(to)].AddRoute(routeId);
+                added.emplace_back(graph->FindEdge(from, to), routeId);
+                lineEdges.push_back(added.back().first);
+            }
+        }
+        removedLines_.erase(lineIds_.Find(line.id));
+        if (!graph->UpdateEdgeRoutes({}, std::move(added))) {
+            // The graph was rebuilt while the line was out of service,
+            // without states for its routes. The edges stay the same.
+            graph = std::make_shared<CompactGraph>(
+                CompactGraph::Build(stationNodes_, edges_, routeLines_));
+            graph->closedStations_ = closedStations_;
+        }
+    } else {
+        const auto lineId = lineIds_.Find(line.id);
+        if (lineId != kInvalidIdHandle) {
+            removedLines_.erase(lineId);
+        }
+        AddLineEdges(line);
+        graph = std::make_shared<CompactGraph>(
+            CompactGraph::Build(stationNodes_, edges_, routeLines_));
+        for (size_t idx = 0; idx < line.routes.size(); ++idx) {
+            const bool isSuspended = suspendedRoutes_.count(
+                routeIds_.Find(line.routes[idx].id)) > 0;
+            for (const auto& [from, to] : routeStops[idx]) {
+                const auto edge = graph->FindEdge(from, to);
+                if (!isSuspended) {
+                    lineEdges.push_back(edge);
+                }
+                if (previousGraph.FindEdge(from, to) == CompactGraph::kNoIndex) {
+                    newEdges.push_back(edge);
+                }
             }
+        }
+    }
 
-            auto curNodePt = GetStationNode(curStationId);
-            if (nodePt == nullptr) {
+    // New edges are as if their travel times dropped from infinity. The
+    // stations are the same.
+    auto landmarks = previous->landmarks;
+    if (landmarks != nullptr && !newEdges.empty()) {
+        landmarks = std::make_shared<LandmarkTable>(landmarks->Lower(*graph, newEdges));
+    }
+    // Journeys that do not take the line are the same, so a cached journey
+    // is still the fastest unless one on the line could beat it.
+    const std::shared_ptr<const CompactGraph> updated {graph};
+    const auto isCachedRouteKept = [&](const TravelRoute& route) {
+        return !route.steps.empty() && IsFasterThroughNone(
+            route,
+            stationIds_.Find(route.startStationId),
+            stationIds_.Find(route.endStationId),
+            *updated,
+            landmarks.get(),
+            lineEdges);
+    };
+    auto timetable = std::make_shared<Timetable>(
+        Timetable::Build(routeLines_.size(), routeTimetables_));
+    if (isOnGraph) {
+        PublishGraph(std::move(graph), landmarks, isCachedRouteKept, std::move(timetable));
+        return true;
+    }
+    auto snapshot = MakeTopologySnapshot(std::move(graph));
+    snapshot->landmarks = landmarks;
+    std::lock_guard<std::mutex> lock {publishMutex_};
+    PublishChange(std::move(snapshot), isCachedRouteKept);
+    return true;
+}
+
+bool TransportNetwork::CanAddLine(const Line& line) const {
+    const auto lineId = lineIds_.Find(line.id);
+    if (lineId != kInvalidIdHandle && removedLines_.count(lineId) == 0) {
+        return false;
+    }
+    std::unordered_set<IdHandle> routes;
+    for (const auto& route : line.routes) {
+        const auto routeId = routeIds_.Find(route.id);
+        if (routeId != kInvalidIdHandle
+            && (routeLines_[routeId] != lineId || !routes.insert(routeId).second)) {
+            return false;
+        }
+        std::unordered_set<uint64_t> stops;
+        for (size_t idx = 1; idx < route.stops.size(); ++idx) {
+            const uint64_t from {stationIds_.Find(route.stops[idx - 1])};
+            const uint64_t to {stationIds_.Find(route.stops[idx])};
+            if (from == kInvalidIdHandle
+                || to == kInvalidIdHandle
+                || !stops.insert((from << 32) | to).second) {
                 return false;
             }
-            curNodePt->AddIncomingEdge(prevStationId, edge);
         }
     }
     return true;
 }
 
-bool TransportNetwork::RecordPassengerEvent(const PassengerEvent& event) {
-    auto nodePt = GetStationNode(event.stationId);
-    if (nodePt == nullptr) {
+bool TransportNetwork::RemoveLine(const Id& line) {
+    const auto lineId = lineIds_.Find(line);
+    if (lineId == kInvalidIdHandle || removedLines_.count(lineId) > 0) {
         return false;
     }
-    event.type == PassengerEvent::Type::In ? nodePt->passengers_++ : nodePt->passengers_--;
+    const auto previous = GetSnapshot();
+    std::vector<std::pair<uint32_t, IdHandle>> removed;
+    for (IdHandle route = 0; route < routeLines_.size(); ++route) {
+        // A suspended route is off its edges already, and stays suspended.
+        if (routeLines_[route] != lineId || suspendedRoutes_.count(route) > 0) {
+            continue;
+        }
+        const auto routeRemoved = TakeRouteOffEdges(route, *previous->graph);
+        removed.insert(removed.end(), routeRemoved.begin(), routeRemoved.end());
+    }
+    removedLines_.insert(lineId);
+    if (removed.empty()) {
+        return true;
+    }
+    // The copy shares the arrays UpdateEdgeRoutes leaves as they are.
+    auto graph = std::make_shared<CompactGraph>(*previous->graph);
+    graph->UpdateEdgeRoutes(std::move(removed), {});
+    // Taking routes away only makes journeys longer: the landmark bounds,
+    // which ignore routes, still hold, and so does any cached journey that
+    // does not take the line.
+    PublishGraph(std::move(graph), previous->landmarks, [&line](const TravelRoute& route) {
+        return std::none_of(route.steps.begin(), route.steps.end(), [&line](const Step& step) {
+            return step.lineId == line;
+        });
+    });
     return true;
 }
 
-long long int TransportNetwork::GetPassengerCount(const Id& station) const {
-    auto nodePt = GetStationNode(station);
-    if (nodePt == nullptr) {
-        throw std::runtime_error("Station not found: " + station);
+bool TransportNetwork::AddStationNode(const Station& station) {
+    if (stationIds_.Find(station.id) != kInvalidIdHandle) {
+        return false;
+    }
+    LoadPendingEdges();
+    stationIds_.Intern(station.id);
+    stationNodes_.push_back(StationNode {{}});
+    if (!closedStations_.empty()) {
+        closedStations_.push_back(0);
     }
-    return nodePt->passengers_;
+    return true;
 }
 
-std::vector<Id> TransportNetwork::GetRoutesServingStation(const Id& station) const {
-    auto nodePt = GetStationNode(station);
-    if (nodePt == nullptr) {
-        return std::vector<Id>();
+bool TransportNetwork::AddLineEdges(const Line& line) {
+    LoadPendingEdges();
+    const auto lineId = lineIds_.Intern(line.id);
+    for (const auto& route : line.routes) {
+        const auto routeId = routeIds_.Intern(route.id);
+        if (routeId == routeLines_.size()) {
+            routeLines_.push_back(lineId);
+        }
+        if (route.timetable == RouteTimetable {}) {
+            routeTimetables_.erase(routeId);
+        } else {
+            routeTimetables_[routeId] = route.timetable;
+        }
+        // A suspended route only gets its edges, to be put on once resumed.
+        const auto suspended = suspendedRoutes_.find(routeId);
+        if (suspended != suspendedRoutes_.end()) {
+            suspended->second.clear();
+        }
+        for (size_t idx = 1; idx < route.stops.size(); idx++) {
+            const auto prevStationId = stationIds_.Find(route.stops[idx-1]);
+            const auto curStationId = stationIds_.Find(route.stops[idx]);
+            if (prevStationId == kInvalidIdHandle || curStationId == kInvalidIdHandle) {
+                return false;
+            }
+            const auto edgeIdx = stationNodes_[prevStationId].GetOrMakeEdge(curStationId, edges_);
+            if (suspended != suspendedRoutes_.end()) {
+                suspended->second.emplace_back(prevStationId, curStationId);
+                continue;
+            }
+            bool success = edges_[edgeIdx].AddRoute(routeId);
+            if (!success) {
+                return false;
+            }
+        }
     }
-    return nodePt->GetRoutes();
+    return true;
 }
 
-bool TransportNetwork::SetTravelTime(
-    const Id& stationA,
-    const Id& stationB,
-    const unsigned int travelTime) {
-    bool success = SetTravelTimeDirectional(stationA, stationB, travelTime);
-    success |= SetTravelTimeDirectional(stationB, stationA, travelTime);
-    return success;
+void TransportNetwork::PublishTopology() {
+    LoadPendingEdges();
+    PublishTopology(std::make_shared<CompactGraph>(
+        CompactGraph::Build(stationNodes_, edges_, routeLines_)));
 }
 
-bool TransportNetwork::SetTravelTimeDirectional(
-    const Id& stationA,
-    const Id& stationB,
-    const unsigned int travelTime) {
-    auto nodePt = GetStationNode(stationA);
-    if (nodePt == nullptr) {
-        return false;
+void TransportNetwork::PublishTopology(std::shared_ptr<CompactGraph> graph) {
+    auto snapshot = MakeTopologySnapshot(std::move(graph));
+    // New edges can shorten journeys, which invalidates the lower bounds, so
+    // the snapshot has no landmarks or hierarchy, and none is rebuilt.
+    std::lock_guard<std::mutex> lock {publishMutex_};
+    hierarchyPending_ = false;
+    PublishLocked(std::move(snapshot));
+}
+
+std::shared_ptr<NetworkSnapshot> TransportNetwork::MakeTopologySnapshot(
+        std::shared_ptr<CompactGraph> graph) const {
+    auto snapshot = std::make_shared<NetworkSnapshot>();
+    snapshot->stationIds = std::make_shared<IdTable>(stationIds_);
+    snapshot->lineIds = std::make_shared<IdTable>(lineIds_);
+    snapshot->routeIds = std::make_shared<IdTable>(routeIds_);
+    graph->closedStations_ = closedStations_;
+    snapshot->graph = std::move(graph);
+    snapshot->timetable = std::make_shared<Timetable>(
+        Timetable::Build(routeLines_.size(), routeTimetables_));
+
+    // The new counters share those of the existing stations, so events
+    // recorded on the previous snapshot are not lost.
+    const auto previous = std::atomic_load(&snapshot_);
+    snapshot->passengers = std::make_shared<PassengerCounters>(
+        previous == nullptr
+            ? PassengerCounters {}.Grow(stationIds_.Size())
+            : previous->passengers->Grow(stationIds_.Size()));
+    if (previous != nullptr && previous->history != nullptr) {
+        snapshot->history = std::make_shared<OccupancyHistory>(
+            previous->history->Grow(stationIds_.Size()));
+    }
+    return snapshot;
+}
+
+void TransportNetwork::LoadPendingEdges() {
+    if (!edgesPending_) {
+        return;
     }
-    auto edgePt = nodePt->GetEdge(stationB);
-    bool success = false;
-    if (edgePt != nullptr) {
-        edgePt->travelTime_ = travelTime;
-        success = true;
+    edgesPending_ = false;
+    // Edge indices are those of the compact graph.
+    const auto& graph = *GetSnapshot()->graph;
+    stationNodes_.assign(graph.GetStationCount(), StationNode {{}});
+    edges_.clear();
+    edges_.reserve(graph.edgeTargets_.size());
+    for (IdHandle station = 0; station < graph.GetStationCount(); ++station) {
+        auto& node = stationNodes_[station];
+        node.toStationIdToEdge_.reserve(graph.edgeOffsets_[station + 1] - graph.edgeOffsets_[station]);
+        for (auto edge = graph.edgeOffsets_[station]; edge < graph.edgeOffsets_[station + 1]; ++edge) {
+            node.toStationIdToEdge_.emplace(graph.edgeTargets_[edge], edge);
+            edges_.push_back(RouteEdge {
+                graph.edgeTravelTimes_[edge],
+                {graph.edgeRoutes_.begin() + graph.edgeRouteOffsets_[edge],
+                 graph.edgeRoutes_.begin() + graph.edgeRouteOffsets_[edge + 1]},
+            });
+        }
     }
-    return success;
 }
 
+std::shared_ptr<const NetworkSnapshot> TransportNetwork::GetSnapshot() const {
+    return std::atomic_load(&snapshot_);
+}
 
-unsigned int TransportNetwork::GetTravelTimeDirectional(
-        const Id& stationA,
-        const Id& stationB) const {
-    if (stationA == stationB) {
-        return 0;
+void TransportNetwork::Publish(std::shared_ptr<NetworkSnapshot> snapshot) {
+    std::lock_guard<std::mutex> lock {publishMutex_};
+    PublishLocked(std::move(snapshot));
+}
+
+void TransportNetwork::PublishLocked(
+        std::shared_ptr<NetworkSnapshot> snapshot,
+        const std::function<bool (const TravelRoute&)>& isCachedRouteKept) {
+    const auto current = std::atomic_load(&snapshot_);
+    if (current != nullptr
+        && snapshot->hierarchy == nullptr
+        && snapshot->graph == current->graph) {
+        // Published in the background since `snapshot` was copied.
+        snapshot->hierarchy = current->hierarchy;
     }
-    auto nodePt = GetStationNode(stationA);
-    if (nodePt == nullptr) {
-        return 0;
+    snapshot->version = MakeGraphVersion();
+    // Carried before the snapshot is visible, so that no query on it misses
+    // a route that is carried over.
+    const auto routeCache = std::atomic_load(&routeCache_);
+    if (isCachedRouteKept != nullptr && current != nullptr && routeCache != nullptr) {
+        routeCache->Carry(current->version, snapshot->version, isCachedRouteKept);
     }
-    auto edgePt = nodePt->GetEdge(stationB);
-    if (edgePt == nullptr) {
-        return 0;
+    std::atomic_store(&snapshot_, std::shared_ptr<const NetworkSnapshot> {std::move(snapshot)});
+}
+
+void TransportNetwork::PublishGraph(
+        std::shared_ptr<CompactGraph> graph,
+        std::shared_ptr<const LandmarkTable> landmarks,
+        const std::function<bool (const TravelRoute&)>& isCachedRouteKept,
+        std::shared_ptr<const Timetable> timetable) {
+    std::lock_guard<std::mutex> lock {publishMutex_};
+    auto snapshot = std::make_shared<NetworkSnapshot>(*std::atomic_load(&snapshot_));
+    snapshot->graph = std::move(graph);
+    snapshot->landmarks = std::move(landmarks);
+    if (timetable != nullptr) {
+        snapshot->timetable = std::move(timetable);
     }
-    return edgePt->travelTime_;
+    PublishChange(std::move(snapshot), isCachedRouteKept);
 }
 
-unsigned int TransportNetwork::GetTravelTime(
-        const Id& stationA,
-        const Id& stationB) const {
-    return std::max(
-        GetTravelTimeDirectional(stationA, stationB),
-        GetTravelTimeDirectional(stationB, stationA));
+void TransportNetwork::PublishChange(
+        std::shared_ptr<NetworkSnapshot> snapshot,
+        const std::function<bool (const TravelRoute&)>& isCachedRouteKept) {
+    const auto previous = std::atomic_load(&snapshot_);
+    // Shortcuts leave out the paths that had a faster witness, which a
+    // change can make slower, so the hierarchy cannot be patched. It is
+    // rebuilt in the background instead.
+    snapshot->hierarchy.reset();
+    PublishLocked(std::move(snapshot), isCachedRouteKept);
+    hierarchyPending_ |= previous->hierarchy != nullptr;
+    if (hierarchyPending_ && !hierarchyBuilding_) {
+        RebuildHierarchyInBackground();
+    }
 }
-    
-unsigned int TransportNetwork::GetTravelTime(
-    const Id& line,
-    const Id& route,
-    const Id& stationA,
-    const Id& stationB) const {
-    auto cur_station = stationA;
-    unsigned int time = 0u;
-    while (cur_station != stationB) {
-        auto stationPt = GetStationNode(cur_station);
-        if (stationPt == nullptr) {
-            return 0;
-        }
-        bool foundNextEdge = false;
-        for (const auto& [toStationId, edge] : stationPt->toStationIdToEdge_) {
-            if (edge->HasRoute(line, route)) {
-                cur_station = toStationId;
-                time += edge->travelTime_;
-                foundNextEdge = true;
-                break;
+
+void TransportNetwork::RebuildHierarchyInBackground() {
+    hierarchyBuilding_ = true;
+    hierarchyBuild_ = std::async(std::launch::async, [this, penalty = penalty_]() {
+        while (true) {
+            const auto graph = std::atomic_load(&snapshot_)->graph;
+            auto hierarchy = std::make_shared<ContractionHierarchy>(
+                ContractionHierarchy::Build(*graph, penalty));
+            std::lock_guard<std::mutex> lock {publishMutex_};
+            const auto current = std::atomic_load(&snapshot_);
+            if (hierarchyPending_ && current->graph != graph) {
+                continue;
             }
+            if (hierarchyPending_) {
+                auto snapshot = std::make_shared<NetworkSnapshot>(*current);
+                snapshot->hierarchy = std::move(hierarchy);
+                // The hierarchy finds the same journeys.
+                PublishLocked(std::move(snapshot), [](const TravelRoute&) { return true; });
+            }
+            hierarchyPending_ = false;
+            hierarchyBuilding_ = false;
+            return;
         }
-        if (!foundNextEdge) {
-            return 0;
-        }
+    });
+}
+
+void TransportNetwork::WaitForContractionHierarchy() {
+    if (hierarchyBuild_.valid()) {
+        hierarchyBuild_.wait();
     }
-    return time;
 }
 
-StationNode* TransportNetwork::GetStationNode(const Id& stationId) {
-    auto stationResult = stationIdToNode_.find(stationId);
-    if (stationResult == stationIdToNode_.end()) {
-        return nullptr;
+std::vector<std::pair<uint32_t, IdHandle>> TransportNetwork::TakeRouteOffEdges(
+        IdHandle route,
+        const CompactGraph& graph) {
+    LoadPendingEdges();
+    std::vector<std::pair<uint32_t, IdHandle>> removed;
+    for (const auto edge : graph.GetRouteEdges(route)) {
+        const auto edgeIdx = stationNodes_[graph.edgeSources_[edge]].GetEdge(
+            graph.edgeTargets_[edge]);
+        edges_[edgeIdx].RemoveRoute(route);
+        removed.emplace_back(edge, route);
     }
-    return stationResult->second.get();
+    return removed;
 }
 
-const StationNode* TransportNetwork::GetStationNode(const Id& stationId) const {
-    return const_cast<TransportNetwork*>(this)->GetStationNode(stationId);
+void TransportNetwork::RebuildLandmarks() {
+    auto snapshot = std::make_shared<NetworkSnapshot>(*GetSnapshot());
+    snapshot->landmarks = std::make_shared<LandmarkTable>(
+        LandmarkTable::Build(*snapshot->graph, landmarkCount_));
+    Publish(std::move(snapshot));
 }
 
-bool TransportNetwork::FromJson(
-    nlohmann::json&& src) {
-    bool success;
-    for (auto it = src["stations"].begin(); it != src["stations"].end(); it++) {
-        auto stationId = (*it)["station_id"].template get<std::string>();
-        auto name = (*it)["name"].template get<std::string>();
-        success = AddStation(Station{stationId, name});
-        if (!success) {
-            throw std::runtime_error("Unable to add station: " + stationId);
+void TransportNetwork::SetLandmarkCount(size_t count) {
+    landmarkCount_ = count;
+    RebuildLandmarks();
+}
+
+size_t TransportNetwork::GetLandmarkCount() const {
+    return landmarkCount_;
+}
+
+void TransportNetwork::BuildContractionHierarchy() {
+    {
+        std::lock_guard<std::mutex> lock {publishMutex_};
+        hierarchyPending_ = false;
+    }
+    auto snapshot = std::make_shared<NetworkSnapshot>(*GetSnapshot());
+    snapshot->hierarchy = std::make_shared<ContractionHierarchy>(
+        ContractionHierarchy::Build(*snapshot->graph, penalty_));
+    Publish(std::move(snapshot));
+}
+
+bool TransportNetwork::HasContractionHierarchy() const {
+    return GetSnapshot()->hierarchy != nullptr;
+}
+
+void TransportNetwork::SetRouteCacheCapacity(size_t capacity) {
+    std::atomic_store(&routeCache_, std::make_shared<RouteCache>(capacity));
+}
+
+RouteCacheStats TransportNetwork::GetRouteCacheStats() const {
+    const auto routeCache = std::atomic_load(&routeCache_);
+    return routeCache == nullptr ? RouteCacheStats {} : routeCache->GetStats();
+}
+
+bool TransportNetwork::RecordPassengerEvent(const PassengerEvent& event) {
+    return RecordPassengerEvent(GetStationHandle(event.stationId), event.type, event.time);
+}
+
+bool TransportNetwork::RecordPassengerEvent(
+        IdHandle station,
+        PassengerEvent::Type type,
+        std::chrono::system_clock::time_point time) {
+    const auto snapshot = GetSnapshot();
+    auto& passengers = *snapshot->passengers;
+    if (station >= passengers.Size()) {
+        return false;
+    }
+    passengers.Add(station, type == PassengerEvent::Type::In ? 1 : -1);
+    if (snapshot->history != nullptr) {
+        if (time == std::chrono::system_clock::time_point {}) {
+            time = std::chrono::system_clock::now();
+        }
+        if (const auto second = GetEventSecond(time)) {
+            snapshot->history->Add(station, type, *second);
         }
     }
+    return true;
+}
 
-    std::unordered_map<std::string, std::string> lineIdToName;
-    std::unordered_map<std::string, std::vector<Route>> lineToRoutes;
-    for (auto it = src["lines"].begin(); it != src["lines"].end(); it++) {
-        auto lineId = (*it)["line_id"].template get<std::string>();
-        if (lineIdToName.find(lineId) == lineIdToName.end()) {
-            lineIdToName[lineId] = (*it)["name"].template get<std::string>();
+size_t TransportNetwork::RecordPassengerEvents(const std::vector<PassengerEvent>& events) {
+    const auto snapshot = GetSnapshot();
+    auto& passengers = *snapshot->passengers;
+    auto* history = snapshot->history.get();
+    auto& deltas = passengerDeltas;
+    auto& stations = passengerDeltaStations;
+    if (deltas.size() < passengers.Size()) {
+        deltas.resize(passengers.Size(), 0);
+    }
+    std::optional<uint32_t> now {};
+    size_t nFailed {0};
+    for (const auto& event : events) {
+        const auto station = snapshot->stationIds->Find(event.stationId);
+        if (station == kInvalidIdHandle) {
+            ++nFailed;
+            continue;
         }
-        for (auto routesIt = (*it)["routes"].begin(); routesIt != (*it)["routes"].end(); routesIt++) {
-            std::vector<Id> stops;
-            for (auto stopsIt = (*routesIt)["route_stops"].begin(); stopsIt != (*routesIt)["route_stops"].end(); stopsIt++) {
-                stops.emplace_back(*stopsIt);
-            }
-            auto route = Route{
-                (*routesIt)["route_id"].template get<std::string>(),
-                (*routesIt)["direction"].template get<std::string>(),
-                lineId,
-                (*routesIt)["start_station_id"].template get<std::string>(),
-                (*routesIt)["end_station_id"].template get<std::string>(),
-                stops
-            };
-            auto lineAndRouteIt = lineToRoutes.find(lineId);
-            if (lineAndRouteIt == lineToRoutes.end()) {
-                lineToRoutes[lineId] = {route};
-            } else {
-                lineToRoutes[lineId].push_back(route);
+        if (deltas[station] == 0) {
+            // May list a station twice if its delta goes back to 0.
+            stations.push_back(station);
+        }
+        deltas[station] += event.type == PassengerEvent::Type::In ? 1 : -1;
+        if (history == nullptr) {
+            continue;
+        }
+        if (event.time != std::chrono::system_clock::time_point {}) {
+            if (const auto second = GetEventSecond(event.time)) {
+                history->Add(station, event.type, *second);
             }
+            continue;
+        }
+        if (!now) {
+            now = GetHistorySecond(std::chrono::system_clock::now());
         }
+        history->Add(station, event.type, *now);
     }
+    for (const auto station : stations) {
+        if (deltas[station] != 0) {
+            passengers.Add(station, deltas[station]);
+            deltas[station] = 0;
+        }
+    }
+    stations.clear();
+    return nFailed;
+}
 
-    for (const auto& [lineId, route] : lineToRoutes) {
-        success = AddLine(Line{
-            lineId,
-            lineIdToName[lineId],
-            lineToRoutes[lineId]
+size_t TransportNetwork::AddPassengerCounts(const TransportNetwork& other) {
+    const auto otherSnapshot = other.GetSnapshot();
+    const auto snapshot = GetSnapshot();
+    const auto& otherStationIds = *otherSnapshot->stationIds;
+    size_t nMissing {0};
+    for (IdHandle otherStation = 0; otherStation < otherStationIds.Size(); ++otherStation) {
+        const auto station = snapshot->stationIds->Find(otherStationIds.Get(otherStation));
+        if (station == kInvalidIdHandle) {
+            ++nMissing;
+            continue;
+        }
+        const auto count = otherSnapshot->passengers->Get(otherStation);
+        if (count != 0) {
+            snapshot->passengers->Add(station, count);
+        }
+    }
+    return nMissing;
+}
+
+IdHandle TransportNetwork::GetStationHandle(const Id& station) const {
+    return GetSnapshot()->stationIds->Find(station);
+}
+
+Id TransportNetwork::GetStationId(IdHandle station) const {
+    const auto snapshot = GetSnapshot();
+    const auto& stationIds = *snapshot->stationIds;
+    return station < stationIds.Size() ? stationIds.Get(station) : Id {};
+}
+
+long long int TransportNetwork::GetPassengerCount(const Id& station) const {
+    const auto stationId = GetStationHandle(station);
+    if (stationId == kInvalidIdHandle) {
+        throw std::runtime_error("Station not found: " + station);
+    }
+    return GetPassengerCount(stationId);
+}
+
+long long int TransportNetwork::GetPassengerCount(IdHandle station) const {
+    const auto snapshot = GetSnapshot();
+    const auto& passengers = *snapshot->passengers;
+    if (station >= passengers.Size()) {
+        throw std::runtime_error("Station not found: " + std::to_string(station));
+    }
+    return passengers.Get(station);
+}
+
+std::vector<StationPassengerCount> TransportNetwork::GetMostCrowdedStations(
+        size_t k,
+        size_t* nStationsScanned) const {
+    const auto snapshot = GetSnapshot();
+    std::vector<StationPassengerCount> crowded;
+    for (const auto& [station, count] :
+            snapshot->passengers->GetMostCrowded(k, nStationsScanned)) {
+        crowded.push_back({snapshot->stationIds->Get(station), count});
+    }
+    return crowded;
+}
+
+void TransportNetwork::SetOccupancyHistoryHorizon(std::chrono::seconds horizon) {
+    if (horizon.count() > OccupancyHistory::kMaxHorizon) {
+        throw std::runtime_error(
+            "Occupancy history horizon too long: " + std::to_string(horizon.count()) + "s");
+    }
+    auto snapshot = std::make_shared<NetworkSnapshot>(*GetSnapshot());
+    snapshot->history.reset();
+    if (horizon.count() > 0) {
+        snapshot->history = std::make_shared<OccupancyHistory>(
+            OccupancyHistory {static_cast<uint32_t>(horizon.count())}.Grow(
+                stationIds_.Size()));
+    }
+    Publish(std::move(snapshot));
+}
+
+std::chrono::seconds TransportNetwork::GetOccupancyHistoryHorizon() const {
+    const auto history = GetSnapshot()->history;
+    return std::chrono::seconds {history == nullptr ? 0 : history->GetHorizon()};
+}
+
+long long int TransportNetwork::GetPassengerCount(
+        const Id& station,
+        std::chrono::system_clock::time_point time) const {
+    const auto snapshot = GetSnapshot();
+    const auto stationId = snapshot->stationIds->Find(station);
+    if (stationId == kInvalidIdHandle) {
+        throw std::runtime_error("Station not found: " + station);
+    }
+    const auto from = GetHistorySecond(time);
+    const auto to = GetHistorySecond(std::chrono::system_clock::now());
+    if (to <= from) {
+        return snapshot->passengers->Get(stationId);
+    }
+    if (snapshot->history == nullptr || to - from >= snapshot->history->GetHorizon()) {
+        throw std::runtime_error("Time not in the occupancy history");
+    }
+    const auto since = snapshot->history->GetTotals(stationId, from, to);
+    return snapshot->passengers->Get(stationId) - since.entries + since.exits;
+}
+
+PassengerFlow TransportNetwork::GetPassengerFlow(
+        const Id& station,
+        std::chrono::seconds window) const {
+    const auto snapshot = GetSnapshot();
+    const auto stationId = snapshot->stationIds->Find(station);
+    if (stationId == kInvalidIdHandle) {
+        throw std::runtime_error("Station not found: " + station);
+    }
+    PassengerFlow flow {};
+    if (snapshot->history == nullptr || window.count() <= 0) {
+        return flow;
+    }
+    const auto seconds = ClampHistoryWindow(window, snapshot->history->GetHorizon());
+    const auto to = GetHistorySecond(std::chrono::system_clock::now());
+    const auto totals = snapshot->history->GetTotals(stationId, to - seconds, to);
+    flow.entries = totals.entries;
+    flow.exits = totals.exits;
+    flow.entriesPerSecond = static_cast<double>(totals.entries) / seconds;
+    flow.exitsPerSecond = static_cast<double>(totals.exits) / seconds;
+    return flow;
+}
+
+std::vector<StationPassengerCount> TransportNetwork::GetBusiestStations(
+        size_t k,
+        std::chrono::seconds window) const {
+    const auto snapshot = GetSnapshot();
+    if (snapshot->history == nullptr || window.count() <= 0) {
+        return {};
+    }
+    const auto seconds = ClampHistoryWindow(window, snapshot->history->GetHorizon());
+    const auto to = GetHistorySecond(std::chrono::system_clock::now());
+    std::vector<std::pair<long long int, IdHandle>> traffic;
+    traffic.reserve(snapshot->passengers->Size());
+    for (IdHandle station = 0; station < snapshot->passengers->Size(); ++station) {
+        const auto totals = snapshot->history->GetTotals(station, to - seconds, to);
+        traffic.emplace_back(totals.entries + totals.exits, station);
+    }
+    k = std::min(k, traffic.size());
+    std::partial_sort(
+        traffic.begin(),
+        traffic.begin() + k,
+        traffic.end(),
+        [](const auto& a, const auto& b) {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
         });
+    std::vector<StationPassengerCount> busiest;
+    busiest.reserve(k);
+    for (size_t idx = 0; idx < k; ++idx) {
+        busiest.push_back({snapshot->stationIds->Get(traffic[idx].second), traffic[idx].first});
+    }
+    return busiest;
+}
+
+std::vector<Id> TransportNetwork::GetRoutesServingStation(const Id& station) const {
+    const auto snapshot = GetSnapshot();
+    const auto stationId = snapshot->stationIds->Find(station);
+    if (stationId == kInvalidIdHandle) {
+        return {};
+    }
+    std::vector<Id> routes;
+    for (const auto routeId : snapshot->graph->GetRoutesServingStation(stationId)) {
+        routes.push_back(snapshot->routeIds->Get(routeId));
+    }
+    return routes;
+}
+
+bool TransportNetwork::SetTravelTime(
+    const Id& stationA,
+    const Id& stationB,
+    const unsigned int travelTime) {
+    return UpdateTravelTimes({{stationA, stationB, travelTime}}) == 0;
+}
+
+size_t TransportNetwork::UpdateTravelTimes(const std::vector<TravelTimeUpdate>& updates) {
+    // The topology is unchanged, so publish a patched copy of the compact
+    // graph rather than rebuilding it.
+    const auto previous = GetSnapshot();
+    std::shared_ptr<CompactGraph> graph {nullptr};
+    // The (from, to) station pairs of the edges whose travel time changed.
+    std::unordered_set<uint64_t> changed;
+    std::vector<uint32_t> changedEdges;
+    std::vector<uint32_t> decreasedEdges;
+    size_t nFailed {0};
+    for (const auto& update : updates) {
+        const auto stationIdA = stationIds_.Find(update.stationA);
+        const auto stationIdB = stationIds_.Find(update.stationB);
+        if (stationIdA == kInvalidIdHandle || stationIdB == kInvalidIdHandle) {
+            ++nFailed;
+            continue;
+        }
+        bool success = SetEdgeTravelTime(stationIdA, stationIdB, update.travelTime);
+        success |= SetEdgeTravelTime(stationIdB, stationIdA, update.travelTime);
         if (!success) {
-            throw std::runtime_error("Unable to add line: " + lineId);
+            ++nFailed;
+            continue;
+        }
+        for (const auto& [from, to] : {
+                std::make_pair(stationIdA, stationIdB),
+                std::make_pair(stationIdB, stationIdA)}) {
+            const auto& current = graph == nullptr ? *previous->graph : *graph;
+            const auto edge = current.FindEdge(from, to);
+            if (edge == CompactGraph::kNoIndex
+                || current.edgeTravelTimes_[edge] == update.travelTime) {
+                continue;
+            }
+            if (update.travelTime < current.edgeTravelTimes_[edge]) {
+                decreasedEdges.push_back(edge);
+            }
+            changed.insert((static_cast<uint64_t>(from) << 32) | to);
+            if (graph == nullptr) {
+                graph = std::make_shared<CompactGraph>(*previous->graph);
+            }
+            graph->edgeTravelTimes_.Mutable()[edge] = update.travelTime;
+            changedEdges.push_back(edge);
+        }
+    }
+    if (graph == nullptr) {
+        return nFailed;
+    }
+    graph->UpdateRouteTimes(changedEdges);
+    // The landmark lower bounds still hold as travel times grow, and only
+    // need the decreases searched from.
+    auto landmarks = previous->landmarks;
+    if (landmarks != nullptr && !decreasedEdges.empty()) {
+        landmarks = std::make_shared<LandmarkTable>(landmarks->Lower(*graph, decreasedEdges));
+    }
+    const std::shared_ptr<const CompactGraph> updated {graph};
+    // A cached journey that takes none of the changed edges keeps its travel
+    // time. It is still the fastest unless a journey through an edge that got
+    // faster could beat it, which the lower bounds rule out.
+    PublishGraph(std::move(graph), landmarks, [&](const TravelRoute& route) {
+        if (route.steps.empty()) {
+            // Travel times do not change which stations can be reached.
+            return true;
+        }
+        const auto isChanged = [&](const Step& step) {
+            const uint64_t from {stationIds_.Find(step.startStationId)};
+            const uint64_t to {stationIds_.Find(step.endStationId)};
+            return changed.count((from << 32) | to) > 0;
+        };
+        if (std::any_of(route.steps.begin(), route.steps.end(), isChanged)) {
+            return false;
+        }
+        return IsFasterThroughNone(
+            route,
+            stationIds_.Find(route.startStationId),
+            stationIds_.Find(route.endStationId),
+            *updated,
+            landmarks.get(),
+            decreasedEdges);
+    });
+    return nFailed;
+}
+
+bool TransportNetwork::SuspendRoute(const Id& line, const Id& route) {
+    const auto routeId = routeIds_.Find(route);
+    if (routeId == kInvalidIdHandle
+        || routeLines_[routeId] != lineIds_.Find(line)
+        || suspendedRoutes_.count(routeId) > 0) {
+        return false;
+    }
+    const auto previous = GetSnapshot();
+    auto removed = TakeRouteOffEdges(routeId, *previous->graph);
+    if (removed.empty()) {
+        // The line was removed.
+        return false;
+    }
+    auto& stops = suspendedRoutes_[routeId];
+    for (const auto& [edge, _] : removed) {
+        stops.emplace_back(previous->graph->edgeSources_[edge], previous->graph->edgeTargets_[edge]);
+    }
+    auto graph = std::make_shared<CompactGraph>(*previous->graph);
+    graph->UpdateEdgeRoutes(std::move(removed), {});
+    PublishGraph(std::move(graph), previous->landmarks, [&route](const TravelRoute& travelRoute) {
+        return std::none_of(
+            travelRoute.steps.begin(),
+            travelRoute.steps.end(),
+            [&route](const Step& step) { return step.routeId == route; });
+    });
+    return true;
+}
+
+bool TransportNetwork::ResumeRoute(const Id& line, const Id& route) {
+    const auto routeId = routeIds_.Find(route);
+    if (routeId == kInvalidIdHandle || routeLines_[routeId] != lineIds_.Find(line)) {
+        return false;
+    }
+    const auto suspended = suspendedRoutes_.find(routeId);
+    if (suspended == suspendedRoutes_.end() || removedLines_.count(routeLines_[routeId]) > 0) {
+        return false;
+    }
+    LoadPendingEdges();
+    const auto previous = GetSnapshot();
+    auto graph = std::make_shared<CompactGraph>(*previous->graph);
+    std::vector<std::pair<uint32_t, IdHandle>> added;
+    for (const auto& [from, to] : suspended->second) {
+        edges_[stationNodes_[from].GetEdge(to)].AddRoute(routeId);
+        added.emplace_back(graph->FindEdge(from, to), routeId);
+    }
+    suspendedRoutes_.erase(suspended);
+    if (!graph->UpdateEdgeRoutes({}, std::move(added))) {
+        // The graph was rebuilt while the route was suspended, without states
+        // for it.
+        graph = std::make_shared<CompactGraph>(
+            CompactGraph::Build(stationNodes_, edges_, routeLines_));
+        graph->closedStations_ = closedStations_;
+    }
+    // Journeys can get shorter, so no cached journey is kept. The landmark
+    // bounds ignore routes and still hold.
+    PublishGraph(std::move(graph), previous->landmarks, nullptr);
+    return true;
+}
+
+bool TransportNetwork::CloseStation(const Id& station) {
+    const auto stationId = stationIds_.Find(station);
+    if (stationId == kInvalidIdHandle
+        || (!closedStations_.empty() && closedStations_[stationId] != 0)) {
+        return false;
+    }
+    closedStations_.resize(stationIds_.Size(), 0);
+    closedStations_[stationId] = 1;
+    const auto previous = GetSnapshot();
+    auto graph = std::make_shared<CompactGraph>(*previous->graph);
+    graph->closedStations_ = closedStations_;
+    // A cached journey still holds if it only runs through the station.
+    PublishGraph(std::move(graph), previous->landmarks, [&station](const TravelRoute& route) {
+        if (route.startStationId == station || route.endStationId == station) {
+            return false;
+        }
+        for (size_t idx = 1; idx < route.steps.size(); ++idx) {
+            if (route.steps[idx].startStationId == station
+                && route.steps[idx].routeId != route.steps[idx - 1].routeId) {
+                return false;
+            }
         }
+        return true;
+    });
+    return true;
+}
+
+bool TransportNetwork::ReopenStation(const Id& station) {
+    const auto stationId = stationIds_.Find(station);
+    if (stationId == kInvalidIdHandle
+        || closedStations_.empty()
+        || closedStations_[stationId] == 0) {
+        return false;
+    }
+    closedStations_[stationId] = 0;
+    if (std::all_of(closedStations_.begin(), closedStations_.end(), [](uint8_t closed) {
+            return closed == 0;
+        })) {
+        // Queries skip the closure checks.
+        closedStations_.clear();
     }
+    const auto previous = GetSnapshot();
+    auto graph = std::make_shared<CompactGraph>(*previous->graph);
+    graph->closedStations_ = closedStations_;
+    PublishGraph(std::move(graph), previous->landmarks, nullptr);
+    return true;
+}
 
-    success = true;
-    for (auto it = src["travel_times"].begin(); it != src["travel_times"].end(); it++) {
-        success |= SetTravelTime(
-            (*it)["start_station_id"].template get<std::string>(),
-            (*it)["end_station_id"].template get<std::string>(),
-            (*it)["travel_time"]);
+bool TransportNetwork::SetEdgeTravelTime(
+    IdHandle stationA,
+    IdHandle stationB,
+    const unsigned int travelTime) {
+    LoadPendingEdges();
+    const auto edgeIdx = stationNodes_[stationA].GetEdge(stationB);
+    if (edgeIdx == CompactGraph::kNoIndex) {
+        return false;
     }
+    edges_[edgeIdx].travelTime_ = travelTime;
+    return true;
+}
 
-    return success;
+unsigned int TransportNetwork::GetTravelTime(
+        const Id& stationA,
+        const Id& stationB) const {
+    const auto snapshot = GetSnapshot();
+    const auto stationIdA = snapshot->stationIds->Find(stationA);
+    const auto stationIdB = snapshot->stationIds->Find(stationB);
+    if (stationIdA == kInvalidIdHandle
+        || stationIdB == kInvalidIdHandle
+        || stationIdA == stationIdB) {
+        return 0;
+    }
+    return std::max(
+        GetEdgeTravelTime(*snapshot->graph, stationIdA, stationIdB),
+        GetEdgeTravelTime(*snapshot->graph, stationIdB, stationIdA));
+}
+    
+unsigned int TransportNetwork::GetTravelTime(
+    const Id& line,
+    const Id& route,
+    const Id& stationA,
+    const Id& stationB) const {
+    const auto snapshot = GetSnapshot();
+    const auto& graph = *snapshot->graph;
+    const auto routeId = snapshot->routeIds->Find(route);
+    const auto stationIdA = snapshot->stationIds->Find(stationA);
+    const auto stationIdB = snapshot->stationIds->Find(stationB);
+    if (routeId == kInvalidIdHandle
+        || graph.routeLines_[routeId] != snapshot->lineIds->Find(line)
+        || stationIdA == kInvalidIdHandle
+        || stationIdB == kInvalidIdHandle) {
+        return 0;
+    }
+    return graph.GetRouteTravelTime(routeId, stationIdA, stationIdB);
 }
 
 TravelRoute TransportNetwork::GetOptimalTravelRoute(
+        const NetworkSnapshot& snapshot,
         const Id& stationA,
         const Id& stationB,
-        bool useDistance) const {
+        const RouteProfile& profile,
+        RouteSearchMode mode,
+        RouteSearchStats* stats) const {
     TravelRoute route;
     route.startStationId = stationA;
     route.endStationId = stationB;
@@ -315,90 +1224,518 @@ TravelRoute TransportNetwork::GetOptimalTravelRoute(
         }};
         return route;
     }
-    std::unordered_map<GraphStop, unsigned int, GraphStopHash, GraphStopEqual> metricFromA;
-    std::unordered_map<GraphStop, unsigned int, GraphStopHash, GraphStopEqual> distanceFromA;
-    std::unordered_map<GraphStop, GraphStop, GraphStopHash, GraphStopEqual> stationIdToParent;
-    metricFromA[{stationA, {}, {}}] = 0;
-    distanceFromA[{stationA, {}, {}}] = 0;
-    std::priority_queue<
-        GraphStopMetric,
-        std::deque<GraphStopMetric>,
-        std::greater<GraphStopMetric>> nodesToVisit;
-    nodesToVisit.push({{stationA, {}, {}}, 0});
-
-    while (!nodesToVisit.empty()) {
-        const auto currentStop = nodesToVisit.top().graphStop;
-        const auto metric = nodesToVisit.top().metric;
-        nodesToVisit.pop();
-
-        // get neighbors
-        auto stationNode = GetStationNode(currentStop.stationId);
-        for (const auto& [neighborId, routesMetadata] : stationNode->GetStationIdToRoutesMetadata()) {
-            // get routes
-            for (const auto& routeMetadata : routesMetadata) {
-                const GraphStop neighborStop {neighborId, routeMetadata.routeId, routeMetadata.lineId};
-                unsigned int neighborMetric = metric + (useDistance ? routeMetadata.travelTime : GetPassengerCount(neighborId));
-                unsigned int neighborDistance = distanceFromA[currentStop] + routeMetadata.travelTime;
-                if (currentStop.routeId.has_value()
-                    && currentStop.routeId.value() != routeMetadata.routeId
-                    && currentStop.lineId.value() != routeMetadata.lineId) {
-                    neighborMetric += useDistance ? penalty_ : GetPassengerCount(neighborId);
-                    neighborDistance += penalty_;
-                }
-                if (metricFromA.find(neighborStop) == metricFromA.end() 
-                    || neighborMetric < metricFromA[neighborStop]) {
-                    stationIdToParent[neighborStop] = currentStop;
-                    metricFromA[neighborStop] = neighborMetric;
-                    nodesToVisit.push({neighborStop, neighborMetric});
-                    distanceFromA[neighborStop] = neighborDistance;
-                }
-            }
-        }
-    }
-
-    std::vector<GraphStopMetric> pathsToB {};
-    for (const auto& [stop, metric]: metricFromA) {
-        if (stop.stationId == stationB) {
-            pathsToB.push_back({stop, metric});
-        }
+    const auto stationIdA = snapshot.stationIds->Find(stationA);
+    const auto stationIdB = snapshot.stationIds->Find(stationB);
+    if (stationIdA == kInvalidIdHandle
+        || stationIdB == kInvalidIdHandle
+        || snapshot.graph->IsClosed(stationIdA)
+        || snapshot.graph->IsClosed(stationIdB)) {
+        return route;
     }
-
-    if (pathsToB.empty()) {
+    auto& workspace = routingWorkspace;
+    const bool found = FindOptimalPath(
+        snapshot,
+        stationIdA,
+        stationIdB,
+        profile,
+        mode,
+        stats,
+        workspace.pathStates_,
+        workspace.pathDistances_);
+    if (!found) {
         return route;
     }
+    return MakeTravelRoute(
+        snapshot, stationA, stationB, workspace.pathStates_, workspace.pathDistances_);
+}
 
-    std::sort(pathsToB.begin(), pathsToB.end(), std::less<GraphStopMetric>());
+bool TransportNetwork::FindOptimalPath(
+        const NetworkSnapshot& snapshot,
+        IdHandle stationA,
+        IdHandle stationB,
+        const RouteProfile& profile,
+        RouteSearchMode mode,
+        RouteSearchStats* stats,
+        std::vector<uint32_t>& states,
+        std::vector<unsigned int>& distances) const {
+    const auto& graph = *snapshot.graph;
+    const auto* landmarks = snapshot.landmarks.get();
+    const auto* hierarchy = snapshot.hierarchy.get();
+    const RouteCostModel costs {profile, penalty_, snapshot.passengers.get()};
+    auto& workspace = routingWorkspace;
+    auto& backward = backwardRoutingWorkspace;
+    const bool isFastest = profile.kind == RouteProfile::Kind::kFastest;
+    if (mode == RouteSearchMode::kAStar && (!isFastest || landmarks == nullptr)) {
+        // The lower bounds are on travel times, and must be up to date.
+        mode = RouteSearchMode::kDijkstra;
+    }
+    if (mode == RouteSearchMode::kContractionHierarchy && (!isFastest || hierarchy == nullptr)) {
+        mode = RouteSearchMode::kDijkstra;
+    }
+    uint32_t lastState = CompactGraph::kNoIndex;
+    switch (mode) {
+    case RouteSearchMode::kDijkstra:
+        lastState = SearchRoutes(graph, stationA, stationB, costs, workspace);
+        break;
+    case RouteSearchMode::kBidirectional:
+        lastState = SearchRoutesBidirectional(
+            graph, stationA, stationB, costs, workspace, backward);
+        break;
+    case RouteSearchMode::kAStar:
+        lastState = SearchRoutesAStar(
+            graph, *landmarks, stationA, stationB, costs, workspace);
+        break;
+    case RouteSearchMode::kContractionHierarchy:
+        lastState = hierarchy->Search(graph, stationA, stationB, workspace, backward);
+        break;
+    }
+    const bool bothEnds = mode == RouteSearchMode::kBidirectional
+        || mode == RouteSearchMode::kContractionHierarchy;
+    if (stats != nullptr) {
+        stats->settledStates = workspace.settledStates_
+            + (bothEnds ? backward.settledStates_ : 0);
+    }
+    if (lastState == CompactGraph::kNoIndex) {
+        return false;
+    }
+    if (mode == RouteSearchMode::kContractionHierarchy) {
+        hierarchy->ExtractPath(workspace, backward, lastState, states, distances);
+    } else {
+        ExtractPath(workspace, bothEnds ? &backward : nullptr, lastState, states, distances);
+    }
+    return true;
+}
 
-    for (auto currentStop = pathsToB[0].graphStop;
-            currentStop.stationId != stationA;
-            currentStop = stationIdToParent[currentStop]) {
+TravelRoute TransportNetwork::MakeTravelRoute(
+        const NetworkSnapshot& snapshot,
+        const Id& stationA,
+        const Id& stationB,
+        const std::vector<uint32_t>& states,
+        const std::vector<unsigned int>& distances) const {
+    // Strings are only materialized here, at the API boundary.
+    const auto& graph = *snapshot.graph;
+    TravelRoute route;
+    route.startStationId = stationA;
+    route.endStationId = stationB;
+    route.steps.reserve(states.size() - 1);
+    for (size_t idx = 1; idx < states.size(); ++idx) {
+        const auto routeId = graph.stateRoutes_[states[idx]];
         route.steps.push_back({
-            stationIdToParent[currentStop].stationId,
-            currentStop.stationId,
-            currentStop.lineId.value(),
-            currentStop.routeId.value(),
-            distanceFromA[currentStop]-distanceFromA[stationIdToParent[currentStop]]
+            snapshot.stationIds->Get(graph.stateStations_[states[idx - 1]]),
+            snapshot.stationIds->Get(graph.stateStations_[states[idx]]),
+            snapshot.lineIds->Get(graph.routeLines_[routeId]),
+            snapshot.routeIds->Get(routeId),
+            distances[idx] - distances[idx - 1]
         });
     }
-    route.totalTravelTime = distanceFromA[pathsToB[0].graphStop];
-    std::reverse(route.steps.begin(), route.steps.end());
+    route.totalTravelTime = distances.back();
+    return route;
+}
+
+TravelRoute TransportNetwork::GetEarliestArrivalRoute(
+        const Id& stationA,
+        const Id& stationB,
+        unsigned int departureTime,
+        RouteSearchStats* stats) const {
+    const auto snapshot = GetSnapshot();
+    const auto& graph = *snapshot->graph;
+    TravelRoute route;
+    route.startStationId = stationA;
+    route.endStationId = stationB;
+    const auto stationIdA = snapshot->stationIds->Find(stationA);
+    const auto stationIdB = snapshot->stationIds->Find(stationB);
+    if (stationIdA == kInvalidIdHandle
+        || stationIdB == kInvalidIdHandle
+        || graph.IsClosed(stationIdA)
+        || graph.IsClosed(stationIdB)) {
+        return route;
+    }
+    if (stationIdA == stationIdB) {
+        route.steps = {{stationA, stationA, {}, {}, 0u}};
+        return route;
+    }
+    auto& workspace = timetableWorkspace;
+    auto label = SearchEarliestArrival(
+        graph,
+        *snapshot->timetable,
+        stationIdA,
+        stationIdB,
+        departureTime,
+        penalty_,
+        kMaxTimetableTrips,
+        workspace);
+    if (stats != nullptr) {
+        stats->settledStates = workspace.scannedStops_;
+    }
+    if (label == CompactGraph::kNoIndex) {
+        return route;
+    }
+
+    // Unwind the trips, last first.
+    std::vector<TimetableWorkspace::Label> trips;
+    for (; label != CompactGraph::kNoIndex; label = workspace.labels_[label].boardLabel) {
+        trips.push_back(workspace.labels_[label]);
+    }
+    // Strings are only materialized here, at the API boundary.
+    auto arrival = departureTime;
+    for (auto trip = trips.rbegin(); trip != trips.rend(); ++trip) {
+        const auto firstStop = graph.routeStopOffsets_[trip->route];
+        const auto& lineId = snapshot->lineIds->Get(graph.routeLines_[trip->route]);
+        const auto& routeId = snapshot->routeIds->Get(trip->route);
+        // The wait for the trip counts in its first step.
+        auto wait = trip->tripDeparture
+            + graph.routeStopTimes_[firstStop + trip->boardPosition]
+            - arrival;
+        for (auto stop = firstStop + trip->boardPosition + 1;
+                stop <= firstStop + trip->alightPosition;
+                ++stop) {
+            route.steps.push_back({
+                snapshot->stationIds->Get(graph.routeStops_[stop - 1]),
+                snapshot->stationIds->Get(graph.routeStops_[stop]),
+                lineId,
+                routeId,
+                graph.routeStopTimes_[stop] - graph.routeStopTimes_[stop - 1] + wait,
+            });
+            wait = 0;
+        }
+        arrival = trip->arrival;
+    }
+    route.totalTravelTime = arrival - departureTime;
     return route;
 }
 
 TravelRoute TransportNetwork::GetFastestTravelRoute(
         const Id& stationA,
-        const Id& stationB) const {
-    return GetOptimalTravelRoute(stationA, stationB, true);
+        const Id& stationB,
+        RouteSearchMode mode,
+        RouteSearchStats* stats) const {
+    const auto snapshot = GetSnapshot();
+    const auto routeCache = std::atomic_load(&routeCache_);
+    const RouteCache::Key key {
+        snapshot->stationIds->Find(stationA),
+        snapshot->stationIds->Find(stationB),
+        mode
+    };
+    if (stats != nullptr
+        || routeCache == nullptr
+        || key.stationA == kInvalidIdHandle
+        || key.stationB == kInvalidIdHandle) {
+        return GetOptimalTravelRoute(*snapshot, stationA, stationB, kFastestProfile, mode, stats);
+    }
+    if (auto cached = routeCache->Find(key, snapshot->version)) {
+        return std::move(*cached);
+    }
+    auto route = GetOptimalTravelRoute(*snapshot, stationA, stationB, kFastestProfile, mode, stats);
+    routeCache->Insert(key, snapshot->version, route);
+    return route;
+}
+
+std::vector<TravelRoute> TransportNetwork::GetFastestTravelRoutes(
+        const std::vector<std::pair<Id, Id>>& queries,
+        unsigned int nThreads,
+        RouteSearchStats* stats) const {
+    const auto snapshot = GetSnapshot();
+    const auto& graph = *snapshot->graph;
+    std::vector<TravelRoute> routes(queries.size());
+
+    // The queries to search for, grouped by origin. The others are answered
+    // on the spot, as GetOptimalTravelRoute would.
+    // (origin, destination, query index)
+    std::vector<std::tuple<IdHandle, IdHandle, uint32_t>> searches;
+    searches.reserve(queries.size());
+    for (uint32_t idx = 0; idx < queries.size(); ++idx) {
+        const auto& [stationA, stationB] = queries[idx];
+        const auto stationIdA = snapshot->stationIds->Find(stationA);
+        const auto stationIdB = snapshot->stationIds->Find(stationB);
+        if (stationA == stationB
+            || stationIdA == kInvalidIdHandle
+            || stationIdB == kInvalidIdHandle
+            || graph.IsClosed(stationIdA)
+            || graph.IsClosed(stationIdB)) {
+            routes[idx] = GetOptimalTravelRoute(*snapshot, stationA, stationB, kFastestProfile);
+        } else {
+            searches.emplace_back(stationIdA, stationIdB, idx);
+        }
+    }
+    std::sort(searches.begin(), searches.end());
+    std::vector<size_t> groupOffsets;
+    for (size_t idx = 0; idx < searches.size(); ++idx) {
+        if (idx == 0 || std::get<0>(searches[idx]) != std::get<0>(searches[idx - 1])) {
+            groupOffsets.push_back(idx);
+        }
+    }
+    groupOffsets.push_back(searches.size());
+    const auto nGroups = groupOffsets.size() - 1;
+
+    // Each worker searches whole groups, with the workspace of its thread,
+    // and writes the routes of distinct queries.
+    const RouteCostModel costs {kFastestProfile, penalty_, snapshot->passengers.get()};
+    std::atomic<size_t> nextGroup {0};
+    std::atomic<size_t> settledStates {0};
+    auto worker = [&](unsigned int) {
+        auto& workspace = routingWorkspace;
+        for (auto group = nextGroup++; group < nGroups; group = nextGroup++) {
+            const auto first = searches.begin() + groupOffsets[group];
+            const auto last = searches.begin() + groupOffsets[group + 1];
+            // The destinations are sorted: a single one stops the search
+            // early.
+            const auto target = std::get<1>(*first) == std::get<1>(*(last - 1))
+                ? std::get<1>(*first)
+                : kInvalidIdHandle;
+            SearchRoutes(graph, std::get<0>(*first), target, costs, workspace);
+            settledStates += workspace.settledStates_;
+            for (auto it = first; it != last; ++it) {
+                const auto& [stationA, stationB] = queries[std::get<2>(*it)];
+                auto& route = routes[std::get<2>(*it)];
+                const auto lastState = FindBestState(graph, workspace, std::get<1>(*it));
+                if (lastState == CompactGraph::kNoIndex) {
+                    route.startStationId = stationA;
+                    route.endStationId = stationB;
+                    continue;
+                }
+                ExtractPath(
+                    workspace, nullptr, lastState, workspace.pathStates_, workspace.pathDistances_);
+                route = MakeTravelRoute(
+                    *snapshot, stationA, stationB, workspace.pathStates_, workspace.pathDistances_);
+            }
+        }
+    };
+    nThreads = static_cast<unsigned int>(
+        std::min<size_t>(GetThreadCount(nThreads), std::max<size_t>(nGroups, 1)));
+    RunOnThreads(nThreads, worker);
+    if (stats != nullptr) {
+        stats->settledStates = settledStates;
+    }
+    return routes;
+}
+
+TravelRoute TransportNetwork::GetTravelRoute(
+        const Id& stationA,
+        const Id& stationB,
+        const std::string& profile,
+        RouteSearchMode mode,
+        RouteSearchStats* stats) const {
+    const auto routeProfiles = std::atomic_load(&routeProfiles_);
+    const auto it = routeProfiles->find(profile);
+    if (it == routeProfiles->end()) {
+        TravelRoute route;
+        route.startStationId = stationA;
+        route.endStationId = stationB;
+        return route;
+    }
+    return GetOptimalTravelRoute(*GetSnapshot(), stationA, stationB, it->second, mode, stats);
+}
+
+bool TransportNetwork::AddRouteProfile(const std::string& name, const RouteProfile& profile) {
+    // Queries keep reading the profiles they loaded while the copy is made.
+    auto routeProfiles = std::make_shared<std::unordered_map<std::string, RouteProfile>>(
+        *std::atomic_load(&routeProfiles_));
+    if (!routeProfiles->emplace(name, profile).second) {
+        return false;
+    }
+    std::atomic_store(
+        &routeProfiles_,
+        std::shared_ptr<const std::unordered_map<std::string, RouteProfile>> {
+            std::move(routeProfiles)
+        });
+    return true;
 }
 
 TravelRoute TransportNetwork::GetQuietTravelRoute(
         const Id& stationA,
-        const Id& stationB) const {
-    auto fastestRoute = GetOptimalTravelRoute(stationA, stationB, true);
-    auto quietestRoute = GetOptimalTravelRoute(stationA, stationB, false);
-    return fastestRoute.totalTravelTime * 1.2 > static_cast<double>(quietestRoute.totalTravelTime)
-        ? quietestRoute 
-        : fastestRoute;
+        const Id& stationB,
+        RouteSearchStats* stats) const {
+    const auto snapshot = GetSnapshot();
+    const auto stationIdA = snapshot->stationIds->Find(stationA);
+    const auto stationIdB = snapshot->stationIds->Find(stationB);
+    if (stationA == stationB
+        || stationIdA == kInvalidIdHandle
+        || stationIdB == kInvalidIdHandle
+        || snapshot->graph->IsClosed(stationIdA)
+        || snapshot->graph->IsClosed(stationIdB)) {
+        return GetOptimalTravelRoute(*snapshot, stationA, stationB, kFastestProfile);
+    }
+    // The fastest journey bounds the search for a quieter one: it must be
+    // less crowded, and not too much slower.
+    auto& workspace = routingWorkspace;
+    const auto fastestMode = snapshot->hierarchy != nullptr
+        ? RouteSearchMode::kContractionHierarchy
+        : RouteSearchMode::kAStar;
+    RouteSearchStats fastestStats {};
+    const bool found = FindOptimalPath(
+        *snapshot,
+        stationIdA,
+        stationIdB,
+        kFastestProfile,
+        fastestMode,
+        &fastestStats,
+        workspace.pathStates_,
+        workspace.pathDistances_);
+    if (!found) {
+        if (stats != nullptr) {
+            *stats = fastestStats;
+        }
+        TravelRoute route;
+        route.startStationId = stationA;
+        route.endStationId = stationB;
+        return route;
+    }
+    const auto& graph = *snapshot->graph;
+    const RouteCostModel costs {
+        {RouteProfile::Kind::kQuietest}, penalty_, snapshot->passengers.get()
+    };
+    const auto label = SearchRoutesPareto(
+        graph,
+        stationIdA,
+        stationIdB,
+        costs,
+        workspace.pathDistances_.back() * kQuietRouteSlack,
+        GetPathMetric(graph, costs, workspace.pathStates_),
+        snapshot->landmarks.get(),
+        workspace);
+    if (stats != nullptr) {
+        stats->settledStates = fastestStats.settledStates + workspace.settledStates_;
+    }
+    if (label != CompactGraph::kNoIndex) {
+        ExtractLabelPath(workspace, label, workspace.pathStates_, workspace.pathDistances_);
+    }
+    return MakeTravelRoute(
+        *snapshot, stationA, stationB, workspace.pathStates_, workspace.pathDistances_);
+}
+
+std::vector<unsigned int> TransportNetwork::GetTravelTimesFrom(
+        const Id& station,
+        RouteSearchStats* stats) const {
+    std::vector<unsigned int> travelTimes;
+    FindTravelTimes(*GetSnapshot(), station, kUnreachable, stats, travelTimes);
+    return travelTimes;
+}
+
+std::vector<IdHandle> TransportNetwork::GetStationsWithin(
+        const Id& station,
+        unsigned int maxTravelTime,
+        RouteSearchStats* stats) const {
+    std::vector<unsigned int> travelTimes;
+    FindTravelTimes(*GetSnapshot(), station, maxTravelTime, stats, travelTimes);
+    std::vector<IdHandle> stations;
+    for (IdHandle stationId = 0; stationId < travelTimes.size(); ++stationId) {
+        if (travelTimes[stationId] != kUnreachable) {
+            stations.push_back(stationId);
+        }
+    }
+    std::stable_sort(stations.begin(), stations.end(), [&travelTimes](IdHandle lhs, IdHandle rhs) {
+        return travelTimes[lhs] < travelTimes[rhs];
+    });
+    return stations;
+}
+
+void TransportNetwork::FindTravelTimes(
+        const NetworkSnapshot& snapshot,
+        const Id& station,
+        unsigned int maxTravelTime,
+        RouteSearchStats* stats,
+        std::vector<unsigned int>& travelTimes) const {
+    const auto& graph = *snapshot.graph;
+    auto& workspace = routingWorkspace;
+    if (stats != nullptr) {
+        *stats = {};
+    }
+    const auto stationId = snapshot.stationIds->Find(station);
+    if (stationId == kInvalidIdHandle) {
+        travelTimes.clear();
+        return;
+    }
+    if (graph.IsClosed(stationId)) {
+        travelTimes.assign(graph.GetStationCount(), kUnreachable);
+        travelTimes[stationId] = 0;
+        return;
+    }
+    const RouteCostModel costs {kFastestProfile, penalty_, snapshot.passengers.get()};
+    SearchRoutes(graph, stationId, kInvalidIdHandle, costs, workspace, maxTravelTime);
+    if (stats != nullptr) {
+        stats->settledStates = workspace.settledStates_;
+    }
+    GetStationDistances(graph, workspace, maxTravelTime, travelTimes);
+    if (!graph.closedStations_.empty()) {
+        // Journeys run through closed stations, but cannot end there.
+        for (IdHandle closed = 0; closed < travelTimes.size(); ++closed) {
+            if (closed != stationId && graph.IsClosed(closed)) {
+                travelTimes[closed] = kUnreachable;
+            }
+        }
+    }
+}
+
+std::vector<TravelRoute> TransportNetwork::GetAlternativeTravelRoutes(
+        const Id& stationA,
+        const Id& stationB,
+        size_t count,
+        RouteSearchStats* stats) const {
+    const auto snapshot = GetSnapshot();
+    const auto& graph = *snapshot->graph;
+    std::vector<TravelRoute> routes;
+    if (stats != nullptr) {
+        *stats = {};
+    }
+    if (count == 0) {
+        return routes;
+    }
+    if (stationA == stationB) {
+        routes.push_back(GetOptimalTravelRoute(*snapshot, stationA, stationB, kFastestProfile));
+        return routes;
+    }
+    const auto stationIdA = snapshot->stationIds->Find(stationA);
+    const auto stationIdB = snapshot->stationIds->Find(stationB);
+    if (stationIdA == kInvalidIdHandle
+        || stationIdB == kInvalidIdHandle
+        || graph.IsClosed(stationIdA)
+        || graph.IsClosed(stationIdB)) {
+        return routes;
+    }
+    // The surcharges only ever add to the metric, so the landmark travel
+    // time lower bounds still hold.
+    auto& workspace = routingWorkspace;
+    auto& surcharges = workspace.edgeSurcharges_;
+    surcharges.assign(graph.edgeTargets_.size(), 0);
+    const RouteCostModel costs {kFastestProfile, penalty_, snapshot->passengers.get(), &surcharges};
+    const auto* landmarks = snapshot->landmarks.get();
+    // The states of each journey found, i.e. its (station, route) steps.
+    std::vector<std::vector<uint32_t>> journeys;
+    std::vector<IdHandle> stations;
+    for (size_t attempt = 0;
+            attempt < count * kAlternativeRouteAttempts && routes.size() < count;
+            ++attempt) {
+        const auto lastState = landmarks != nullptr
+            ? SearchRoutesAStar(graph, *landmarks, stationIdA, stationIdB, costs, workspace)
+            : SearchRoutes(graph, stationIdA, stationIdB, costs, workspace);
+        if (stats != nullptr) {
+            stats->settledStates += workspace.settledStates_;
+        }
+        if (lastState == CompactGraph::kNoIndex) {
+            // Surcharges never cut a journey off, so only the first search
+            // can find none.
+            return routes;
+        }
+        ExtractPath(workspace, nullptr, lastState, workspace.pathStates_, workspace.pathDistances_);
+        stations.clear();
+        for (const auto state : workspace.pathStates_) {
+            stations.push_back(graph.stateStations_[state]);
+        }
+        for (size_t idx = 1; idx < stations.size(); ++idx) {
+            const auto edge = graph.FindEdge(stations[idx - 1], stations[idx]);
+            surcharges[edge] += graph.edgeTravelTimes_[edge] / 2 + 1;
+        }
+        if (std::find(journeys.begin(), journeys.end(), workspace.pathStates_) != journeys.end()) {
+            continue;
+        }
+        journeys.push_back(workspace.pathStates_);
+        routes.push_back(MakeTravelRoute(
+            *snapshot, stationA, stationB, workspace.pathStates_, workspace.pathDistances_));
+    }
+    std::stable_sort(routes.begin(), routes.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.totalTravelTime < rhs.totalTravelTime;
+    });
+    return routes;
 }
 
 } // namespace NetworkMonitor
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include "network-monitor/travel-time-matrix.h"
+#include "network-monitor/transport-network.h"
+#include "network-monitor-internal/transport-network-internal.h"
+#include "network-monitor-internal/network-snapshot.h"
+#include "network-monitor-internal/parallel.h"
+#include "network-monitor-internal/routing-engine.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+    using NetworkMonitor::CompactGraph;
+    using NetworkMonitor::IdHandle;
+    using NetworkMonitor::RouteCostModel;
+    using NetworkMonitor::RoutingWorkspace;
+    using NetworkMonitor::TravelTimeMatrix;
+
+    // File layout, in native byte order:
+    // - MatrixFileHeader.
+    // - uint32_t travel times, nStations x nStations, row-major by origin.
+    // - uint32_t next stations, same layout.
+    // - uint32_t station ID offsets, nStations + 1.
+    // - The station IDs, back to back, in handle order.
+    constexpr char kMatrixMagic[8] {'N', 'M', 'T', 'T', 'M', 'A', 'T', 'X'};
+    constexpr uint32_t kMatrixVersion {1};
+
+    struct MatrixFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t nStations;
+        uint64_t fileSize;
+    };
+
+    constexpr size_t kMatrixOffset {sizeof(MatrixFileHeader)};
+
+    size_t GetNextStationsOffset(size_t nStations) {
+        return kMatrixOffset + nStations * nStations * sizeof(uint32_t);
+    }
+
+    size_t GetIdOffsetsOffset(size_t nStations) {
+        return GetNextStationsOffset(nStations) + nStations * nStations * sizeof(uint32_t);
+    }
+
+    size_t GetIdsOffset(size_t nStations) {
+        return GetIdOffsetsOffset(nStations) + (nStations + 1) * sizeof(uint32_t);
+    }
+
+    /*! \brief Fill the matrix rows of the `source` station.
+     *
+     *  `firstHops` is scratch space indexed by route state.
+     */
+    void FillMatrixRow(
+        const CompactGraph& graph,
+        IdHandle source,
+        const RouteCostModel& costs,
+        RoutingWorkspace& workspace,
+        std::vector<uint32_t>& firstHops,
+        std::vector<uint32_t>& chain,
+        uint32_t* travelTimes,
+        uint32_t* nextStations) {
+        const auto nStations = graph.GetStationCount();
+        NetworkMonitor::SearchRoutes(graph, source, NetworkMonitor::kInvalidIdHandle, costs, workspace);
+
+        // The first station of every journey is found once per state, by
+        // walking up the parents until a state whose first station is known.
+        firstHops.assign(graph.GetStateCount(), CompactGraph::kNoIndex);
+        for (IdHandle station = 0; station < nStations; ++station) {
+            auto state = NetworkMonitor::FindBestState(graph, workspace, station);
+            if (station == source || state == CompactGraph::kNoIndex) {
+                travelTimes[station] = station == source ? 0 : TravelTimeMatrix::kUnreachable;
+                nextStations[station] = NetworkMonitor::kInvalidIdHandle;
+                continue;
+            }
+            travelTimes[station] = workspace.distance_[state];
+            chain.clear();
+            while (firstHops[state] == CompactGraph::kNoIndex
+                   && workspace.parent_[state] != source) {
+                chain.push_back(state);
+                state = workspace.parent_[state];
+            }
+            const auto firstHop = firstHops[state] != CompactGraph::kNoIndex
+                ? firstHops[state]
+                : graph.stateStations_[state];
+            firstHops[state] = firstHop;
+            for (const auto visited : chain) {
+                firstHops[visited] = firstHop;
+            }
+            nextStations[station] = firstHop;
+        }
+    }
+
+    /*! \brief Map a file in memory.
+     *
+     *  \returns The mapping, or MAP_FAILED.
+     */
+    void* MapFile(
+        const std::filesystem::path& file,
+        bool writable,
+        size_t& size) {
+        const int fd = ::open(file.c_str(), writable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+        if (fd < 0) {
+            return MAP_FAILED;
+        }
+        void* mapping = MAP_FAILED;
+        struct stat info {};
+        if (writable) {
+            if (::ftruncate(fd, static_cast<off_t>(size)) == 0) {
+                mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+        } else if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            size = static_cast<size_t>(info.st_size);
+            mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        // The mapping stays valid after the descriptor is closed.
+        ::close(fd);
+        return mapping;
+    }
+}
+
+namespace NetworkMonitor {
+
+bool TransportNetwork::WriteTravelTimeMatrix(
+        const std::filesystem::path& file,
+        unsigned int nThreads) const {
+    // Travel times may change while the matrix is written: it is computed on
+    // one snapshot of the network throughout.
+    const auto snapshot = GetSnapshot();
+    const auto& graph = *snapshot->graph;
+    const auto& stationIds = *snapshot->stationIds;
+    const auto nStations = graph.GetStationCount();
+    uint32_t idsSize {0};
+    for (IdHandle station = 0; station < nStations; ++station) {
+        idsSize += static_cast<uint32_t>(stationIds.Get(station).size());
+    }
+    size_t fileSize = GetIdsOffset(nStations) + idsSize;
+
+    // The matrix is written next to the destination and moved in place once
+    // complete, so readers never map a partial file.
+    auto partialFile = file;
+    partialFile += ".partial";
+    void* mapping = MapFile(partialFile, true, fileSize);
+    if (mapping == MAP_FAILED) {
+        Log("Could not map " + partialFile.string(), "WriteTravelTimeMatrix");
+        std::error_code ec {};
+        std::filesystem::remove(partialFile, ec);
+        return false;
+    }
+    auto* data = static_cast<char*>(mapping);
+
+    MatrixFileHeader header {};
+    std::memcpy(header.magic, kMatrixMagic, sizeof(kMatrixMagic));
+    header.version = kMatrixVersion;
+    header.nStations = static_cast<uint32_t>(nStations);
+    header.fileSize = fileSize;
+    std::memcpy(data, &header, sizeof(header));
+    auto* idOffsets = reinterpret_cast<uint32_t*>(data + GetIdOffsetsOffset(nStations));
+    auto* ids = data + GetIdsOffset(nStations);
+    idOffsets[0] = 0;
+    for (IdHandle station = 0; station < nStations; ++station) {
+        const auto& id = stationIds.Get(station);
+        std::memcpy(ids + idOffsets[station], id.data(), id.size());
+        idOffsets[station + 1] = idOffsets[station] + static_cast<uint32_t>(id.size());
+    }
+
+    // One full search per origin station. The rows are independent, so the
+    // workers only share a counter and write straight into the mapping.
+    auto* travelTimes = reinterpret_cast<uint32_t*>(data + kMatrixOffset);
+    auto* nextStations = reinterpret_cast<uint32_t*>(data + GetNextStationsOffset(nStations));
+    const RouteCostModel costs {RouteProfile {}, penalty_, snapshot->passengers.get()};
+    std::atomic<size_t> nextSource {0};
+    auto worker = [&](unsigned int) {
+        RoutingWorkspace workspace;
+        std::vector<uint32_t> firstHops;
+        std::vector<uint32_t> chain;
+        for (auto source = nextSource++; source < nStations; source = nextSource++) {
+            FillMatrixRow(
+                graph,
+                static_cast<IdHandle>(source),
+                costs,
+                workspace,
+                firstHops,
+                chain,
+                travelTimes + source * nStations,
+                nextStations + source * nStations);
+        }
+    };
+    nThreads = static_cast<unsigned int>(
+        std::min<size_t>(GetThreadCount(nThreads), std::max<size_t>(nStations, 1)));
+    RunOnThreads(nThreads, worker);
+
+    const bool synced = ::msync(mapping, fileSize, MS_SYNC) == 0;
+    ::munmap(mapping, fileSize);
+    std::error_code ec {};
+    if (synced) {
+        std::filesystem::rename(partialFile, file, ec);
+    }
+    if (!synced || ec) {
+        Log("Could not write " + file.string(), "WriteTravelTimeMatrix");
+        std::filesystem::remove(partialFile, ec);
+        return false;
+    }
+    return true;
+}
+
+TravelTimeMatrix::TravelTimeMatrix() = default;
+
+TravelTimeMatrix::~TravelTimeMatrix() {
+    Close();
+}
+
+TravelTimeMatrix::TravelTimeMatrix(TravelTimeMatrix&& moved) noexcept {
+    *this = std::move(moved);
+}
+
+TravelTimeMatrix& TravelTimeMatrix::operator=(TravelTimeMatrix&& moved) noexcept {
+    if (this != &moved) {
+        Close();
+        mapping_ = std::exchange(moved.mapping_, nullptr);
+        mappingSize_ = std::exchange(moved.mappingSize_, 0);
+        nStations_ = std::exchange(moved.nStations_, 0);
+        travelTimes_ = std::exchange(moved.travelTimes_, nullptr);
+        nextStations_ = std::exchange(moved.nextStations_, nullptr);
+        stationIds_ = std::exchange(moved.stationIds_, {});
+    }
+    return *this;
+}
+
+bool TravelTimeMatrix::Open(const std::filesystem::path& file) {
+    Close();
+    size_t size {0};
+    void* mapping = MapFile(file, false, size);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    mapping_ = mapping;
+    mappingSize_ = size;
+    const auto* data = static_cast<const char*>(mapping);
+
+    MatrixFileHeader header {};
+    if (size < sizeof(header)) {
+        Close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    const size_t nStations = header.nStations;
+    if (std::memcmp(header.magic, kMatrixMagic, sizeof(kMatrixMagic)) != 0
+        || header.version != kMatrixVersion
+        || header.fileSize != size
+        || nStations * nStations > size
+        || GetIdsOffset(nStations) > size) {
+        Close();
+        return false;
+    }
+    const auto* idOffsets = reinterpret_cast<const uint32_t*>(data + GetIdOffsetsOffset(nStations));
+    const auto* ids = data + GetIdsOffset(nStations);
+    const auto idsSize = size - GetIdsOffset(nStations);
+    for (size_t station = 0; station < nStations; ++station) {
+        if (idOffsets[station] > idOffsets[station + 1] || idOffsets[station + 1] > idsSize) {
+            Close();
+            return false;
+        }
+        stationIds_.Intern(Id(ids + idOffsets[station], idOffsets[station + 1] - idOffsets[station]));
+    }
+    if (stationIds_.Size() != nStations) {
+        // Duplicate station IDs.
+        Close();
+        return false;
+    }
+    nStations_ = nStations;
+    travelTimes_ = reinterpret_cast<const uint32_t*>(data + kMatrixOffset);
+    nextStations_ = reinterpret_cast<const uint32_t*>(data + GetNextStationsOffset(nStations));
+    return true;
+}
+
+void TravelTimeMatrix::Close() {
+    if (mapping_ != nullptr) {
+        ::munmap(mapping_, mappingSize_);
+    }
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    nStations_ = 0;
+    travelTimes_ = nullptr;
+    nextStations_ = nullptr;
+    stationIds_ = {};
+}
+
+size_t TravelTimeMatrix::GetStationCount() const {
+    return nStations_;
+}
+
+IdHandle TravelTimeMatrix::GetStationHandle(const Id& stationId) const {
+    return stationIds_.Find(stationId);
+}
+
+const Id& TravelTimeMatrix::GetStationId(IdHandle station) const {
+    return stationIds_.Get(station);
+}
+
+unsigned int TravelTimeMatrix::GetTravelTime(
+        const Id& stationA,
+        const Id& stationB) const {
+    return GetTravelTime(stationIds_.Find(stationA), stationIds_.Find(stationB));
+}
+
+unsigned int TravelTimeMatrix::GetTravelTime(
+        IdHandle stationA,
+        IdHandle stationB) const {
+    if (stationA >= nStations_ || stationB >= nStations_) {
+        return kUnreachable;
+    }
+    return travelTimes_[stationA * nStations_ + stationB];
+}
+
+Id TravelTimeMatrix::GetNextStation(
+        const Id& stationA,
+        const Id& stationB) const {
+    const auto next = GetNextStation(stationIds_.Find(stationA), stationIds_.Find(stationB));
+    return next == kInvalidIdHandle ? Id {} : stationIds_.Get(next);
+}
+
+IdHandle TravelTimeMatrix::GetNextStation(
+        IdHandle stationA,
+        IdHandle stationB) const {
+    if (stationA >= nStations_ || stationB >= nStations_) {
+        return kInvalidIdHandle;
+    }
+    return nextStations_[stationA * nStations_ + stationB];
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,124 @@
+#include <network-monitor/live-network.h>
+#include <network-monitor/transport-network.h>
+
+#include <boost/asio.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+using NetworkMonitor::LiveNetwork;
+using NetworkMonitor::NetworkLoadStats;
+using NetworkMonitor::PassengerEvent;
+using NetworkMonitor::Station;
+using NetworkMonitor::TransportNetwork;
+
+namespace {
+    /*! \brief Write the test network, with one more station, as a layout
+     *         image.
+     */
+    std::filesystem::path WriteReloadedLayout() {
+        TransportNetwork nw {};
+        BOOST_REQUIRE(nw.FromJsonFile(TESTS_NETWORK_LAYOUT_JSON));
+        BOOST_REQUIRE(nw.AddStation(Station {"station_new", "New"}));
+        const auto file = std::filesystem::temp_directory_path() / "network-layout-reload.bin";
+        BOOST_REQUIRE(nw.WriteLayoutImage(file));
+        return file;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(network_monitor);
+
+BOOST_AUTO_TEST_SUITE(class_LiveNetwork);
+
+BOOST_AUTO_TEST_CASE(reload)
+{
+    using EventType = PassengerEvent::Type;
+    const auto file = WriteReloadedLayout();
+    boost::asio::io_context ioc {};
+    LiveNetwork live {ioc};
+    NetworkLoadStats stats {};
+    BOOST_REQUIRE(live.Load(TESTS_NETWORK_LAYOUT_JSON, stats));
+    const auto initial = live.GetNetwork();
+    live.QueuePassengerEvent({"station_000", EventType::In});
+    live.QueuePassengerEvent({"station_000", EventType::In});
+    ioc.run();
+    ioc.restart();
+    BOOST_CHECK_EQUAL(initial->GetPassengerCount("station_000"), 2);
+
+    bool reloaded {false};
+    std::thread::id reloadedOn {};
+    std::shared_ptr<const TransportNetwork> swappedIn {};
+    BOOST_REQUIRE(live.Reload(file.string(), [&](bool success) {
+        reloaded = success;
+        reloadedOn = std::this_thread::get_id();
+        swappedIn = live.GetNetwork();
+    }));
+    // One reload at a time.
+    BOOST_CHECK(!live.Reload(file.string()));
+    // The swap waits for the io_context, whenever the load is over.
+    BOOST_CHECK(live.GetNetwork() == initial);
+
+    // An event that arrives during the reload ends up on the new network:
+    // recorded before the swap and carried over, or recorded after it.
+    live.QueuePassengerEvent({"station_000", EventType::Out});
+    ioc.run();
+    ioc.restart();
+    BOOST_CHECK(reloaded);
+    BOOST_CHECK(reloadedOn == std::this_thread::get_id());
+    const auto network = live.GetNetwork();
+    BOOST_CHECK(network != initial);
+    BOOST_CHECK(swappedIn == network);
+    BOOST_CHECK_EQUAL(network->GetPassengerCount("station_000"), 1);
+    BOOST_CHECK_EQUAL(network->GetPassengerCount("station_new"), 0);
+
+    // A failed load leaves the current network in place, and another reload
+    // can run.
+    bool failed {false};
+    BOOST_REQUIRE(live.Reload((file.parent_path() / "no-such-layout.json").string(),
+        [&failed](bool success) {
+            failed = !success;
+        }));
+    ioc.run();
+    ioc.restart();
+    BOOST_CHECK(failed);
+    BOOST_CHECK(live.GetNetwork() == network);
+    BOOST_CHECK(live.Reload(file.string()));
+    ioc.run();
+    BOOST_CHECK(live.GetNetwork() != network);
+    BOOST_CHECK_EQUAL(live.GetNetwork()->GetPassengerCount("station_000"), 1);
+    std::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(events_across_swap)
+{
+    using EventType = PassengerEvent::Type;
+    const auto file = WriteReloadedLayout();
+    boost::asio::io_context ioc {};
+    LiveNetwork live {ioc};
+    NetworkLoadStats stats {};
+    BOOST_REQUIRE(live.Load(TESTS_NETWORK_LAYOUT_JSON, stats));
+    auto network = std::make_shared<TransportNetwork>();
+    BOOST_REQUIRE(LiveNetwork::LoadNetwork(*network, file.string(), stats));
+    std::filesystem::remove(file);
+
+    // The events wait in the pending batch while the swap runs, so they are
+    // recorded on the new network: station_new is not in the old one.
+    boost::asio::post(ioc, [&]() {
+        live.SwapNetwork(network, stats, std::chrono::steady_clock::now());
+    });
+    live.QueuePassengerEvent({"station_new", EventType::In});
+    live.QueuePassengerEvent({"station_000", EventType::In});
+    BOOST_CHECK(live.GetNetwork() != network);
+    ioc.run();
+    BOOST_REQUIRE(live.GetNetwork() == network);
+    BOOST_CHECK_EQUAL(network->GetPassengerCount("station_new"), 1);
+    BOOST_CHECK_EQUAL(network->GetPassengerCount("station_000"), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END(); // class_LiveNetwork
+
+BOOST_AUTO_TEST_SUITE_END(); // network_monitor
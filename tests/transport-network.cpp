@@ -1,21 +1,71 @@
 #include <network-monitor/transport-network.h>
+#include <network-monitor/travel-time-matrix.h>
 #include <transport-network-tester.h>
 
 #include <boost/test/unit_test.hpp>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <random>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 #include <iostream>
 
 using NetworkMonitor::Id;
+using NetworkMonitor::IdHandle;
 using NetworkMonitor::Line;
 using NetworkMonitor::PassengerEvent;
 using NetworkMonitor::Route;
+using NetworkMonitor::RouteProfile;
+using NetworkMonitor::RouteSearchMode;
+using NetworkMonitor::RouteSearchStats;
 using NetworkMonitor::Station;
 using NetworkMonitor::TransportNetwork;
+using NetworkMonitor::TravelTimeMatrix;
+using NetworkMonitor::kInvalidIdHandle;
+
+namespace {
+    /*! \brief Add a line with a single route through `stops`, both named
+     *         after `id`.
+     */
+    bool AddSingleRouteLine(TransportNetwork& nw, const Id& id, const std::vector<Id>& stops) {
+        Route route {
+            id + "_route", "inbound", id, stops.front(), stops.back(), stops,
+        };
+        return nw.AddLine({id, id, {route}});
+    }
+
+    /*! \brief Add stations A to E and three lines from station_A to
+     *         station_D.
+     *
+     *  line_fast:   A -5-> B -5-> D
+     *  line_medium: A -5-> C -6-> D
+     *  line_slow:   A -5-> E -20-> D
+     */
+    bool AddThreeWayNetwork(TransportNetwork& nw) {
+        bool ok {true};
+        for (const auto& id : {"station_A", "station_B", "station_C", "station_D", "station_E"}) {
+            ok &= nw.AddStation({id, id});
+        }
+        ok &= AddSingleRouteLine(nw, "line_fast", {"station_A", "station_B", "station_D"});
+        ok &= AddSingleRouteLine(nw, "line_medium", {"station_A", "station_C", "station_D"});
+        ok &= AddSingleRouteLine(nw, "line_slow", {"station_A", "station_E", "station_D"});
+        ok &= nw.SetTravelTime("station_A", "station_B", 5);
+        ok &= nw.SetTravelTime("station_B", "station_D", 5);
+        ok &= nw.SetTravelTime("station_A", "station_C", 5);
+        ok &= nw.SetTravelTime("station_C", "station_D", 6);
+        ok &= nw.SetTravelTime("station_A", "station_E", 5);
+        ok &= nw.SetTravelTime("station_E", "station_D", 20);
+        return ok;
+    }
+}
 
 BOOST_AUTO_TEST_SUITE(network_monitor);
 
@@ -287,6 +337,337 @@ BOOST_AUTO_TEST_CASE(basic)
     BOOST_CHECK_EQUAL(nw.GetPassengerCount(station2.id), -1);
 }
 
+BOOST_AUTO_TEST_CASE(handles)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    using EventType = PassengerEvent::Type;
+
+    const auto station = nw.GetStationHandle("station_000");
+    BOOST_REQUIRE_NE(station, NetworkMonitor::kInvalidIdHandle);
+    BOOST_CHECK_EQUAL(nw.GetStationHandle("station_42_not_there"), NetworkMonitor::kInvalidIdHandle);
+
+    bool ok = nw.RecordPassengerEvent(station, EventType::In);
+    BOOST_REQUIRE(ok);
+    ok = nw.RecordPassengerEvent({"station_000", EventType::In});
+    BOOST_REQUIRE(ok);
+    ok = nw.RecordPassengerEvent(station, EventType::Out);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(station), 1);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_000"), 1);
+
+    BOOST_CHECK(!nw.RecordPassengerEvent(NetworkMonitor::kInvalidIdHandle, EventType::In));
+    BOOST_CHECK_THROW(
+        nw.GetPassengerCount(NetworkMonitor::kInvalidIdHandle),
+        std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(batch)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    using EventType = PassengerEvent::Type;
+
+    nw.RecordPassengerEvent({"station_001", EventType::In});
+    const std::vector<PassengerEvent> events {
+        {"station_000", EventType::In},
+        {"station_001", EventType::Out},
+        {"station_42_not_there", EventType::In},
+        {"station_000", EventType::In},
+        {"station_002", EventType::In},
+        {"station_002", EventType::Out},
+        {"station_000", EventType::Out},
+        {"station_001", EventType::In},
+        {"station_001", EventType::In},
+    };
+    BOOST_CHECK_EQUAL(nw.RecordPassengerEvents(events), 1);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_000"), 1);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_001"), 2);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_002"), 0);
+
+    // A station whose delta went back to 0 in one batch still counts in the
+    // next one.
+    BOOST_CHECK_EQUAL(nw.RecordPassengerEvents({{"station_002", EventType::In}}), 0);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_002"), 1);
+    BOOST_CHECK_EQUAL(nw.RecordPassengerEvents({}), 0);
+}
+
+BOOST_AUTO_TEST_CASE(carry_over)
+{
+    using EventType = PassengerEvent::Type;
+    TransportNetwork nw {};
+    for (const auto& station : {"station_000", "station_001", "station_002"}) {
+        BOOST_REQUIRE(nw.AddStation({station, {}}));
+    }
+    nw.RecordPassengerEvents({
+        {"station_000", EventType::In},
+        {"station_000", EventType::In},
+        {"station_000", EventType::In},
+        {"station_001", EventType::Out},
+        {"station_002", EventType::In},
+    });
+
+    // A reloaded layout, with one station gone and one new, in another order.
+    TransportNetwork reloaded {};
+    for (const auto& station : {"station_new", "station_002", "station_000"}) {
+        BOOST_REQUIRE(reloaded.AddStation({station, {}}));
+    }
+    reloaded.RecordPassengerEvent({"station_002", EventType::In});
+    BOOST_CHECK_EQUAL(reloaded.AddPassengerCounts(nw), 1);
+    BOOST_CHECK_EQUAL(reloaded.GetPassengerCount("station_000"), 3);
+    BOOST_CHECK_EQUAL(reloaded.GetPassengerCount("station_002"), 2);
+    BOOST_CHECK_EQUAL(reloaded.GetPassengerCount("station_new"), 0);
+    const auto crowded = reloaded.GetMostCrowdedStations(2);
+    BOOST_REQUIRE_EQUAL(crowded.size(), 2);
+    BOOST_CHECK_EQUAL(crowded[0].stationId, "station_000");
+    BOOST_CHECK_EQUAL(crowded[1].stationId, "station_002");
+    // The source network is left as it is.
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_001"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(occupancy_history)
+{
+    using namespace std::chrono_literals;
+    using EventType = PassengerEvent::Type;
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+
+    // No history is kept by default.
+    BOOST_CHECK(nw.GetOccupancyHistoryHorizon() == 0s);
+    BOOST_CHECK_EQUAL(nw.GetPassengerFlow("station_000", 10s).entries, 0);
+    BOOST_CHECK(nw.GetBusiestStations(5, 10s).empty());
+
+    nw.SetOccupancyHistoryHorizon(60s);
+    BOOST_CHECK(nw.GetOccupancyHistoryHorizon() == 60s);
+    const auto now = std::chrono::system_clock::now();
+    for (int idx = 0; idx < 6; ++idx) {
+        nw.RecordPassengerEvent({"station_000", EventType::In, now - 30s});
+    }
+    nw.RecordPassengerEvent({"station_000", EventType::Out, now - 20s});
+    nw.RecordPassengerEvents({
+        {"station_001", EventType::In, now - 20s},
+        {"station_001", EventType::In, now - 5s},
+        {"station_000", EventType::Out, now - 5s},
+    });
+    // Older than the horizon: counted, but not in the history.
+    nw.RecordPassengerEvent({"station_002", EventType::In, now - 120s});
+    // Past 2106: counted, but not wrapped around into the current seconds.
+    nw.RecordPassengerEvents({{"station_002", EventType::In, now + (1ll << 32) * 1s}});
+
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_000"), 4);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_000", now - 40s), 0);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_000", now - 25s), 6);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_000", now - 10s), 5);
+    BOOST_CHECK_THROW(
+        nw.GetPassengerCount("station_000", now - 600s),
+        std::runtime_error);
+
+    auto flow = nw.GetPassengerFlow("station_000", 10s);
+    BOOST_CHECK_EQUAL(flow.entries, 0);
+    BOOST_CHECK_EQUAL(flow.exits, 1);
+    BOOST_CHECK_CLOSE(flow.exitsPerSecond, 0.1, 1e-9);
+    flow = nw.GetPassengerFlow("station_000", 3600s);
+    BOOST_CHECK_EQUAL(flow.entries, 6);
+    BOOST_CHECK_EQUAL(flow.exits, 2);
+    BOOST_CHECK_CLOSE(flow.entriesPerSecond, 0.1, 1e-9);
+
+    const auto busiest = nw.GetBusiestStations(2, 60s);
+    BOOST_REQUIRE_EQUAL(busiest.size(), 2);
+    BOOST_CHECK_EQUAL(busiest[0].stationId, "station_000");
+    BOOST_CHECK_EQUAL(busiest[0].count, 8);
+    BOOST_CHECK_EQUAL(busiest[1].stationId, "station_001");
+    BOOST_CHECK_EQUAL(busiest[1].count, 2);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_002"), 2);
+    BOOST_CHECK_EQUAL(nw.GetPassengerFlow("station_002", 60s).entries, 0);
+
+    // Slot indices would overflow.
+    BOOST_CHECK_THROW(
+        nw.SetOccupancyHistoryHorizon(std::chrono::hours {24 * 1000}),
+        std::runtime_error);
+    BOOST_CHECK(nw.GetOccupancyHistoryHorizon() == 60s);
+
+    // A copy keeps the history, but no longer shares it.
+    auto copy = nw;
+    copy.RecordPassengerEvent({"station_001", EventType::In});
+    BOOST_CHECK_EQUAL(copy.GetPassengerFlow("station_001", 60s).entries, 3);
+    BOOST_CHECK_EQUAL(nw.GetPassengerFlow("station_001", 60s).entries, 2);
+}
+
+BOOST_AUTO_TEST_CASE(most_crowded)
+{
+    using EventType = PassengerEvent::Type;
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    const auto layout = nlohmann::json::parse(std::ifstream {TESTS_NETWORK_LAYOUT_JSON});
+    std::vector<Id> stations;
+    for (const auto& station : layout["stations"]) {
+        stations.push_back(station["station_id"]);
+    }
+
+    auto checkMostCrowded = [&nw = nw, &stations](size_t k) {
+        std::vector<long long int> counts;
+        for (const auto& station : stations) {
+            counts.push_back(nw.GetPassengerCount(station));
+        }
+        std::sort(counts.begin(), counts.end(), std::greater<long long int> {});
+        const auto crowded = nw.GetMostCrowdedStations(k);
+        BOOST_REQUIRE_EQUAL(crowded.size(), k);
+        for (size_t idx = 0; idx < k; ++idx) {
+            BOOST_CHECK_EQUAL(crowded[idx].count, counts[idx]);
+            BOOST_CHECK_EQUAL(nw.GetPassengerCount(crowded[idx].stationId), crowded[idx].count);
+        }
+    };
+
+    // Nobody in the network yet.
+    checkMostCrowded(20);
+
+    // Skewed traffic, so that the ranking changes as events come in.
+    std::mt19937 rng {42};
+    for (size_t event = 0; event < 50000; ++event) {
+        const auto& station = stations[rng() % (1 + rng() % stations.size())];
+        nw.RecordPassengerEvent({station, rng() % 4 == 0 ? EventType::Out : EventType::In});
+        if (event % 5000 == 0) {
+            checkMostCrowded(20);
+        }
+    }
+    checkMostCrowded(1);
+    checkMostCrowded(20);
+    checkMostCrowded(200);
+
+    // Threads record on different shards, so a station can go above the
+    // ranking by events that each add to a different shard of its count.
+    std::vector<std::thread> recorders;
+    for (unsigned int seed = 0; seed < 4; ++seed) {
+        recorders.emplace_back([&nw = nw, &stations, seed]() {
+            std::mt19937 rng {seed};
+            for (size_t event = 0; event < 20000; ++event) {
+                const auto& station = stations[rng() % (1 + rng() % stations.size())];
+                nw.RecordPassengerEvent({station, EventType::In});
+            }
+        });
+    }
+    for (auto& recorder : recorders) {
+        recorder.join();
+    }
+    checkMostCrowded(20);
+    checkMostCrowded(64);
+
+    // Empty the most crowded stations: others take their place.
+    for (const auto& [station, count] : nw.GetMostCrowdedStations(30)) {
+        std::vector<PassengerEvent> exits(count, {station, EventType::Out});
+        nw.RecordPassengerEvents(exits);
+    }
+    checkMostCrowded(20);
+    checkMostCrowded(64);
+}
+
+BOOST_AUTO_TEST_CASE(most_crowded_across_threads)
+{
+    using EventType = PassengerEvent::Type;
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    const auto layout = nlohmann::json::parse(std::ifstream {TESTS_NETWORK_LAYOUT_JSON});
+    std::vector<Id> stations;
+    for (const auto& station : layout["stations"]) {
+        stations.push_back(station["station_id"]);
+    }
+    BOOST_REQUIRE_GT(stations.size(), 110);
+
+    // Ten crowded stations.
+    for (size_t idx = 0; idx < 10; ++idx) {
+        std::vector<PassengerEvent> entries(100, {stations[idx], EventType::In});
+        nw.RecordPassengerEvents(entries);
+    }
+    size_t nScanned {0};
+    BOOST_CHECK_EQUAL(nw.GetMostCrowdedStations(10, &nScanned).back().count, 100);
+    BOOST_CHECK_EQUAL(nScanned, 0);
+
+    // Passengers come in on one thread and go out on another, so the counts
+    // of each thread's shard grow apart while the stations stay near empty.
+    // More stations than are ranked, each with more entries than the crowded
+    // stations have passengers.
+    const size_t nEvents {15000};
+    std::atomic<size_t> turn {0};
+    auto record = [&nw = nw, &stations, &turn, nEvents](EventType type, size_t parity) {
+        for (size_t event = parity; event < 2 * nEvents; event += 2) {
+            while (turn.load() != event) {
+                std::this_thread::yield();
+            }
+            nw.RecordPassengerEvent({stations[10 + event / 2 % 100], type});
+            turn.store(event + 1);
+        }
+    };
+    std::thread entering {record, EventType::In, 0};
+    std::thread leaving {record, EventType::Out, 1};
+    entering.join();
+    leaving.join();
+
+    const auto crowded = nw.GetMostCrowdedStations(10, &nScanned);
+    BOOST_CHECK_EQUAL(nScanned, 0);
+    BOOST_REQUIRE_EQUAL(crowded.size(), 10);
+    for (const auto& [station, count] : crowded) {
+        BOOST_CHECK_EQUAL(count, 100);
+    }
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(stations[10]), 0);
+    nw.GetMostCrowdedStations(10, &nScanned);
+    BOOST_CHECK_EQUAL(nScanned, 0);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_queries)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    const Id stationA {"station_000"};
+    const Id stationB {"station_100"};
+
+    // The queries can only see the fastest route before or after the change.
+    const auto before = nw.GetFastestTravelRoute(stationA, stationB);
+    BOOST_REQUIRE(!before.steps.empty());
+    const auto& step = before.steps.front();
+    const auto stepTime = step.travelTime;
+    bool ok = nw.SetTravelTime(step.startStationId, step.endStationId, stepTime + 100);
+    BOOST_REQUIRE(ok);
+    const auto after = nw.GetFastestTravelRoute(stationA, stationB);
+    BOOST_REQUIRE_NE(after.totalTravelTime, before.totalTravelTime);
+
+    constexpr size_t nEvents {10000};
+    std::atomic<bool> done {false};
+    std::atomic<size_t> badRoutes {0};
+    std::atomic<size_t> failedEvents {0};
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < 2; ++idx) {
+        threads.emplace_back([&]() {
+            while (!done) {
+                const auto route = nw.GetFastestTravelRoute(stationA, stationB);
+                const auto quiet = nw.GetQuietTravelRoute(stationA, stationB);
+                if ((route.totalTravelTime != before.totalTravelTime
+                        && route.totalTravelTime != after.totalTravelTime)
+                    || quiet.steps.empty()) {
+                    ++badRoutes;
+                }
+            }
+        });
+    }
+    std::vector<std::thread> recorders;
+    for (size_t idx = 0; idx < 2; ++idx) {
+        recorders.emplace_back([&]() {
+            for (size_t event = 0; event < nEvents; ++event) {
+                if (!nw.RecordPassengerEvent({stationA, PassengerEvent::Type::In})) {
+                    ++failedEvents;
+                }
+            }
+        });
+    }
+    for (size_t idx = 0; idx < 100; ++idx) {
+        const auto travelTime = stepTime + (idx % 2 == 0 ? 0 : 100);
+        nw.SetTravelTime(step.startStationId, step.endStationId, travelTime);
+    }
+    for (auto& recorder : recorders) {
+        recorder.join();
+    }
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL(badRoutes, 0);
+    BOOST_CHECK_EQUAL(failedEvents, 0);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(stationA), 2 * nEvents);
+}
+
 BOOST_AUTO_TEST_SUITE_END(); // PassengerEvents
 
 BOOST_AUTO_TEST_SUITE(GetRoutesServingStation);
@@ -532,6 +913,67 @@ BOOST_AUTO_TEST_CASE(over_route)
     );
 }
 
+BOOST_AUTO_TEST_CASE(route_loop)
+{
+    // A -1-> B -2-> C -3-> A
+    TransportNetwork nw {};
+    bool ok {true};
+    for (const auto& id : {"station_A", "station_B", "station_C"}) {
+        ok &= nw.AddStation({id, id});
+    }
+    Route route {
+        "route_0", "inbound", "line_0", "station_A", "station_A",
+        {"station_A", "station_B", "station_C", "station_A"},
+    };
+    ok &= nw.AddLine({"line_0", "line_0", {route}});
+    ok &= nw.SetTravelTime("station_A", "station_B", 1);
+    ok &= nw.SetTravelTime("station_B", "station_C", 2);
+    ok &= nw.SetTravelTime("station_C", "station_A", 3);
+    BOOST_REQUIRE(ok);
+    const auto getTime = [&nw](const Id& stationA, const Id& stationB) {
+        return nw.GetTravelTime("line_0", "route_0", stationA, stationB);
+    };
+    BOOST_CHECK_EQUAL(getTime("station_A", "station_C"), 1 + 2);
+    BOOST_CHECK_EQUAL(getTime("station_C", "station_B"), 3 + 1);
+    BOOST_CHECK_EQUAL(getTime("station_B", "station_A"), 2 + 3);
+    BOOST_CHECK_EQUAL(getTime("station_A", "station_A"), 0);
+
+    ok = nw.SetTravelTime("station_B", "station_C", 5);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(getTime("station_A", "station_C"), 1 + 5);
+    BOOST_CHECK_EQUAL(getTime("station_C", "station_B"), 3 + 1);
+
+    ok = nw.SuspendRoute("line_0", "route_0");
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(getTime("station_A", "station_C"), 0);
+    ok = nw.ResumeRoute("line_0", "route_0");
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(getTime("station_A", "station_C"), 1 + 5);
+}
+
+BOOST_AUTO_TEST_CASE(json_route_travel_time)
+{
+    std::ifstream f(TESTS_NETWORK_LAYOUT_JSON);
+    const auto layout = nlohmann::json::parse(f);
+    TransportNetwork nw {};
+    bool ok = nw.FromJson(nlohmann::json(layout));
+    BOOST_REQUIRE(ok);
+
+    // The travel time along a route adds up the travel times of its hops.
+    for (const auto& line : layout["lines"]) {
+        for (const auto& route : line["routes"]) {
+            const auto stops = route["route_stops"].get<std::vector<Id>>();
+            unsigned int total {0};
+            for (size_t idx = 1; idx < stops.size(); ++idx) {
+                total += nw.GetTravelTime(stops[idx - 1], stops[idx]);
+                BOOST_CHECK_EQUAL(
+                    nw.GetTravelTime(line["line_id"], route["route_id"], stops[0], stops[idx]),
+                    total);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(json)
 {
     std::ifstream f(TESTS_NETWORK_LAYOUT_JSON);
@@ -540,11 +982,858 @@ BOOST_AUTO_TEST_CASE(json)
     BOOST_CHECK(ok);
 }
 
+BOOST_AUTO_TEST_CASE(json_file)
+{
+    auto [expected, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    TransportNetwork nw {};
+    NetworkMonitor::NetworkLoadStats stats {};
+    bool ok = nw.FromJsonFile(TESTS_NETWORK_LAYOUT_JSON, &stats);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK(stats.loadTime.count() > 0);
+    BOOST_CHECK(stats.peakMemory > 0);
+
+    // The layout lists the lines before the stations.
+    const std::vector<Id> stations {
+        "station_000", "station_042", "station_105", "station_198", "station_350",
+    };
+    for (const auto& stationA : stations) {
+        BOOST_CHECK(nw.GetRoutesServingStation(stationA)
+            == expected.GetRoutesServingStation(stationA));
+        for (const auto& stationB : stations) {
+            BOOST_CHECK_EQUAL(
+                nw.GetTravelTime(stationA, stationB),
+                expected.GetTravelTime(stationA, stationB));
+            BOOST_CHECK_EQUAL(
+                nw.GetFastestTravelRoute(stationA, stationB).totalTravelTime,
+                expected.GetFastestTravelRoute(stationA, stationB).totalTravelTime);
+        }
+    }
+
+    const auto file = std::filesystem::temp_directory_path() / "network-layout-test.json";
+    auto writeLayout = [&file](const std::string& layout) {
+        std::ofstream {file} << layout;
+    };
+    writeLayout(R"({
+        "travel_times": [{"start_station_id": "s0", "end_station_id": "s1", "travel_time": 3}],
+        "lines": [{"line_id": "l0", "routes": [{"route_stops": ["s0", "s1"], "route_id": "r0"}]}],
+        "stations": [{"station_id": "s0"}, {"station_id": "s1"}]
+    })");
+    TransportNetwork small {};
+    BOOST_REQUIRE(small.FromJsonFile(file));
+    BOOST_CHECK_EQUAL(small.GetTravelTime("s0", "s1"), 3);
+    BOOST_CHECK_EQUAL(small.GetTravelTime("l0", "r0", "s0", "s1"), 3);
+
+    writeLayout(R"({"stations": [{"station_id": "s0"}, {"station_id": "s0"}]})");
+    BOOST_CHECK_THROW(TransportNetwork {}.FromJsonFile(file), std::runtime_error);
+    writeLayout(R"({
+        "lines": [{"line_id": "l0", "routes": [{"route_id": "r0", "route_stops": ["s0", "s1"]}]}],
+        "stations": [{"station_id": "s0"}]
+    })");
+    BOOST_CHECK_THROW(TransportNetwork {}.FromJsonFile(file), std::runtime_error);
+    writeLayout(R"({"stations": [)");
+    BOOST_CHECK(!TransportNetwork {}.FromJsonFile(file));
+    std::filesystem::remove(file);
+    BOOST_CHECK(!TransportNetwork {}.FromJsonFile(file));
+}
+
+BOOST_AUTO_TEST_CASE(layout_image)
+{
+    TransportNetwork expected {};
+    BOOST_REQUIRE(expected.FromJsonFile(TESTS_NETWORK_LAYOUT_JSON));
+    BOOST_REQUIRE(expected.SetTravelTime("station_000", "station_001", 7));
+    const auto file = std::filesystem::temp_directory_path() / "network-layout-test.bin";
+    BOOST_REQUIRE(expected.WriteLayoutImage(file));
+    BOOST_CHECK(TransportNetwork::IsLayoutImage(file));
+    BOOST_CHECK(!TransportNetwork::IsLayoutImage(TESTS_NETWORK_LAYOUT_JSON));
+
+    TransportNetwork nw {};
+    NetworkMonitor::NetworkLoadStats stats {};
+    BOOST_REQUIRE(nw.FromLayoutImage(file, &stats));
+    BOOST_CHECK(stats.loadTime.count() > 0);
+    const std::vector<Id> stations {
+        "station_000", "station_001", "station_042", "station_105", "station_198", "station_350",
+    };
+    for (const auto& stationA : stations) {
+        BOOST_CHECK(nw.GetRoutesServingStation(stationA)
+            == expected.GetRoutesServingStation(stationA));
+        for (const auto& stationB : stations) {
+            BOOST_CHECK_EQUAL(
+                nw.GetTravelTime(stationA, stationB),
+                expected.GetTravelTime(stationA, stationB));
+            BOOST_CHECK(nw.GetFastestTravelRoute(stationA, stationB)
+                == expected.GetFastestTravelRoute(stationA, stationB));
+        }
+    }
+    // The loaded network can still change, like the one it was written from.
+    BOOST_CHECK(nw.SetTravelTime("station_000", "station_001", 2));
+    BOOST_CHECK_EQUAL(nw.GetTravelTime("station_000", "station_001"), 2);
+    BOOST_CHECK(nw.SuspendRoute("line_000", "route_000"));
+    BOOST_CHECK(nw.AddStation(Station {"station_new", "New"}));
+    BOOST_REQUIRE(expected.SetTravelTime("station_000", "station_001", 2));
+    BOOST_REQUIRE(expected.SuspendRoute("line_000", "route_000"));
+    BOOST_REQUIRE(expected.AddStation(Station {"station_new", "New"}));
+    for (const auto& stationA : stations) {
+        for (const auto& stationB : stations) {
+            BOOST_CHECK(nw.GetFastestTravelRoute(stationA, stationB)
+                == expected.GetFastestTravelRoute(stationA, stationB));
+        }
+    }
+    BOOST_CHECK(nw.ResumeRoute("line_000", "route_000"));
+    BOOST_REQUIRE(expected.ResumeRoute("line_000", "route_000"));
+    BOOST_CHECK(nw.GetFastestTravelRoute("station_000", "station_198")
+        == expected.GetFastestTravelRoute("station_000", "station_198"));
+
+    // Only into an empty network.
+    BOOST_CHECK(!nw.FromLayoutImage(file));
+
+    // Any damage fails the checksum or the header checks.
+    std::string image;
+    {
+        std::ifstream in {file, std::ios::binary};
+        image.assign(std::istreambuf_iterator<char> {in}, {});
+    }
+    auto writeImage = [&file](const std::string& data) {
+        std::ofstream {file, std::ios::binary | std::ios::trunc} << data;
+    };
+    auto corrupted = image;
+    corrupted[corrupted.size() / 2] ^= 1;
+    writeImage(corrupted);
+    BOOST_CHECK(!TransportNetwork {}.FromLayoutImage(file));
+    writeImage(image.substr(0, image.size() - 4));
+    BOOST_CHECK(!TransportNetwork {}.FromLayoutImage(file));
+    corrupted = image;
+    corrupted[8] += 1;
+    writeImage(corrupted);
+    BOOST_CHECK(!TransportNetwork {}.FromLayoutImage(file));
+    writeImage(image);
+    BOOST_CHECK(TransportNetwork {}.FromLayoutImage(file));
+    std::filesystem::remove(file);
+    BOOST_CHECK(!TransportNetwork {}.FromLayoutImage(file));
+}
+
+BOOST_AUTO_TEST_CASE(json_threads)
+{
+    const auto layout = nlohmann::json::parse(std::ifstream {TESTS_NETWORK_LAYOUT_JSON});
+    const auto dir = std::filesystem::temp_directory_path();
+    auto readImage = [&dir](unsigned int nThreads, const nlohmann::json& layout) {
+        TransportNetwork nw {};
+        BOOST_REQUIRE(nw.FromJson(nlohmann::json(layout), nThreads));
+        const auto file = dir / "network-layout-threads.bin";
+        BOOST_REQUIRE(nw.WriteLayoutImage(file));
+        std::ifstream in {file, std::ios::binary};
+        std::string image {std::istreambuf_iterator<char> {in}, {}};
+        std::filesystem::remove(file);
+        return image;
+    };
+    // The same network, down to its binary image, whatever the threads.
+    const auto serial = readImage(1, layout);
+    for (const unsigned int nThreads : {2u, 3u, 8u}) {
+        BOOST_CHECK(readImage(nThreads, layout) == serial);
+    }
+    TransportNetwork fromFile {};
+    BOOST_REQUIRE(fromFile.FromJsonFile(TESTS_NETWORK_LAYOUT_JSON));
+    TransportNetwork nw {};
+    BOOST_REQUIRE(nw.FromJson(nlohmann::json(layout), 4));
+    for (const auto& stationA : {"station_000", "station_042", "station_198"}) {
+        BOOST_CHECK(nw.GetRoutesServingStation(stationA)
+            == fromFile.GetRoutesServingStation(stationA));
+        for (const auto& stationB : {"station_001", "station_105", "station_350"}) {
+            BOOST_CHECK_EQUAL(
+                nw.GetTravelTime(stationA, stationB),
+                fromFile.GetTravelTime(stationA, stationB));
+            BOOST_CHECK_EQUAL(
+                nw.GetFastestTravelRoute(stationA, stationB).totalTravelTime,
+                fromFile.GetFastestTravelRoute(stationA, stationB).totalTravelTime);
+        }
+    }
+
+    // Errors are those of the first bad item, as when loading serially.
+    auto checkError = [](const char* layout, const std::string& error) {
+        for (const unsigned int nThreads : {1u, 4u}) {
+            try {
+                TransportNetwork {}.FromJson(nlohmann::json::parse(layout), nThreads);
+                BOOST_ERROR("no error");
+            } catch (const std::runtime_error& e) {
+                BOOST_CHECK_EQUAL(e.what(), error);
+            }
+        }
+    };
+    checkError(R"({"stations": [
+        {"station_id": "s0"}, {"station_id": "s1"}, {"station_id": "s0"}, {"station_id": "s1"}
+    ]})", "Unable to add station: s0");
+    checkError(R"({
+        "stations": [{"station_id": "s0"}, {"station_id": "s1"}, {"station_id": "s2"}],
+        "lines": [
+            {"line_id": "l0", "routes": [{"route_id": "r0", "route_stops": ["s0", "s1"]}]},
+            {"line_id": "l1", "routes": [{"route_id": "r1", "route_stops": ["s1", "s2", "s1", "s2"]}]},
+            {"line_id": "l2", "routes": [{"route_id": "r0", "route_stops": ["s0", "s1"]}]}
+        ]
+    })", "Unable to add line: l1");
+    checkError(R"({
+        "stations": [{"station_id": "s0"}, {"station_id": "s1"}],
+        "lines": [
+            {"line_id": "l0", "routes": [{"route_id": "r0", "route_stops": ["s0", "s1"]}]},
+            {"line_id": "l1", "routes": [{"route_id": "r1", "route_stops": ["s1", "s3"]}]},
+            {"line_id": "l2", "routes": [{"route_id": "r2", "route_stops": ["s2", "s0"]}]}
+        ]
+    })", "Unable to add line: l1");
+    for (const unsigned int nThreads : {1u, 4u}) {
+        BOOST_CHECK_THROW(
+            TransportNetwork {}.FromJson(nlohmann::json::parse(R"({
+                "stations": [{"station_id": "s0"}, {"station_id": 1}, {"station_id": "s0"}]
+            })"), nThreads),
+            nlohmann::json::exception);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_update_after_load)
+{
+    std::ifstream f(TESTS_NETWORK_LAYOUT_JSON);
+    TransportNetwork nw;
+    bool ok = nw.FromJson(nlohmann::json::parse(f));
+    BOOST_REQUIRE(ok);
+
+    BOOST_CHECK_EQUAL(nw.GetTravelTime("station_000", "station_001"), 2);
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime("line_000", "route_000", "station_000", "station_002"),
+        nw.GetTravelTime("station_000", "station_001")
+            + nw.GetTravelTime("station_001", "station_002")
+    );
+
+    // Travel times can still change once the network is loaded.
+    ok = nw.SetTravelTime("station_000", "station_001", 7);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(nw.GetTravelTime("station_000", "station_001"), 7);
+
+    // So can the topology.
+    ok = nw.AddStation({"station_new", "New Station"});
+    BOOST_REQUIRE(ok);
+    Route route {
+        "route_new",
+        "inbound",
+        "line_new",
+        "station_000",
+        "station_new",
+        {"station_000", "station_new"},
+    };
+    ok = nw.AddLine({"line_new", "New Line", {route}});
+    BOOST_REQUIRE(ok);
+    ok = nw.SetTravelTime("station_000", "station_new", 3);
+    BOOST_REQUIRE(ok);
+    auto travelRoute = nw.GetFastestTravelRoute("station_001", "station_new");
+    BOOST_REQUIRE_EQUAL(travelRoute.steps.size(), 2);
+    BOOST_CHECK_EQUAL(travelRoute.totalTravelTime, 7 + 3 + 5);
+    BOOST_CHECK_EQUAL(travelRoute.steps[1].routeId, "route_new");
+
+    // Unknown stations give an empty route.
+    travelRoute = nw.GetFastestTravelRoute("station_000", "station_42");
+    BOOST_CHECK(travelRoute.steps.empty());
+}
+
+BOOST_AUTO_TEST_CASE(json_repeated_queries)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    nw.SetRouteCacheCapacity(0);
+
+    // Route queries share scratch space: interleaving them must not leak
+    // state from one query into the next.
+    auto first = nw.GetFastestTravelRoute("station_000", "station_100");
+    BOOST_REQUIRE(!first.steps.empty());
+    auto other = nw.GetFastestTravelRoute("station_100", "station_000");
+    BOOST_REQUIRE(!other.steps.empty());
+    BOOST_CHECK(nw.GetFastestTravelRoute("station_000", "station_100") == first);
+    for (size_t idx = 1; idx < first.steps.size(); ++idx) {
+        BOOST_CHECK_EQUAL(first.steps[idx - 1].endStationId, first.steps[idx].startStationId);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_route_cache)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    nw.SetRouteCacheCapacity(1);
+
+    auto first = nw.GetFastestTravelRoute("station_000", "station_100");
+    BOOST_CHECK(nw.GetFastestTravelRoute("station_000", "station_100") == first);
+    auto stats = nw.GetRouteCacheStats();
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+    BOOST_CHECK_EQUAL(stats.misses, 1);
+    BOOST_CHECK_EQUAL(stats.size, 1);
+
+    // Another search mode is another entry, which evicts the first one.
+    nw.GetFastestTravelRoute("station_000", "station_100", RouteSearchMode::kBidirectional);
+    nw.GetFastestTravelRoute("station_000", "station_100");
+    stats = nw.GetRouteCacheStats();
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+    BOOST_CHECK_EQUAL(stats.misses, 3);
+    BOOST_CHECK_EQUAL(stats.evictions, 2);
+    BOOST_CHECK_EQUAL(stats.size, 1);
+
+    // Changing a travel time on the route invalidates it.
+    const auto& step = first.steps.front();
+    bool ok = nw.SetTravelTime(step.startStationId, step.endStationId, 100);
+    BOOST_REQUIRE(ok);
+    auto updated = nw.GetFastestTravelRoute("station_000", "station_100");
+    BOOST_CHECK_NE(updated.totalTravelTime, first.totalTravelTime);
+    stats = nw.GetRouteCacheStats();
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+    BOOST_CHECK_EQUAL(stats.misses, 4);
+
+    // A copy shares the cache, but not the entries of a network that changed.
+    auto copy = nw;
+    BOOST_CHECK(copy.GetFastestTravelRoute("station_000", "station_100") == updated);
+    ok = copy.SetTravelTime(step.startStationId, step.endStationId, 1);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_NE(
+        copy.GetFastestTravelRoute("station_000", "station_100").totalTravelTime,
+        updated.totalTravelTime);
+    BOOST_CHECK(nw.GetFastestTravelRoute("station_000", "station_100") == updated);
+
+    // Looking the route up on the older network leaves the entry of the
+    // newer one in place.
+    const auto hits = copy.GetRouteCacheStats().hits;
+    copy.GetFastestTravelRoute("station_000", "station_100");
+    BOOST_CHECK_EQUAL(copy.GetRouteCacheStats().hits, hits + 1);
+}
+
+BOOST_AUTO_TEST_CASE(quiet_route)
+{
+    TransportNetwork nw {};
+    BOOST_REQUIRE(AddThreeWayNetwork(nw));
+    const auto addPassengers = [&nw](const Id& station, int count) {
+        for (int idx = 0; idx < count; ++idx) {
+            nw.RecordPassengerEvent({station, PassengerEvent::Type::In});
+        }
+    };
+    addPassengers("station_B", 10);
+    addPassengers("station_C", 3);
+
+    // The quietest journey, through E, is too slow.
+    auto route = nw.GetQuietTravelRoute("station_A", "station_D");
+    BOOST_REQUIRE_EQUAL(route.steps.size(), 2);
+    BOOST_CHECK_EQUAL(route.steps[0].endStationId, "station_C");
+    BOOST_CHECK_EQUAL(route.totalTravelTime, 11);
+
+    // With no quiet journey in time, the fastest one is picked.
+    addPassengers("station_C", 10);
+    route = nw.GetQuietTravelRoute("station_A", "station_D");
+    BOOST_REQUIRE_EQUAL(route.steps.size(), 2);
+    BOOST_CHECK_EQUAL(route.steps[0].endStationId, "station_B");
+    BOOST_CHECK_EQUAL(route.totalTravelTime, 10);
+
+    BOOST_CHECK(nw.GetQuietTravelRoute("station_D", "station_A").steps.empty());
+    BOOST_CHECK(nw.GetQuietTravelRoute("station_A", "station_42").steps.empty());
+}
+
+BOOST_AUTO_TEST_CASE(alternative_routes)
+{
+    TransportNetwork nw {};
+    BOOST_REQUIRE(AddThreeWayNetwork(nw));
+
+    auto routes = nw.GetAlternativeTravelRoutes("station_A", "station_D", 2);
+    BOOST_REQUIRE_EQUAL(routes.size(), 2);
+    BOOST_CHECK(routes[0] == nw.GetFastestTravelRoute("station_A", "station_D"));
+    BOOST_CHECK_EQUAL(routes[1].steps[0].endStationId, "station_C");
+    BOOST_CHECK_EQUAL(routes[1].totalTravelTime, 11);
+
+    // There are only three journeys.
+    RouteSearchStats stats {};
+    routes = nw.GetAlternativeTravelRoutes("station_A", "station_D", 5, &stats);
+    BOOST_REQUIRE_EQUAL(routes.size(), 3);
+    BOOST_CHECK_EQUAL(routes[2].steps[0].endStationId, "station_E");
+    BOOST_CHECK_EQUAL(routes[2].totalTravelTime, 25);
+    BOOST_CHECK_GT(stats.settledStates, 0);
+
+    BOOST_CHECK_EQUAL(nw.GetAlternativeTravelRoutes("station_A", "station_A", 3).size(), 1);
+    BOOST_CHECK(nw.GetAlternativeTravelRoutes("station_A", "station_D", 0).empty());
+    BOOST_CHECK(nw.GetAlternativeTravelRoutes("station_A", "station_42", 3).empty());
+
+    // With no journey, only the first search runs.
+    RouteSearchStats unreachableStats {};
+    BOOST_CHECK(nw.GetAlternativeTravelRoutes("station_D", "station_A", 1, &unreachableStats).empty());
+    BOOST_CHECK(nw.GetAlternativeTravelRoutes("station_D", "station_A", 5, &stats).empty());
+    BOOST_CHECK_EQUAL(stats.settledStates, unreachableStats.settledStates);
+}
+
+BOOST_AUTO_TEST_CASE(json_alternative_routes)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    for (const auto& [from, to] : std::vector<std::pair<Id, Id>> {
+            {"station_000", "station_100"},
+            {"station_042", "station_198"},
+            {"station_100", "station_000"}}) {
+        const auto routes = nw.GetAlternativeTravelRoutes(from, to, 3);
+        BOOST_REQUIRE(!routes.empty());
+        BOOST_CHECK_LE(routes.size(), 3);
+        BOOST_CHECK_EQUAL(
+            routes[0].totalTravelTime,
+            nw.GetFastestTravelRoute(from, to).totalTravelTime);
+        for (size_t idx = 0; idx < routes.size(); ++idx) {
+            unsigned int total {0};
+            for (const auto& step : routes[idx].steps) {
+                total += step.travelTime;
+            }
+            BOOST_CHECK_EQUAL(total, routes[idx].totalTravelTime);
+            if (idx > 0) {
+                BOOST_CHECK_LE(routes[idx - 1].totalTravelTime, routes[idx].totalTravelTime);
+                BOOST_CHECK(!(routes[idx - 1] == routes[idx]));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(travel_times_from)
+{
+    // line_1: A -3-> B -3-> C
+    // line_2: B -2-> D
+    // Changing lines costs 5.
+    TransportNetwork nw {};
+    bool ok {true};
+    for (const auto& id : {"station_A", "station_B", "station_C", "station_D", "station_E"}) {
+        ok &= nw.AddStation({id, id});
+    }
+    BOOST_REQUIRE(ok);
+    ok &= AddSingleRouteLine(nw, "line_1", {"station_A", "station_B", "station_C"});
+    ok &= AddSingleRouteLine(nw, "line_2", {"station_B", "station_D"});
+    ok &= nw.SetTravelTime("station_A", "station_B", 3);
+    ok &= nw.SetTravelTime("station_B", "station_C", 3);
+    ok &= nw.SetTravelTime("station_B", "station_D", 2);
+    BOOST_REQUIRE(ok);
+
+    const auto at = [&nw](const std::vector<unsigned int>& times, const Id& station) {
+        return times[nw.GetStationHandle(station)];
+    };
+    RouteSearchStats stats {};
+    auto times = nw.GetTravelTimesFrom("station_A", &stats);
+    BOOST_REQUIRE_EQUAL(times.size(), 5);
+    BOOST_CHECK_EQUAL(at(times, "station_A"), 0);
+    BOOST_CHECK_EQUAL(at(times, "station_B"), 3);
+    BOOST_CHECK_EQUAL(at(times, "station_C"), 6);
+    BOOST_CHECK_EQUAL(at(times, "station_D"), 10);
+    BOOST_CHECK_EQUAL(at(times, "station_E"), TransportNetwork::kUnreachable);
+    BOOST_CHECK_GT(stats.settledStates, 0);
+    BOOST_CHECK(nw.GetTravelTimesFrom("station_42").empty());
+
+    auto stations = nw.GetStationsWithin("station_A", 6);
+    BOOST_REQUIRE_EQUAL(stations.size(), 3);
+    BOOST_CHECK_EQUAL(nw.GetStationId(stations[0]), "station_A");
+    BOOST_CHECK_EQUAL(nw.GetStationId(stations[1]), "station_B");
+    BOOST_CHECK_EQUAL(nw.GetStationId(stations[2]), "station_C");
+    BOOST_CHECK_EQUAL(nw.GetStationsWithin("station_A", 10).size(), 4);
+    BOOST_CHECK_EQUAL(nw.GetStationsWithin("station_C", 100).size(), 1);
+    BOOST_CHECK(nw.GetStationsWithin("station_42", 100).empty());
+    BOOST_CHECK_EQUAL(nw.GetStationId(kInvalidIdHandle), "");
+
+    // Journeys run through a closed station, but cannot end there.
+    BOOST_REQUIRE(nw.CloseStation("station_B"));
+    times = nw.GetTravelTimesFrom("station_A");
+    BOOST_CHECK_EQUAL(at(times, "station_B"), TransportNetwork::kUnreachable);
+    BOOST_CHECK_EQUAL(at(times, "station_C"), 6);
+    BOOST_CHECK_EQUAL(at(times, "station_D"), TransportNetwork::kUnreachable);
+}
+
+BOOST_AUTO_TEST_CASE(json_travel_times_from)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    const auto times = nw.GetTravelTimesFrom("station_042");
+    BOOST_REQUIRE(!times.empty());
+    for (IdHandle station = 0; station < times.size(); station += 7) {
+        const auto route = nw.GetFastestTravelRoute("station_042", nw.GetStationId(station));
+        if (route.steps.empty()) {
+            BOOST_CHECK_EQUAL(times[station], TransportNetwork::kUnreachable);
+        } else {
+            BOOST_CHECK_EQUAL(times[station], route.totalTravelTime);
+        }
+    }
+
+    const auto stations = nw.GetStationsWithin("station_042", 20);
+    BOOST_REQUIRE(!stations.empty());
+    BOOST_CHECK_EQUAL(times[stations.front()], 0);
+    BOOST_CHECK(std::find(
+        stations.begin(), stations.end(), nw.GetStationHandle("station_042")) != stations.end());
+    for (size_t idx = 0; idx < stations.size(); ++idx) {
+        BOOST_CHECK_LE(times[stations[idx]], 20);
+        if (idx > 0) {
+            BOOST_CHECK_LE(times[stations[idx - 1]], times[stations[idx]]);
+        }
+    }
+    const auto nWithin = std::count_if(times.begin(), times.end(), [](unsigned int time) {
+        return time <= 20;
+    });
+    BOOST_CHECK_EQUAL(stations.size(), static_cast<size_t>(nWithin));
+}
+
+BOOST_AUTO_TEST_CASE(route_profiles)
+{
+    // line_1: A -3-> B
+    // line_2: B -3-> C
+    // line_3: A -10-> D -10-> C
+    // Changing lines costs 5.
+    TransportNetwork nw {};
+    bool ok {true};
+    for (const auto& id : {"station_A", "station_B", "station_C", "station_D"}) {
+        ok &= nw.AddStation({id, id});
+    }
+    BOOST_REQUIRE(ok);
+    ok &= AddSingleRouteLine(nw, "line_1", {"station_A", "station_B"});
+    ok &= AddSingleRouteLine(nw, "line_2", {"station_B", "station_C"});
+    ok &= AddSingleRouteLine(nw, "line_3", {"station_A", "station_D", "station_C"});
+    ok &= nw.SetTravelTime("station_A", "station_B", 3);
+    ok &= nw.SetTravelTime("station_B", "station_C", 3);
+    ok &= nw.SetTravelTime("station_A", "station_D", 10);
+    ok &= nw.SetTravelTime("station_D", "station_C", 10);
+    BOOST_REQUIRE(ok);
+    for (int idx = 0; idx < 3; ++idx) {
+        nw.RecordPassengerEvent({"station_B", PassengerEvent::Type::In});
+    }
+
+    BOOST_CHECK(!nw.AddRouteProfile("fastest", {}));
+    BOOST_CHECK(nw.AddRouteProfile("no_transfers", {RouteProfile::Kind::kWeighted, 1, 100, 0}));
+    BOOST_CHECK(nw.AddRouteProfile("time_only", {RouteProfile::Kind::kWeighted, 1, 0, 0}));
+    for (const auto mode : {RouteSearchMode::kDijkstra, RouteSearchMode::kBidirectional}) {
+        const auto check = [&nw, mode](const std::string& profile, unsigned int time) {
+            const auto route = nw.GetTravelRoute("station_A", "station_C", profile, mode);
+            BOOST_CHECK_EQUAL(route.totalTravelTime, time);
+            BOOST_CHECK_EQUAL(route.steps.empty(), time == 0);
+        };
+        check("fastest", 11);
+        check("quietest", 20);
+        check("fewest_transfers", 20);
+        check("no_transfers", 20);
+        check("time_only", 11);
+        check("no_such_profile", 0);
+    }
+    BOOST_CHECK(nw.GetTravelRoute("station_A", "station_C", "fastest", RouteSearchMode::kAStar)
+        == nw.GetFastestTravelRoute("station_A", "station_C", RouteSearchMode::kAStar));
+
+    // Copies share the profiles registered so far.
+    const auto copy = nw;
+    BOOST_CHECK_EQUAL(copy.GetTravelRoute("station_A", "station_C", "no_transfers").totalTravelTime, 20);
+}
+
+BOOST_AUTO_TEST_CASE(mutations)
+{
+    // line_1: A -3-> B -3-> C
+    // line_2: A -4-> D -4-> C
+    // line_3: B -2-> E
+    // Changing lines costs 5.
+    TransportNetwork nw {};
+    bool ok {true};
+    for (const auto& id : {"station_A", "station_B", "station_C", "station_D", "station_E"}) {
+        ok &= nw.AddStation({id, id});
+    }
+    BOOST_REQUIRE(ok);
+    ok &= AddSingleRouteLine(nw, "line_1", {"station_A", "station_B", "station_C"});
+    ok &= AddSingleRouteLine(nw, "line_2", {"station_A", "station_D", "station_C"});
+    ok &= AddSingleRouteLine(nw, "line_3", {"station_B", "station_E"});
+    BOOST_REQUIRE(ok);
+    const auto failed = nw.UpdateTravelTimes({
+        {"station_A", "station_B", 3},
+        {"station_B", "station_C", 3},
+        {"station_A", "station_D", 4},
+        {"station_D", "station_C", 4},
+        {"station_B", "station_E", 2},
+    });
+    BOOST_REQUIRE_EQUAL(failed, 0);
+    const auto checkTime = [&nw](const Id& from, const Id& to, unsigned int time) {
+        for (const auto mode : {
+                RouteSearchMode::kDijkstra,
+                RouteSearchMode::kBidirectional,
+                RouteSearchMode::kAStar,
+                RouteSearchMode::kContractionHierarchy}) {
+            const auto route = nw.GetFastestTravelRoute(from, to, mode);
+            BOOST_CHECK_EQUAL(route.totalTravelTime, time);
+            BOOST_CHECK_EQUAL(route.steps.empty(), time == 0);
+        }
+    };
+    checkTime("station_A", "station_C", 6);
+
+    // Suspending a route the cached journey does not take keeps it cached.
+    const auto hits = nw.GetRouteCacheStats().hits;
+    BOOST_CHECK(nw.SuspendRoute("line_2", "line_2_route"));
+    BOOST_CHECK(!nw.SuspendRoute("line_2", "line_2_route"));
+    BOOST_CHECK(!nw.SuspendRoute("line_1", "line_2_route"));
+    nw.GetFastestTravelRoute("station_A", "station_C");
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheStats().hits, hits + 1);
+    BOOST_CHECK(nw.ResumeRoute("line_2", "line_2_route"));
+    BOOST_CHECK(!nw.ResumeRoute("line_2", "line_2_route"));
+
+    BOOST_CHECK(nw.SuspendRoute("line_1", "line_1_route"));
+    checkTime("station_A", "station_C", 8);
+    checkTime("station_A", "station_E", 0);
+    BOOST_CHECK(nw.ResumeRoute("line_1", "line_1_route"));
+    checkTime("station_A", "station_E", 10);
+    nw.BuildContractionHierarchy();
+    checkTime("station_A", "station_C", 6);
+
+    // Routes run through a closed station, but passengers cannot change
+    // there.
+    BOOST_CHECK(nw.CloseStation("station_B"));
+    BOOST_CHECK(!nw.CloseStation("station_B"));
+    BOOST_CHECK(!nw.CloseStation("station_42"));
+    nw.BuildContractionHierarchy();
+    checkTime("station_A", "station_B", 0);
+    checkTime("station_A", "station_C", 6);
+    checkTime("station_A", "station_E", 0);
+    BOOST_CHECK(nw.GetQuietTravelRoute("station_A", "station_B").steps.empty());
+    BOOST_CHECK(nw.GetQuietTravelRoute("station_B", "station_C").steps.empty());
+    BOOST_CHECK(nw.CloseStation("station_C"));
+    checkTime("station_A", "station_C", 0);
+    BOOST_CHECK(nw.GetQuietTravelRoute("station_A", "station_C").steps.empty());
+    BOOST_CHECK(nw.ReopenStation("station_C"));
+    BOOST_CHECK_EQUAL(nw.GetQuietTravelRoute("station_A", "station_C").totalTravelTime, 6);
+    BOOST_CHECK(nw.ReopenStation("station_B"));
+    BOOST_CHECK(!nw.ReopenStation("station_B"));
+    checkTime("station_A", "station_E", 10);
+
+    // A and C are not adjacent.
+    BOOST_CHECK_EQUAL(
+        nw.UpdateTravelTimes({
+            {"station_A", "station_B", 10},
+            {"station_B", "station_C", 1},
+            {"station_A", "station_C", 1},
+            {"station_A", "station_42", 1},
+        }),
+        2);
+    checkTime("station_A", "station_C", 8);
+
+    BOOST_CHECK(nw.RemoveLine("line_2"));
+    BOOST_CHECK(!nw.RemoveLine("line_2"));
+    BOOST_CHECK(!nw.RemoveLine("line_42"));
+    BOOST_CHECK(nw.GetRoutesServingStation("station_D").empty());
+    checkTime("station_A", "station_C", 11);
+    BOOST_CHECK(AddSingleRouteLine(nw, "line_2", {"station_A", "station_D", "station_C"}));
+    nw.SetTravelTime("station_A", "station_D", 4);
+    checkTime("station_A", "station_C", 8);
+
+    // A faster edge keeps the cached journeys no journey through it can
+    // beat. Changes rebuild the hierarchy in the background.
+    nw.SetLandmarkCount(4);
+    nw.BuildContractionHierarchy();
+    checkTime("station_A", "station_C", 8);
+    checkTime("station_A", "station_E", 17);
+    const auto fasterHits = nw.GetRouteCacheStats().hits;
+    BOOST_CHECK(nw.SetTravelTime("station_B", "station_E", 1));
+    nw.GetFastestTravelRoute("station_A", "station_C");
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheStats().hits, fasterHits + 1);
+    checkTime("station_A", "station_E", 16);
+    BOOST_CHECK(nw.SetTravelTime("station_A", "station_B", 1));
+    checkTime("station_A", "station_C", 2);
+    nw.WaitForContractionHierarchy();
+    BOOST_CHECK(nw.HasContractionHierarchy());
+    checkTime("station_A", "station_E", 7);
+    BOOST_CHECK(nw.SuspendRoute("line_1", "line_1_route"));
+    checkTime("station_A", "station_C", 8);
+    nw.WaitForContractionHierarchy();
+    BOOST_CHECK(nw.HasContractionHierarchy());
+    checkTime("station_A", "station_C", 8);
+}
+
+BOOST_AUTO_TEST_CASE(remove_and_add_line)
+{
+    // line_1: A -3-> B -3-> C
+    // line_2: A -4-> D -4-> C, and back.
+    TransportNetwork nw {};
+    bool ok {true};
+    for (const auto& id : {"station_A", "station_B", "station_C", "station_D"}) {
+        ok &= nw.AddStation({id, id});
+    }
+    ok &= AddSingleRouteLine(nw, "line_1", {"station_A", "station_B", "station_C"});
+    const Line line2 {"line_2", "line_2", {
+        {"line_2_out", "outbound", "line_2", "station_A", "station_C",
+         {"station_A", "station_D", "station_C"}},
+        {"line_2_back", "inbound", "line_2", "station_C", "station_A",
+         {"station_C", "station_D", "station_A"}},
+    }};
+    ok &= nw.AddLine(line2);
+    ok &= nw.SetTravelTime("station_A", "station_B", 3);
+    ok &= nw.SetTravelTime("station_B", "station_C", 3);
+    ok &= nw.SetTravelTime("station_A", "station_D", 4);
+    ok &= nw.SetTravelTime("station_D", "station_C", 4);
+    BOOST_REQUIRE(ok);
+    nw.SetLandmarkCount(4);
+    BOOST_CHECK_EQUAL(nw.GetFastestTravelRoute("station_A", "station_C").totalTravelTime, 6);
+    const auto checkCacheHit = [&nw = nw]() {
+        const auto hits = nw.GetRouteCacheStats().hits;
+        nw.GetFastestTravelRoute("station_A", "station_C");
+        BOOST_CHECK_EQUAL(nw.GetRouteCacheStats().hits, hits + 1);
+    };
+
+    // The routes of a removed line can be neither suspended nor resumed.
+    BOOST_CHECK(nw.SuspendRoute("line_2", "line_2_back"));
+    BOOST_CHECK(nw.RemoveLine("line_2"));
+    BOOST_CHECK(!nw.RemoveLine("line_2"));
+    BOOST_CHECK(!nw.ResumeRoute("line_2", "line_2_back"));
+    BOOST_CHECK(!nw.SuspendRoute("line_2", "line_2_out"));
+    BOOST_CHECK(nw.GetRoutesServingStation("station_D").empty());
+
+    // A line that cannot be added changes nothing.
+    BOOST_CHECK(!AddSingleRouteLine(nw, "line_3", {"station_A", "station_42"}));
+    BOOST_CHECK(!AddSingleRouteLine(nw, "line_1", {"station_A", "station_B"}));
+    BOOST_CHECK(!nw.AddLine({"line_3", "line_3", {line2.routes[0]}}));
+    checkCacheHit();
+
+    // The line comes back with its suspended route still suspended, and the
+    // cached journey no journey on the line beats stays cached.
+    BOOST_CHECK(nw.AddLine(line2));
+    BOOST_CHECK(!nw.AddLine(line2));
+    checkCacheHit();
+    BOOST_CHECK(nw.GetRoutesServingStation("station_D") == std::vector<Id> {"line_2_out"});
+    BOOST_CHECK(nw.GetFastestTravelRoute("station_C", "station_A").steps.empty());
+    BOOST_CHECK(nw.ResumeRoute("line_2", "line_2_back"));
+    BOOST_CHECK_EQUAL(nw.GetFastestTravelRoute("station_C", "station_A").totalTravelTime, 8);
+
+    // A line back over new edges, and a new station, keep it cached too.
+    BOOST_CHECK_EQUAL(nw.GetFastestTravelRoute("station_A", "station_C").totalTravelTime, 6);
+    BOOST_CHECK(nw.RemoveLine("line_2"));
+    BOOST_CHECK(AddSingleRouteLine(nw, "line_2", {"station_D", "station_B"}));
+    checkCacheHit();
+    BOOST_CHECK(nw.AddStation({"station_E", "station_E"}));
+    checkCacheHit();
+    BOOST_CHECK(nw.SetTravelTime("station_D", "station_B", 1));
+    for (const auto mode : {RouteSearchMode::kDijkstra, RouteSearchMode::kAStar}) {
+        BOOST_CHECK_EQUAL(
+            nw.GetFastestTravelRoute("station_D", "station_C", mode).totalTravelTime, 9);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(timetable)
+{
+    // line_1: A -2-> B -3-> C, every 10 from 0.
+    // line_2: B -4-> D, at 7 and 30.
+    // Changing lines takes 5.
+    TransportNetwork nw {};
+    bool ok {true};
+    for (const auto& id : {"station_A", "station_B", "station_C", "station_D"}) {
+        ok &= nw.AddStation({id, id});
+    }
+    Route route1 {
+        "route_1", "inbound", "line_1", "station_A", "station_C",
+        {"station_A", "station_B", "station_C"},
+    };
+    route1.timetable.headway = 10;
+    Route route2 {
+        "route_2", "inbound", "line_2", "station_B", "station_D",
+        {"station_B", "station_D"},
+    };
+    route2.timetable.departures = {30, 7};
+    ok &= nw.AddLine({"line_1", "line_1", {route1}});
+    ok &= nw.AddLine({"line_2", "line_2", {route2}});
+    ok &= nw.SetTravelTime("station_A", "station_B", 2);
+    ok &= nw.SetTravelTime("station_B", "station_C", 3);
+    ok &= nw.SetTravelTime("station_B", "station_D", 4);
+    BOOST_REQUIRE(ok);
+
+    auto route = nw.GetEarliestArrivalRoute("station_A", "station_C", 0);
+    BOOST_CHECK_EQUAL(route.totalTravelTime, 5);
+    // The wait for the trip at 10 counts in the first step.
+    route = nw.GetEarliestArrivalRoute("station_A", "station_C", 1);
+    BOOST_CHECK_EQUAL(route.totalTravelTime, 14);
+    BOOST_REQUIRE_EQUAL(route.steps.size(), 2);
+    BOOST_CHECK_EQUAL(route.steps[0].travelTime, 9 + 2);
+    BOOST_CHECK_EQUAL(route.steps[1].travelTime, 3);
+
+    // At B by 2, ready by 7 to change.
+    route = nw.GetEarliestArrivalRoute("station_A", "station_D", 0);
+    BOOST_CHECK_EQUAL(route.totalTravelTime, 11);
+    BOOST_REQUIRE_EQUAL(route.steps.size(), 2);
+    BOOST_CHECK_EQUAL(route.steps[1].routeId, "route_2");
+    // At B by 12, so the next trip is at 30.
+    route = nw.GetEarliestArrivalRoute("station_A", "station_D", 1);
+    BOOST_CHECK_EQUAL(route.totalTravelTime, 34 - 1);
+    RouteSearchStats stats {};
+    route = nw.GetEarliestArrivalRoute("station_A", "station_D", 31, &stats);
+    BOOST_CHECK(route.steps.empty());
+    BOOST_CHECK(stats.settledStates > 0);
+
+    // Trips run through a closed station.
+    BOOST_REQUIRE(nw.CloseStation("station_B"));
+    BOOST_CHECK_EQUAL(nw.GetEarliestArrivalRoute("station_A", "station_C", 0).totalTravelTime, 5);
+    BOOST_CHECK(nw.GetEarliestArrivalRoute("station_A", "station_D", 0).steps.empty());
+    BOOST_CHECK(nw.GetEarliestArrivalRoute("station_B", "station_D", 0).steps.empty());
+    BOOST_CHECK(nw.GetEarliestArrivalRoute("station_A", "station_42", 0).steps.empty());
+}
+
+BOOST_AUTO_TEST_CASE(json_timetable)
+{
+    const auto layout = nlohmann::json::parse(R"({
+        "stations": [
+            {"station_id": "s0"}, {"station_id": "s1"}, {"station_id": "s2"}
+        ],
+        "lines": [
+            {"line_id": "l0", "routes": [{
+                "route_id": "r0", "route_stops": ["s0", "s1"],
+                "headway": 15, "first_departure": 5, "last_departure": 50
+            }]},
+            {"line_id": "l1", "routes": [{
+                "route_id": "r1", "route_stops": ["s1", "s2"], "departures": [40, 20]
+            }]}
+        ],
+        "travel_times": [
+            {"start_station_id": "s0", "end_station_id": "s1", "travel_time": 3},
+            {"start_station_id": "s1", "end_station_id": "s2", "travel_time": 1}
+        ]
+    })");
+    const auto jsonFile = std::filesystem::temp_directory_path() / "network-timetable-test.json";
+    const auto imageFile = std::filesystem::temp_directory_path() / "network-timetable-test.bin";
+    {
+        std::ofstream out {jsonFile};
+        out << layout;
+    }
+    TransportNetwork fromJson {};
+    BOOST_REQUIRE(fromJson.FromJson(nlohmann::json(layout)));
+    TransportNetwork fromFile {};
+    BOOST_REQUIRE(fromFile.FromJsonFile(jsonFile));
+    BOOST_REQUIRE(fromFile.WriteLayoutImage(imageFile));
+    TransportNetwork fromImage {};
+    BOOST_REQUIRE(fromImage.FromLayoutImage(imageFile));
+
+    for (const auto* nw : {&fromJson, &fromFile, &fromImage}) {
+        // The trip at 5 reaches s1 at 8, in time for the one at 20.
+        BOOST_CHECK_EQUAL(nw->GetEarliestArrivalRoute("s0", "s2", 0).totalTravelTime, 21);
+        // The trip at 20 reaches s1 at 23, too late.
+        BOOST_CHECK_EQUAL(nw->GetEarliestArrivalRoute("s0", "s2", 6).totalTravelTime, 41 - 6);
+        // No trip after 50.
+        BOOST_CHECK(nw->GetEarliestArrivalRoute("s0", "s1", 51).steps.empty());
+    }
+    std::filesystem::remove(jsonFile);
+    std::filesystem::remove(imageFile);
+}
+
+BOOST_AUTO_TEST_CASE(json_earliest_arrival)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+
+    // With no timetables, trips leave whenever a passenger boards, so the
+    // earliest arrival is the fastest journey.
+    const std::vector<Id> stations {
+        "station_000", "station_042", "station_105", "station_198", "station_350",
+    };
+    for (const auto& stationA : stations) {
+        for (const auto& stationB : stations) {
+            const auto fastest = nw.GetFastestTravelRoute(stationA, stationB);
+            const auto earliest = nw.GetEarliestArrivalRoute(stationA, stationB, 100);
+            BOOST_CHECK_EQUAL(earliest.totalTravelTime, fastest.totalTravelTime);
+            unsigned int total {0};
+            for (const auto& step : earliest.steps) {
+                total += step.travelTime;
+            }
+            BOOST_CHECK_EQUAL(total, earliest.totalTravelTime);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(network_fastest_path_1route)
 {
     auto [nw, route]  = NetworkMonitor::GetTestNetwork("network_fastest_path_1route");
     auto fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B");
     BOOST_CHECK(route == fastestRoute);
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kBidirectional);
+    BOOST_CHECK(route == fastestRoute);
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kAStar);
+    BOOST_CHECK(route == fastestRoute);
+    nw.BuildContractionHierarchy();
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kContractionHierarchy);
+    BOOST_CHECK(route == fastestRoute);
 }
 
 BOOST_AUTO_TEST_CASE(network_fastest_path_2routes_overlap)
@@ -552,6 +1841,13 @@ BOOST_AUTO_TEST_CASE(network_fastest_path_2routes_overlap)
     auto [nw, route]  = NetworkMonitor::GetTestNetwork("network_fastest_path_2routes_overlap");
     auto fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B");
     BOOST_CHECK(route == fastestRoute);
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kBidirectional);
+    BOOST_CHECK(route == fastestRoute);
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kAStar);
+    BOOST_CHECK(route == fastestRoute);
+    nw.BuildContractionHierarchy();
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kContractionHierarchy);
+    BOOST_CHECK(route == fastestRoute);
 }
 
 BOOST_AUTO_TEST_CASE(network_fastest_path_2routes)
@@ -559,6 +1855,220 @@ BOOST_AUTO_TEST_CASE(network_fastest_path_2routes)
     auto [nw, route]  = NetworkMonitor::GetTestNetwork("network_fastest_path_2routes");
     auto fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B");
     BOOST_CHECK(route == fastestRoute);
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kBidirectional);
+    BOOST_CHECK(route == fastestRoute);
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kAStar);
+    BOOST_CHECK(route == fastestRoute);
+    nw.BuildContractionHierarchy();
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kContractionHierarchy);
+    BOOST_CHECK(route == fastestRoute);
+}
+
+BOOST_AUTO_TEST_CASE(json_batch)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    std::vector<std::pair<Id, Id>> queries {};
+    for (const auto& from : {"station_000", "station_042", "station_198"}) {
+        for (const auto& to : {"station_000", "station_100", "station_105", "station_350"}) {
+            queries.emplace_back(from, to);
+        }
+    }
+    queries.emplace_back("station_042", "station_42");
+    queries.emplace_back("station_100", "station_105");
+    for (const unsigned int nThreads : {0u, 1u, 3u}) {
+        RouteSearchStats stats {};
+        const auto routes = nw.GetFastestTravelRoutes(queries, nThreads, &stats);
+        BOOST_REQUIRE_EQUAL(routes.size(), queries.size());
+        BOOST_CHECK_GT(stats.settledStates, 0);
+        for (size_t idx = 0; idx < queries.size(); ++idx) {
+            const auto& [from, to] = queries[idx];
+            const auto expected = nw.GetFastestTravelRoute(from, to);
+            BOOST_CHECK_EQUAL(routes[idx].startStationId, from);
+            BOOST_CHECK_EQUAL(routes[idx].endStationId, to);
+            BOOST_CHECK_EQUAL(routes[idx].totalTravelTime, expected.totalTravelTime);
+            BOOST_CHECK_EQUAL(routes[idx].steps.empty(), expected.steps.empty());
+        }
+    }
+    BOOST_CHECK(nw.GetFastestTravelRoutes({}).empty());
+}
+
+BOOST_AUTO_TEST_CASE(json_bidirectional)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+
+    const std::vector<Id> stations {
+        "station_000", "station_042", "station_100", "station_211", "station_350",
+    };
+    for (const auto& stationA : stations) {
+        for (const auto& stationB : stations) {
+            auto forward = nw.GetFastestTravelRoute(stationA, stationB);
+            auto bidirectional = nw.GetFastestTravelRoute(
+                stationA, stationB, RouteSearchMode::kBidirectional);
+            BOOST_CHECK_EQUAL(forward.totalTravelTime, bidirectional.totalTravelTime);
+            BOOST_CHECK_EQUAL(forward.steps.empty(), bidirectional.steps.empty());
+            unsigned int total {0};
+            for (const auto& step : bidirectional.steps) {
+                total += step.travelTime;
+            }
+            BOOST_CHECK_EQUAL(total, bidirectional.totalTravelTime);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_a_star)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+
+    const std::vector<Id> stations {
+        "station_000", "station_042", "station_100", "station_211", "station_350",
+    };
+    for (size_t landmarkCount : {0, 1, 8}) {
+        nw.SetLandmarkCount(landmarkCount);
+        BOOST_CHECK_EQUAL(nw.GetLandmarkCount(), landmarkCount);
+        size_t dijkstraSettled {0};
+        size_t aStarSettled {0};
+        for (const auto& stationA : stations) {
+            for (const auto& stationB : stations) {
+                RouteSearchStats stats {};
+                auto dijkstra = nw.GetFastestTravelRoute(
+                    stationA, stationB, RouteSearchMode::kDijkstra, &stats);
+                dijkstraSettled += stats.settledStates;
+                auto aStar = nw.GetFastestTravelRoute(
+                    stationA, stationB, RouteSearchMode::kAStar, &stats);
+                aStarSettled += stats.settledStates;
+                BOOST_CHECK_EQUAL(dijkstra.totalTravelTime, aStar.totalTravelTime);
+            }
+        }
+        if (landmarkCount == 0) {
+            BOOST_CHECK_EQUAL(aStarSettled, dijkstraSettled);
+        } else {
+            BOOST_CHECK_LT(aStarSettled, dijkstraSettled);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_contraction_hierarchy)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    BOOST_CHECK(!nw.HasContractionHierarchy());
+    nw.BuildContractionHierarchy();
+    BOOST_REQUIRE(nw.HasContractionHierarchy());
+
+    const std::vector<Id> stations {
+        "station_000", "station_042", "station_105", "station_198", "station_350",
+    };
+    size_t dijkstraSettled {0};
+    size_t hierarchySettled {0};
+    for (const auto& stationA : stations) {
+        for (const auto& stationB : stations) {
+            RouteSearchStats stats {};
+            auto dijkstra = nw.GetFastestTravelRoute(
+                stationA, stationB, RouteSearchMode::kDijkstra, &stats);
+            dijkstraSettled += stats.settledStates;
+            auto hierarchy = nw.GetFastestTravelRoute(
+                stationA, stationB, RouteSearchMode::kContractionHierarchy, &stats);
+            hierarchySettled += stats.settledStates;
+            BOOST_CHECK_EQUAL(dijkstra.totalTravelTime, hierarchy.totalTravelTime);
+            BOOST_CHECK_EQUAL(dijkstra.steps.empty(), hierarchy.steps.empty());
+
+            // Shortcuts are unpacked into a connected sequence of steps.
+            unsigned int total {0};
+            for (size_t idx = 0; idx < hierarchy.steps.size(); ++idx) {
+                if (idx > 0) {
+                    BOOST_CHECK_EQUAL(
+                        hierarchy.steps[idx - 1].endStationId,
+                        hierarchy.steps[idx].startStationId);
+                }
+                total += hierarchy.steps[idx].travelTime;
+            }
+            BOOST_CHECK_EQUAL(total, hierarchy.totalTravelTime);
+        }
+    }
+    BOOST_CHECK_LT(hierarchySettled, dijkstraSettled);
+
+    // Changing a travel time rebuilds the hierarchy in the background.
+    bool ok = nw.SetTravelTime("station_000", "station_001", 9);
+    BOOST_REQUIRE(ok);
+    auto fallback = nw.GetFastestTravelRoute(
+        "station_000", "station_001", RouteSearchMode::kContractionHierarchy);
+    BOOST_CHECK_EQUAL(fallback.totalTravelTime, 9);
+    nw.WaitForContractionHierarchy();
+    BOOST_REQUIRE(nw.HasContractionHierarchy());
+    for (const auto& stationA : stations) {
+        for (const auto& stationB : stations) {
+            auto dijkstra = nw.GetFastestTravelRoute(
+                stationA, stationB, RouteSearchMode::kDijkstra);
+            auto hierarchy = nw.GetFastestTravelRoute(
+                stationA, stationB, RouteSearchMode::kContractionHierarchy);
+            BOOST_CHECK_EQUAL(dijkstra.totalTravelTime, hierarchy.totalTravelTime);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(json_travel_time_matrix)
+{
+    auto [nw, _] = NetworkMonitor::GetTestNetwork("", true, false);
+    const auto file = std::filesystem::temp_directory_path() / "travel-time-matrix.bin";
+    bool ok = nw.WriteTravelTimeMatrix(file, 4);
+    BOOST_REQUIRE(ok);
+
+    TravelTimeMatrix matrix {};
+    ok = matrix.Open(file);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(matrix.GetStationCount(), 426);
+
+    const std::vector<Id> stations {
+        "station_000", "station_042", "station_105", "station_198", "station_350",
+    };
+    for (const auto& stationA : stations) {
+        for (const auto& stationB : stations) {
+            auto route = nw.GetFastestTravelRoute(stationA, stationB);
+            auto next = matrix.GetNextStation(stationA, stationB);
+            if (route.steps.empty()) {
+                BOOST_CHECK_EQUAL(
+                    matrix.GetTravelTime(stationA, stationB),
+                    TravelTimeMatrix::kUnreachable);
+                BOOST_CHECK(next.empty());
+                continue;
+            }
+            BOOST_CHECK_EQUAL(matrix.GetTravelTime(stationA, stationB), route.totalTravelTime);
+            if (stationA == stationB) {
+                BOOST_CHECK(next.empty());
+            } else {
+                BOOST_CHECK(!next.empty());
+                BOOST_CHECK_NE(next, stationA);
+            }
+        }
+    }
+    BOOST_CHECK_EQUAL(
+        matrix.GetTravelTime("station_000", "station_unknown"),
+        TravelTimeMatrix::kUnreachable);
+    BOOST_CHECK(matrix.GetNextStation("station_000", "station_unknown").empty());
+
+    // The matrix does not depend on the number of threads.
+    const auto singleThreadFile = std::filesystem::temp_directory_path() / "travel-time-matrix-1.bin";
+    ok = nw.WriteTravelTimeMatrix(singleThreadFile, 1);
+    BOOST_REQUIRE(ok);
+    TravelTimeMatrix singleThread {};
+    ok = singleThread.Open(singleThreadFile);
+    BOOST_REQUIRE(ok);
+    for (NetworkMonitor::IdHandle stationA = 0; stationA < matrix.GetStationCount(); ++stationA) {
+        for (NetworkMonitor::IdHandle stationB = 0; stationB < matrix.GetStationCount(); ++stationB) {
+            BOOST_REQUIRE_EQUAL(
+                matrix.GetTravelTime(stationA, stationB),
+                singleThread.GetTravelTime(stationA, stationB));
+        }
+    }
+
+    // Not a matrix file.
+    TravelTimeMatrix invalid {};
+    BOOST_CHECK(!invalid.Open(TESTS_NETWORK_LAYOUT_JSON));
+    BOOST_CHECK_EQUAL(invalid.GetStationCount(), 0);
+
+    matrix.Close();
+    singleThread.Close();
+    std::filesystem::remove(file);
+    std::filesystem::remove(singleThreadFile);
 }
 
 BOOST_AUTO_TEST_CASE(network_fastest_path_missing_station)
@@ -569,6 +2079,13 @@ BOOST_AUTO_TEST_CASE(network_fastest_path_missing_station)
 BOOST_AUTO_TEST_CASE(network_fastest_path_no_path)
 {
     auto [nw, route]  = NetworkMonitor::GetTestNetwork("network_fastest_path_no_path", false, false);
+    auto fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B");
+    BOOST_CHECK(fastestRoute.steps.empty());
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kBidirectional);
+    BOOST_CHECK(fastestRoute.steps.empty());
+    nw.BuildContractionHierarchy();
+    fastestRoute = nw.GetFastestTravelRoute("station_A", "station_B", RouteSearchMode::kContractionHierarchy);
+    BOOST_CHECK(fastestRoute.steps.empty());
 }
 
 BOOST_AUTO_TEST_SUITE_END(); // TravelTime